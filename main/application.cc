@@ -384,7 +384,7 @@ void Application::Start() {
     });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
         if (device_state_ == kDeviceStateSpeaking) {
-            audio_service_.PushPacketToDecodeQueue(std::move(packet));
+            audio_service_.PushPacketToJitterBuffer(std::move(packet));
         }
     });
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
@@ -393,6 +393,9 @@ void Application::Start() {
             ESP_LOGW(TAG, "Server sample rate %d does not match device output sample rate %d, resampling may cause distortion",
                 protocol_->server_sample_rate(), codec->output_sample_rate());
         }
+        // Use the uplink frame duration the server chose in its hello
+        audio_service_.SetFrameDuration(protocol_->server_frame_duration());
+        audio_service_.EnableUplinkDtx(protocol_->server_dtx());
     });
     protocol_->OnAudioChannelClosed([this, &board]() {
         board.SetPowerSaveMode(true);
@@ -551,9 +554,11 @@ void Application::MainEventLoop() {
 
         if (bits & MAIN_EVENT_SEND_AUDIO) {
             while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+                auto trace = packet->trace;
                 if (!protocol_->SendAudio(std::move(packet))) {
                     break;
                 }
+                audio_service_.latency_tracer().Finish(trace, kLatencyStageSend, kLatencyStageUplink);
             }
         }
 
@@ -646,6 +651,10 @@ void Application::SetDeviceState(DeviceState state) {
     auto led = board.GetLed();
     led->OnStateChanged();
     
+    // 对话期间压低音乐音量
+    audio_service_.audio_mixer().SetDucking(state != kDeviceStateIdle);
+
+#if !CONFIG_MUSIC_DUCK_IN_CONVERSATION
     // 当从idle状态变成其他任何状态时，停止音乐播放
     if (previous_state == kDeviceStateIdle && state != kDeviceStateIdle) {
         auto music = board.GetMusic();
@@ -655,6 +664,7 @@ void Application::SetDeviceState(DeviceState state) {
             music->StopStreaming();
         }
     }
+#endif
     
     switch (state) {
         case kDeviceStateUnknown:
@@ -779,86 +789,15 @@ void Application::SetAecMode(AecMode mode) {
     });
 }
 
-// 新增：接收外部音频数据（如音乐播放）
+// 新增：接收外部音频数据（如音乐播放），由混音器转换采样率并与语音混合
 void Application::AddAudioData(AudioStreamPacket&& packet) {
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (device_state_ == kDeviceStateIdle && codec->output_enabled()) {
-        // packet.payload包含的是原始PCM数据（int16_t）
-        if (packet.payload.size() >= 2) {
-            size_t num_samples = packet.payload.size() / sizeof(int16_t);
-            std::vector<int16_t> pcm_data(num_samples);
-            memcpy(pcm_data.data(), packet.payload.data(), packet.payload.size());
-            
-            // 检查采样率是否匹配，如果不匹配则进行简单重采样
-            if (packet.sample_rate != codec->output_sample_rate()) {
-                // ESP_LOGI(TAG, "Resampling music audio from %d to %d Hz", 
-                //         packet.sample_rate, codec->output_sample_rate());
-                
-                // 验证采样率参数
-                if (packet.sample_rate <= 0 || codec->output_sample_rate() <= 0) {
-                    ESP_LOGE(TAG, "Invalid sample rates: %d -> %d", 
-                            packet.sample_rate, codec->output_sample_rate());
-                    return;
-                }
-                
-                std::vector<int16_t> resampled;
-                
-                if (packet.sample_rate > codec->output_sample_rate()) {
-                    ESP_LOGI(TAG, "音乐播放：将采样率从 %d Hz 切换到 %d Hz", 
-                        codec->output_sample_rate(), packet.sample_rate);
-
-                    // 尝试动态切换采样率
-                    if (codec->SetOutputSampleRate(packet.sample_rate)) {
-                        ESP_LOGI(TAG, "成功切换到音乐播放采样率: %d Hz", packet.sample_rate);
-                    } else {
-                        ESP_LOGW(TAG, "无法切换采样率，继续使用当前采样率: %d Hz", codec->output_sample_rate());
-                    }
-                } else {
-                    // 上采样：线性插值
-                    float upsample_ratio = codec->output_sample_rate() / static_cast<float>(packet.sample_rate);
-                    size_t expected_size = static_cast<size_t>(pcm_data.size() * upsample_ratio + 0.5f);
-                    resampled.reserve(expected_size);
-                    
-                    for (size_t i = 0; i < pcm_data.size(); ++i) {
-                        // 添加原始样本
-                        resampled.push_back(pcm_data[i]);
-                        
-                        // 计算需要插值的样本数
-                        int interpolation_count = static_cast<int>(upsample_ratio) - 1;
-                        if (interpolation_count > 0 && i + 1 < pcm_data.size()) {
-                            int16_t current = pcm_data[i];
-                            int16_t next = pcm_data[i + 1];
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                float t = static_cast<float>(j) / (interpolation_count + 1);
-                                int16_t interpolated = static_cast<int16_t>(current + (next - current) * t);
-                                resampled.push_back(interpolated);
-                            }
-                        } else if (interpolation_count > 0) {
-                            // 最后一个样本，直接重复
-                            for (int j = 1; j <= interpolation_count; ++j) {
-                                resampled.push_back(pcm_data[i]);
-                            }
-                        }
-                    }
-                    
-                    ESP_LOGI(TAG, "Upsampled %d -> %d samples (ratio: %.2f)", 
-                            pcm_data.size(), resampled.size(), upsample_ratio);
-                }
-                
-                pcm_data = std::move(resampled);
-            }
-            
-            // 确保音频输出已启用
-            if (!codec->output_enabled()) {
-                codec->EnableOutput(true);
-            }
-            
-            // 发送PCM数据到音频编解码器
-            codec->OutputData(pcm_data);
-            
-            audio_service_.UpdateOutputTimestamp();
-        }
+    // packet.payload包含的是原始PCM数据（int16_t）
+    if (packet.payload.size() < 2 || packet.sample_rate <= 0) {
+        ESP_LOGE(TAG, "Invalid music audio: %u bytes at %d Hz", packet.payload.size(), packet.sample_rate);
+        return;
     }
+    size_t num_samples = packet.payload.size() / sizeof(int16_t);
+    audio_service_.PushMusicPcm(reinterpret_cast<const int16_t*>(packet.payload.data()), num_samples, packet.sample_rate);
 }
 
 void Application::PlaySound(const std::string_view& sound) {
@@ -0,0 +1,393 @@
+#include "audio_mixer.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define TAG "AudioMixer"
+
+/* Each buffered channel holds this much audio at the highest codec rate */
+#define MIXER_BUFFER_MS 200
+#define MIXER_MAX_SAMPLE_RATE 48000
+/* Music gain while ducked, and how fast it goes down and comes back */
+#define MIXER_DUCK_GAIN_PERCENT 20
+#define MIXER_DUCK_ATTACK_MS 50
+#define MIXER_DUCK_RELEASE_MS 400
+/* Stay ducked through the short gaps between sentences */
+#define MIXER_DUCK_HOLD_MS 300
+/* A blocked producer also re-checks for room this often, in case a wakeup was missed */
+#define MIXER_PRODUCER_POLL_MS 20
+
+#define Q15_ONE 32768
+
+/*
+ * Downsampling low-pass: taps per output sample and number of phases between two input
+ * samples. The Kaiser window gives about 60 dB stopband attenuation over a transition band of
+ * about 1.6 kHz at 44.1 kHz input, centred a little below the output Nyquist frequency so only
+ * the top of the transition band can alias.
+ */
+#define RESAMPLER_TAPS 48
+#define RESAMPLER_PHASES 64
+#define RESAMPLER_KAISER_BETA 6.0f
+#define RESAMPLER_CUTOFF 0.45f   // Of the output rate
+
+AudioMixer::~AudioMixer() {
+    for (auto& channel : channels_) {
+        if (channel.buffer != nullptr) {
+            heap_caps_free(channel.buffer);
+        }
+    }
+}
+
+void AudioMixer::Converter::Process(const int16_t* input, size_t samples, int input_rate, int output_rate,
+    std::vector<int16_t>& output) {
+    if (samples == 0) {
+        return;
+    }
+    if (input_rate != this->input_rate || output_rate != this->output_rate) {
+        this->input_rate = input_rate;
+        this->output_rate = output_rate;
+        step = ((uint64_t)input_rate << 16) / output_rate;
+        position = 0;
+        last = input[0];
+        if (input_rate > output_rate) {
+            DesignLowPass();
+            history.assign(RESAMPLER_TAPS - 1, input[0]);
+        } else {
+            coefficients.clear();
+            coefficients.shrink_to_fit();
+            history.clear();
+            history.shrink_to_fit();
+        }
+    }
+    if (!coefficients.empty()) {
+        Filter(input, samples, output);
+        return;
+    }
+
+    /* Index 0 is the last sample of the previous call, index i is input[i - 1] */
+    output.reserve(output.size() + (uint64_t)samples * output_rate / input_rate + 2);
+    while ((position >> 16) < samples) {
+        size_t index = position >> 16;
+        int32_t a = index == 0 ? last : input[index - 1];
+        int32_t b = input[index];
+        int32_t frac = position & 0xFFFF;
+        output.push_back(a + (int32_t)(((int64_t)(b - a) * frac) >> 16));
+        position += step;
+    }
+    position -= (uint64_t)samples << 16;
+    last = input[samples - 1];
+}
+
+/* Zeroth order modified Bessel function of the first kind, for the Kaiser window */
+static float BesselI0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 20; k++) {
+        term *= (x / (2.0f * k)) * (x / (2.0f * k));
+        sum += term;
+    }
+    return sum;
+}
+
+/* Phase p holds the taps for an output sample p / RESAMPLER_PHASES of an input sample past the filter centre */
+void AudioMixer::Converter::DesignLowPass() {
+    const float cutoff = RESAMPLER_CUTOFF * output_rate / input_rate;   // Cycles per input sample
+    const float center = RESAMPLER_TAPS / 2 - 1;
+    const float window_scale = 1.0f / BesselI0(RESAMPLER_KAISER_BETA);
+    coefficients.resize(RESAMPLER_PHASES * RESAMPLER_TAPS);
+    std::vector<float> taps(RESAMPLER_TAPS);
+    for (int phase = 0; phase < RESAMPLER_PHASES; phase++) {
+        float sum = 0.0f;
+        for (int k = 0; k < RESAMPLER_TAPS; k++) {
+            float x = k - center - (float)phase / RESAMPLER_PHASES;
+            float sinc = x == 0.0f ? 2.0f * cutoff : sinf(2.0f * (float)M_PI * cutoff * x) / ((float)M_PI * x);
+            float r = x / (center + 1.0f);
+            float window = r * r < 1.0f ? BesselI0(RESAMPLER_KAISER_BETA * sqrtf(1.0f - r * r)) * window_scale : 0.0f;
+            taps[k] = sinc * window;
+            sum += taps[k];
+        }
+        /* Unity gain at DC for every phase */
+        for (int k = 0; k < RESAMPLER_TAPS; k++) {
+            coefficients[phase * RESAMPLER_TAPS + k] = (int16_t)lrintf(taps[k] / sum * 16384.0f);
+        }
+    }
+}
+
+void AudioMixer::Converter::Filter(const int16_t* input, size_t samples, std::vector<int16_t>& output) {
+    history.insert(history.end(), input, input + samples);
+    size_t available = history.size();
+    output.reserve(output.size() + (uint64_t)samples * output_rate / input_rate + 2);
+    while ((position >> 16) + RESAMPLER_TAPS <= available) {
+        const int16_t* x = history.data() + (position >> 16);
+        int phase = ((position & 0xFFFF) * RESAMPLER_PHASES) >> 16;
+        /* Q14 taps with unity sum keep every partial sum of 16 bit samples within 32 bits */
+        const int16_t* h = coefficients.data() + phase * RESAMPLER_TAPS;
+        int32_t sum = 0;
+        for (int k = 0; k < RESAMPLER_TAPS; k++) {
+            sum += x[k] * h[k];
+        }
+        output.push_back(std::clamp<int32_t>((sum + (1 << 13)) >> 14, INT16_MIN, INT16_MAX));
+        position += step;
+    }
+    /* Keep the taps the next output sample still needs */
+    size_t consumed = available - (RESAMPLER_TAPS - 1);
+    position -= (uint64_t)consumed << 16;
+    history.erase(history.begin(), history.begin() + consumed);
+}
+
+/* Only called by the output task */
+size_t AudioMixer::Channel::Read(int16_t* output, size_t samples) {
+    size_t read = head.load(std::memory_order_relaxed);
+    samples = std::min(samples, tail.load(std::memory_order_acquire) - read);
+    size_t offset = read % capacity;
+    size_t first = std::min(samples, capacity - offset);
+    memcpy(output, buffer + offset, first * sizeof(int16_t));
+    memcpy(output + first, buffer, (samples - first) * sizeof(int16_t));
+    head.store(read + samples, std::memory_order_release);
+    return samples;
+}
+
+bool AudioMixer::AllocateChannel(Channel& channel) {
+    if (channel.buffer != nullptr) {
+        return true;
+    }
+    size_t capacity = MIXER_MAX_SAMPLE_RATE / 1000 * MIXER_BUFFER_MS;
+    channel.buffer = (int16_t*)heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_SPIRAM);
+    if (channel.buffer == nullptr) {
+        channel.buffer = (int16_t*)heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    }
+    if (channel.buffer == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %u samples for a mixer channel", capacity);
+        return false;
+    }
+    channel.capacity = capacity;
+    return true;
+}
+
+void AudioMixer::SetGain(MixerChannel channel, int percent) {
+    percent = std::clamp(percent, 0, 100);
+    channels_[channel].gain_q15 = percent * Q15_ONE / 100;
+}
+
+int AudioMixer::gain(MixerChannel channel) const {
+    return (channels_[channel].gain_q15 * 100 + Q15_ONE / 2) / Q15_ONE;
+}
+
+bool AudioMixer::Write(MixerChannel channel, const int16_t* pcm, size_t samples, int sample_rate, TickType_t wait) {
+    if (channel == kMixerChannelVoice || samples == 0) {
+        return false;
+    }
+    auto& ch = channels_[channel];
+    std::lock_guard<std::mutex> lock(ch.write_mutex);
+    if (!AllocateChannel(ch)) {
+        return false;
+    }
+
+    int output_rate = output_sample_rate_;
+    if (output_rate > 0 && sample_rate != output_rate) {
+        ch.converted.clear();
+        ch.converter.Process(pcm, samples, sample_rate, output_rate, ch.converted);
+        pcm = ch.converted.data();
+        samples = ch.converted.size();
+    }
+
+    TickType_t start = xTaskGetTickCount();
+    while (samples > 0) {
+        size_t write = ch.tail.load(std::memory_order_relaxed);
+        size_t space = ch.capacity - (write - ch.head.load(std::memory_order_acquire));
+        if (ch.clear_requested) {
+            /* Cleared while we were writing, drop the rest */
+            return false;
+        }
+        if (space == 0) {
+            TickType_t elapsed = xTaskGetTickCount() - start;
+            if (wait != portMAX_DELAY && elapsed >= wait) {
+                return false;
+            }
+            /* Register before checking again, so a read in between still wakes us */
+            ch.waiting_producer = xTaskGetCurrentTaskHandle();
+            if (ch.capacity - ch.available() == 0) {
+                TickType_t timeout = pdMS_TO_TICKS(MIXER_PRODUCER_POLL_MS);
+                if (wait != portMAX_DELAY) {
+                    timeout = std::min(timeout, wait - elapsed);
+                }
+                ulTaskNotifyTake(pdTRUE, std::max<TickType_t>(timeout, 1));
+            }
+            ch.waiting_producer = nullptr;
+            continue;
+        }
+
+        size_t n = std::min(space, samples);
+        size_t offset = write % ch.capacity;
+        size_t first = std::min(n, ch.capacity - offset);
+        memcpy(ch.buffer + offset, pcm, first * sizeof(int16_t));
+        memcpy(ch.buffer, pcm + first, (n - first) * sizeof(int16_t));
+        ch.tail.store(write + n, std::memory_order_release);
+        pcm += n;
+        samples -= n;
+        if (consumer_ != nullptr) {
+            xTaskNotifyGive(consumer_);
+        }
+    }
+    return true;
+}
+
+bool AudioMixer::PlayClip(std::shared_ptr<const PcmClip> clip) {
+    if (clip == nullptr || clip->sample_rate != output_sample_rate_) {
+        return false;
+    }
+    if (!clip->pcm.empty()) {
+        std::lock_guard<std::mutex> lock(clip_mutex_);
+        clip_samples_ += clip->pcm.size();
+        clips_.push_back(std::move(clip));
+    }
+    if (consumer_ != nullptr) {
+        xTaskNotifyGive(consumer_);
+    }
+    return true;
+}
+
+/* Add the queued clips into output, dropping the ones that are done */
+size_t AudioMixer::AddClips(int16_t* output, size_t samples) {
+    std::lock_guard<std::mutex> lock(clip_mutex_);
+    size_t added = 0;
+    while (added < samples && !clips_.empty()) {
+        auto& pcm = clips_.front()->pcm;
+        size_t n = std::min(samples - added, pcm.size() - clip_position_);
+        const int16_t* in = pcm.data() + clip_position_;
+        for (size_t i = 0; i < n; i++) {
+            output[added + i] = std::clamp<int32_t>(output[added + i] + in[i], INT16_MIN, INT16_MAX);
+        }
+        added += n;
+        clip_position_ += n;
+        if (clip_position_ == pcm.size()) {
+            clips_.pop_front();
+            clip_position_ = 0;
+        }
+    }
+    clip_samples_ -= added;
+    return added;
+}
+
+void AudioMixer::Clear(MixerChannel channel) {
+    if (channel == kMixerChannelEffect) {
+        std::lock_guard<std::mutex> lock(clip_mutex_);
+        clips_.clear();
+        clip_position_ = 0;
+        clip_samples_ = 0;
+    }
+    if (channel != kMixerChannelVoice) {
+        channels_[channel].clear_requested = true;
+        if (consumer_ != nullptr) {
+            xTaskNotifyGive(consumer_);
+        }
+    }
+}
+
+bool AudioMixer::empty(MixerChannel channel) const {
+    if (channel == kMixerChannelVoice) {
+        return true;
+    }
+    if (channel == kMixerChannelEffect && clip_samples_ > 0) {
+        return false;
+    }
+    auto& ch = channels_[channel];
+    return ch.clear_requested || ch.available() == 0;
+}
+
+bool AudioMixer::Mix(std::vector<int16_t>& pcm, int sample_rate, size_t block_samples) {
+    int output_rate = output_sample_rate_;
+    for (auto& ch : channels_) {
+        if (ch.clear_requested.exchange(false)) {
+            ch.head.store(ch.tail.load(std::memory_order_acquire), std::memory_order_release);
+        }
+    }
+
+    bool voice = !pcm.empty();
+    if (voice && sample_rate > 0 && sample_rate != output_rate) {
+        voice_buffer_.clear();
+        voice_converter_.Process(pcm.data(), pcm.size(), sample_rate, output_rate, voice_buffer_);
+        pcm.swap(voice_buffer_);
+    }
+
+    auto& music = channels_[kMixerChannelMusic];
+    auto& effect = channels_[kMixerChannelEffect];
+    size_t music_available = music.buffer != nullptr ? music.available() : 0;
+    size_t effect_available = effect.buffer != nullptr ? effect.available() : 0;
+    size_t clip_available = clip_samples_;
+    if (!voice) {
+        size_t samples = std::min(block_samples, std::max({music_available, effect_available, clip_available}));
+        if (samples == 0) {
+            return false;
+        }
+        pcm.assign(samples, 0);
+    }
+    size_t samples = pcm.size();
+
+    /* Duck the music under the voice and effects, and hold it down through short pauses */
+    bool ducked = ducking_ || voice || effect_available > 0 || clip_available > 0;
+    if (ducked) {
+        duck_hold_samples_ = output_rate / 1000 * MIXER_DUCK_HOLD_MS;
+    } else if (duck_hold_samples_ > 0) {
+        duck_hold_samples_ -= std::min<int>(duck_hold_samples_, samples);
+        ducked = true;
+    }
+    int envelope_target = ducked ? MIXER_DUCK_GAIN_PERCENT * Q15_ONE / 100 : Q15_ONE;
+
+    int voice_gain = voice ? channels_[kMixerChannelVoice].gain_q15.load() : 0;
+    if (music_available == 0 && effect_available == 0 && clip_available == 0) {
+        /* Voice only: nothing to mix, and the envelope is where it should be once music starts */
+        music_envelope_q15_ = envelope_target;
+        if (voice_gain != Q15_ONE) {
+            for (auto& s : pcm) {
+                s = (s * voice_gain) >> 15;
+            }
+        }
+        return true;
+    }
+
+    music_buffer_.resize(samples);
+    effect_buffer_.resize(samples);
+    size_t music_read = music_available > 0 ? music.Read(music_buffer_.data(), samples) : 0;
+    size_t effect_read = effect_available > 0 ? effect.Read(effect_buffer_.data(), samples) : 0;
+    std::fill(music_buffer_.begin() + music_read, music_buffer_.end(), 0);
+    std::fill(effect_buffer_.begin() + effect_read, effect_buffer_.end(), 0);
+    if (clip_available > 0) {
+        AddClips(effect_buffer_.data(), samples);
+    }
+
+    int music_gain = music.gain_q15;
+    int effect_gain = effect.gain_q15;
+    int envelope = music_envelope_q15_;
+    int envelope_step = envelope_target < envelope
+        ? std::max(1, (Q15_ONE - envelope_target) / std::max(1, output_rate / 1000 * MIXER_DUCK_ATTACK_MS))
+        : std::max(1, (Q15_ONE - MIXER_DUCK_GAIN_PERCENT * Q15_ONE / 100) / std::max(1, output_rate / 1000 * MIXER_DUCK_RELEASE_MS));
+
+    /* Every term is scaled back to 16 bits before the sum, so it fits in 32 bits, and saturated once */
+    int16_t* out = pcm.data();
+    const int16_t* m = music_buffer_.data();
+    const int16_t* e = effect_buffer_.data();
+    for (size_t i = 0; i < samples; i++) {
+        if (envelope > envelope_target) {
+            envelope = std::max(envelope - envelope_step, envelope_target);
+        } else if (envelope < envelope_target) {
+            envelope = std::min(envelope + envelope_step, envelope_target);
+        }
+        int32_t music_scale = (music_gain * envelope) >> 15;
+        int32_t sum = ((out[i] * voice_gain) >> 15) + ((m[i] * music_scale) >> 15) + ((e[i] * effect_gain) >> 15);
+        out[i] = std::clamp<int32_t>(sum, INT16_MIN, INT16_MAX);
+    }
+    music_envelope_q15_ = envelope;
+
+    for (auto* ch : {&music, &effect}) {
+        TaskHandle_t producer = ch->waiting_producer;
+        if (producer != nullptr) {
+            xTaskNotifyGive(producer);
+        }
+    }
+    return true;
+}
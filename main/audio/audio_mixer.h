@@ -0,0 +1,127 @@
+#ifndef AUDIO_MIXER_H
+#define AUDIO_MIXER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+enum MixerChannel {
+    kMixerChannelVoice,     // TTS and other decoded conversation audio, one frame at a time from the playback queue
+    kMixerChannelMusic,     // Music player PCM, ducked while the voice or an effect plays
+    kMixerChannelEffect,    // Prompts and notification sounds
+    kMixerChannelCount,
+};
+
+/* Mono PCM shared read-only between its owner (e.g. the sound cache) and the mixer */
+struct PcmClip {
+    std::vector<int16_t> pcm;
+    int sample_rate = 0;
+};
+
+/*
+ * Software mixer in front of the codec.
+ *
+ * The voice channel is passed in frame by frame by the output task; the music and effect
+ * channels are buffered in PCM rings written by their producers, which block while the ring
+ * is full so they are paced by playback. Every channel has its own gain and sample rate
+ * converter to the codec rate, and the music channel follows a ducking envelope. When only
+ * the voice plays at full gain and at the codec rate, its frame is passed through untouched.
+ * Clips played with PlayClip are read in place on the effect channel, one after the other.
+ */
+class AudioMixer {
+public:
+    AudioMixer() = default;
+    ~AudioMixer();
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+
+    void SetConsumer(TaskHandle_t task) { consumer_ = task; }
+    void SetOutputSampleRate(int sample_rate) { output_sample_rate_ = sample_rate; }
+    void SetGain(MixerChannel channel, int percent);
+    int gain(MixerChannel channel) const;
+    /* Keep the music ducked regardless of the other channels, e.g. for a whole conversation */
+    void SetDucking(bool ducking) { ducking_ = ducking; }
+
+    /* Queue PCM on the music or effect channel, waiting up to `wait` for room. Returns false if it timed out or was cleared */
+    bool Write(MixerChannel channel, const int16_t* pcm, size_t samples, int sample_rate, TickType_t wait = portMAX_DELAY);
+    /* Queue a clip on the effect channel without copying it. Returns false unless it is at the output rate */
+    bool PlayClip(std::shared_ptr<const PcmClip> clip);
+    void Clear(MixerChannel channel);
+    bool empty(MixerChannel channel) const;
+
+    /*
+     * Called by the output task. Mixes the buffered channels into `pcm`, which holds one voice
+     * frame at `sample_rate` (converted to the output rate first) or is empty, in which case up to
+     * `block_samples` of buffered audio are mixed. Returns false if there is nothing to play.
+     */
+    bool Mix(std::vector<int16_t>& pcm, int sample_rate, size_t block_samples);
+
+private:
+    /*
+     * Sample rate converter keeping its phase across calls. Upsampling interpolates linearly
+     * between consecutive samples; downsampling uses a polyphase windowed-sinc low-pass below the
+     * output Nyquist frequency, so e.g. 44.1 kHz music does not alias into the band of a 16 kHz codec.
+     */
+    struct Converter {
+        int input_rate = 0;
+        int output_rate = 0;
+        uint32_t step = 0;        // Input samples per output sample in Q16
+        uint64_t position = 0;    // Linear: position after `last`. Filter: position of the first tap in `history`. Q16
+        int16_t last = 0;
+        std::vector<int16_t> coefficients;  // Filter only: taps of every phase in Q14
+        std::vector<int16_t> history;       // Filter only: the last input samples, then the new ones
+
+        void Process(const int16_t* input, size_t samples, int input_rate, int output_rate, std::vector<int16_t>& output);
+
+    private:
+        void DesignLowPass();
+        void Filter(const int16_t* input, size_t samples, std::vector<int16_t>& output);
+    };
+
+    /* Single producer, single consumer ring; the producer side is serialized by write_mutex */
+    struct Channel {
+        int16_t* buffer = nullptr;
+        size_t capacity = 0;
+        std::atomic<size_t> head{0};    // Read position, advanced by the output task
+        std::atomic<size_t> tail{0};    // Write position, advanced by the producer
+        std::atomic<bool> clear_requested{false};
+        std::atomic<int> gain_q15{32768};
+        std::mutex write_mutex;
+        std::atomic<TaskHandle_t> waiting_producer{nullptr};
+        Converter converter;
+        std::vector<int16_t> converted;
+
+        size_t available() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_relaxed); }
+        size_t Read(int16_t* output, size_t samples);
+    };
+
+    bool AllocateChannel(Channel& channel);
+    size_t AddClips(int16_t* output, size_t samples);
+
+    Channel channels_[kMixerChannelCount];
+    TaskHandle_t consumer_ = nullptr;
+    std::atomic<int> output_sample_rate_{0};
+    std::atomic<bool> ducking_{false};
+    int music_envelope_q15_ = 32768;   // Current ducking gain of the music channel
+    int duck_hold_samples_ = 0;        // Keep ducking this long after the voice or effects stop
+
+    std::mutex clip_mutex_;
+    std::deque<std::shared_ptr<const PcmClip>> clips_;
+    size_t clip_position_ = 0;                // Samples of the first clip already played
+    std::atomic<size_t> clip_samples_{0};     // Samples left in all queued clips
+
+    // Only used by the output task
+    Converter voice_converter_;
+    std::vector<int16_t> voice_buffer_;
+    std::vector<int16_t> music_buffer_;
+    std::vector<int16_t> effect_buffer_;
+};
+
+#endif // AUDIO_MIXER_H
@@ -0,0 +1,140 @@
+#ifndef AUDIO_QUEUE_H
+#define AUDIO_QUEUE_H
+
+#include <memory>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+/* Notification index of tasks blocked in Push(wait = true); index 0 belongs to the task itself */
+#define AUDIO_QUEUE_NOTIFY_INDEX 1
+static_assert(configTASK_NOTIFICATION_ARRAY_ENTRIES > AUDIO_QUEUE_NOTIFY_INDEX,
+    "AudioQueue needs CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES >= 2");
+
+/*
+ * Bounded ring of owned items for one stage of the audio pipeline.
+ *
+ * Each queue has its own spinlock that only guards the ring indices (a few instructions,
+ * never held while waiting or freeing), and wakes tasks with direct-to-task notifications:
+ * a push notifies only the queue's consumer task, a pop notifies only the producer task and
+ * any task blocked in Push(wait = true). Tasks woken by a notification must re-check their
+ * condition, as a notification may also come from another queue they use.
+ *
+ * Push(wait = true) can be called from any task, including ones that use their own
+ * notifications for something else (the main task, timer callbacks). It waits on a separate
+ * notification index, so it neither consumes the caller's notifications nor wakes up on them.
+ *
+ * Clear() and size() may be called from any task, which is why the indices are guarded
+ * instead of being a strictly single-producer single-consumer lock-free ring.
+ */
+template <typename T>
+class AudioQueue {
+public:
+    explicit AudioQueue(size_t capacity) : slots_(capacity) {}
+
+    AudioQueue(const AudioQueue&) = delete;
+    AudioQueue& operator=(const AudioQueue&) = delete;
+
+    void SetConsumer(TaskHandle_t task) { consumer_ = task; }
+    void SetProducer(TaskHandle_t task) { producer_ = task; }
+
+    /* Push an item if fewer than `limit` items are queued (0 means the capacity).
+     * If wait is true, block the calling task until there is room. */
+    bool Push(std::unique_ptr<T>&& item, bool wait = false, size_t limit = 0) {
+        if (limit == 0 || limit > slots_.size()) {
+            limit = slots_.size();
+        }
+        while (true) {
+            bool waiting = false;
+            portENTER_CRITICAL(&lock_);
+            if (count_ < limit) {
+                slots_[(head_ + count_) % slots_.size()] = std::move(item);
+                count_++;
+                portEXIT_CRITICAL(&lock_);
+                Notify(consumer_);
+                return true;
+            }
+            if (wait) {
+                waiting = AddWaiter(xTaskGetCurrentTaskHandle());
+            }
+            portEXIT_CRITICAL(&lock_);
+
+            if (!wait) {
+                return false;
+            }
+            /* Without a waiter slot we are not notified on pop, so poll once per tick */
+            ulTaskNotifyTakeIndexed(AUDIO_QUEUE_NOTIFY_INDEX, pdTRUE, waiting ? portMAX_DELAY : 1);
+        }
+    }
+
+    /* Returns nullptr if the queue is empty */
+    std::unique_ptr<T> Pop() {
+        TaskHandle_t waiters[kMaxWaiters];
+        portENTER_CRITICAL(&lock_);
+        if (count_ == 0) {
+            portEXIT_CRITICAL(&lock_);
+            return nullptr;
+        }
+        auto item = std::move(slots_[head_]);
+        head_ = (head_ + 1) % slots_.size();
+        count_--;
+        for (int i = 0; i < kMaxWaiters; i++) {
+            waiters[i] = waiters_[i];
+            waiters_[i] = nullptr;
+        }
+        portEXIT_CRITICAL(&lock_);
+
+        Notify(producer_);
+        for (int i = 0; i < kMaxWaiters; i++) {
+            if (waiters[i] != nullptr) {
+                xTaskNotifyGiveIndexed(waiters[i], AUDIO_QUEUE_NOTIFY_INDEX);
+            }
+        }
+        return item;
+    }
+
+    void Clear() {
+        while (Pop() != nullptr) {
+        }
+    }
+
+    size_t size() const {
+        portENTER_CRITICAL(&lock_);
+        size_t count = count_;
+        portEXIT_CRITICAL(&lock_);
+        return count;
+    }
+
+    bool empty() const { return size() == 0; }
+
+private:
+    static constexpr int kMaxWaiters = 2;
+
+    static void Notify(TaskHandle_t task) {
+        if (task != nullptr) {
+            xTaskNotifyGive(task);
+        }
+    }
+
+    /* Must be called with lock_ held */
+    bool AddWaiter(TaskHandle_t task) {
+        for (int i = 0; i < kMaxWaiters; i++) {
+            if (waiters_[i] == nullptr || waiters_[i] == task) {
+                waiters_[i] = task;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::unique_ptr<T>> slots_;
+    size_t head_ = 0;
+    size_t count_ = 0;
+    TaskHandle_t consumer_ = nullptr;
+    TaskHandle_t producer_ = nullptr;
+    TaskHandle_t waiters_[kMaxWaiters] = {};
+    mutable portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif // AUDIO_QUEUE_H
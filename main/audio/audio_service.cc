@@ -1,5 +1,8 @@
 #include "audio_service.h"
+#include "object_pool.h"
 #include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -17,6 +20,112 @@
 
 #define TAG "AudioService"
 
+/* Encode queue + playback queue + uplink pre-roll + one frame held by each of the encode, decode and output tasks */
+#define AUDIO_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + MAX_PLAYBACK_TASKS_IN_QUEUE + \
+    UPLINK_DTX_PREROLL_MS / OPUS_MIN_FRAME_DURATION_MS + 3)
+
+static ObjectPool<AudioTask, AUDIO_TASK_POOL_SIZE> audio_task_pool;
+
+std::unique_ptr<AudioTask> AudioTask::Create() {
+    auto task = audio_task_pool.Acquire();
+    if (task == nullptr) {
+        return std::make_unique<AudioTask>();
+    }
+    task->pcm.clear();
+    task->timestamp = 0;
+    task->voice = true;
+    task->trace = LatencyTrace();
+    return std::unique_ptr<AudioTask>(task);
+}
+
+void std::default_delete<AudioTask>::operator()(AudioTask* task) const {
+    if (!audio_task_pool.Release(task)) {
+        delete task;
+    }
+}
+
+#if CONFIG_OPUS_TASK_STACK_IN_PSRAM
+#define OPUS_TASK_STACK_CAPS MALLOC_CAP_SPIRAM
+#else
+#define OPUS_TASK_STACK_CAPS MALLOC_CAP_INTERNAL
+#endif
+
+static TaskHandle_t CreateOpusTask(TaskFunction_t function, const char* name, uint32_t stack_size, void* arg,
+    int priority, int core, StackType_t*& stack, StaticTask_t*& buffer) {
+    if (stack == nullptr) {
+        stack = (StackType_t*)heap_caps_malloc(stack_size, OPUS_TASK_STACK_CAPS);
+        assert(stack != nullptr);
+    }
+    if (buffer == nullptr) {
+        buffer = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        assert(buffer != nullptr);
+    }
+#if CONFIG_FREERTOS_NUMBER_OF_CORES > 1
+    BaseType_t affinity = core < 0 ? tskNO_AFFINITY : core;
+#else
+    BaseType_t affinity = tskNO_AFFINITY;
+#endif
+    return xTaskCreateStaticPinnedToCore(function, name, stack_size, arg, priority, stack, buffer, affinity);
+}
+
+
+/*
+ * Stereo frames are moved as one 32-bit word (mic in the low half, reference in the high half
+ * on these little-endian targets), four frames per iteration. This halves the loads and stores
+ * of a per-sample loop and lets the compiler keep the loop in registers on both Xtensa and RISC-V.
+ */
+static void DeinterleaveStereo(const int16_t* input, int16_t* left, int16_t* right, size_t frames) {
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        uint32_t w[4];
+        memcpy(w, input + i * 2, sizeof(w));
+        left[i] = (int16_t)w[0];
+        right[i] = (int16_t)(w[0] >> 16);
+        left[i + 1] = (int16_t)w[1];
+        right[i + 1] = (int16_t)(w[1] >> 16);
+        left[i + 2] = (int16_t)w[2];
+        right[i + 2] = (int16_t)(w[2] >> 16);
+        left[i + 3] = (int16_t)w[3];
+        right[i + 3] = (int16_t)(w[3] >> 16);
+    }
+    for (; i < frames; i++) {
+        left[i] = input[i * 2];
+        right[i] = input[i * 2 + 1];
+    }
+}
+
+static void InterleaveStereo(const int16_t* left, const int16_t* right, int16_t* output, size_t frames) {
+    size_t i = 0;
+    for (; i + 4 <= frames; i += 4) {
+        uint32_t w[4];
+        w[0] = (uint16_t)left[i] | ((uint32_t)(uint16_t)right[i] << 16);
+        w[1] = (uint16_t)left[i + 1] | ((uint32_t)(uint16_t)right[i + 1] << 16);
+        w[2] = (uint16_t)left[i + 2] | ((uint32_t)(uint16_t)right[i + 2] << 16);
+        w[3] = (uint16_t)left[i + 3] | ((uint32_t)(uint16_t)right[i + 3] << 16);
+        memcpy(output + i * 2, w, sizeof(w));
+    }
+    for (; i < frames; i++) {
+        output[i * 2] = left[i];
+        output[i * 2 + 1] = right[i];
+    }
+}
+
+/* Number of frames that hold `duration_ms` of audio, at least one */
+static size_t FramesInDuration(int duration_ms, int frame_duration_ms) {
+    if (frame_duration_ms <= 0) {
+        frame_duration_ms = OPUS_FRAME_DURATION_MS;
+    }
+    return std::max(1, duration_ms / frame_duration_ms);
+}
+
+/* Keep the left (microphone) channel of interleaved stereo in place */
+static void ExtractLeftChannel(std::vector<int16_t>& data) {
+    size_t frames = data.size() / 2;
+    for (size_t i = 0; i < frames; i++) {
+        data[i] = data[i * 2];
+    }
+    data.resize(frames);
+}
 
 AudioService::AudioService() {
     event_group_ = xEventGroupCreate();
@@ -29,25 +138,38 @@ AudioService::~AudioService() {
 }
 
 
-void AudioService::Initialize(AudioCodec* codec) {
+void AudioService::Initialize(AudioCodec* codec, std::unique_ptr<AudioProcessor> audio_processor) {
     codec_ = codec;
     codec_->Start();
 
     /* Setup the audio codec */
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_ = std::make_unique<OpusEncoderWrapper>(16000, 1, OPUS_FRAME_DURATION_MS);
-    opus_encoder_->SetComplexity(0);
+    opus_decoder_ = std::make_unique<OpusStreamDecoder>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
+    opus_encoder_ = std::make_unique<OpusStreamEncoder>(16000, 1, OPUS_FRAME_DURATION_MS);
+    opus_encoder_->SetComplexity(encoder_complexity_.complexity());
+
+    audio_mixer_.SetOutputSampleRate(codec->output_sample_rate());
 
     if (codec->input_sample_rate() != 16000) {
         input_resampler_.Configure(codec->input_sample_rate(), 16000);
         reference_resampler_.Configure(codec->input_sample_rate(), 16000);
     }
 
+#if CONFIG_USE_AUDIO_DEBUGGER
+    audio_debugger_ = std::make_unique<AudioDebugger>();
+#endif
+
+#if CONFIG_USE_SOUND_CACHE
+    sound_cache_ = std::make_unique<SoundCache>(CONFIG_SOUND_CACHE_SIZE_KB * 1024);
+#endif
+
+    audio_processor_ = std::move(audio_processor);
+    if (!audio_processor_) {
 #if CONFIG_USE_AUDIO_PROCESSOR
-    audio_processor_ = std::make_unique<AfeAudioProcessor>();
+        audio_processor_ = std::make_unique<AfeAudioProcessor>();
 #else
-    audio_processor_ = std::make_unique<NoAudioProcessor>();
+        audio_processor_ = std::make_unique<NoAudioProcessor>();
 #endif
+    }
 
 #if CONFIG_USE_AFE_WAKE_WORD
     wake_word_ = std::make_unique<AfeWakeWord>();
@@ -60,11 +182,15 @@ void AudioService::Initialize(AudioCodec* codec) {
 #endif
 
     audio_processor_->OnOutput([this](std::vector<int16_t>&& data) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+        audio_debugger_->Feed(kAudioDebugStageProcessed, 16000, 1, data);
+#endif
         PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
     });
 
     audio_processor_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
+        latency_tracer_.MarkSpeechEnd(speaking);
         if (callbacks_.on_vad_change) {
             callbacks_.on_vad_change(speaking);
         }
@@ -127,12 +253,20 @@ void AudioService::Start() {
     }, "audio_output", 2048, this, 3, &audio_output_task_handle_);
 #endif
 
-    /* Start the opus codec task */
-    xTaskCreate([](void* arg) {
+    /* Start the opus decode and encode tasks */
+    opus_decode_task_handle_ = CreateOpusTask([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
-        audio_service->OpusCodecTask();
+        audio_service->OpusDecodeTask();
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 13, this, 2, &opus_codec_task_handle_);
+    }, "opus_decode", OPUS_DECODE_TASK_STACK_SIZE, this, CONFIG_OPUS_DECODE_TASK_PRIORITY,
+        CONFIG_OPUS_DECODE_TASK_CORE, opus_decode_task_stack_, opus_decode_task_buffer_);
+
+    opus_encode_task_handle_ = CreateOpusTask([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusEncodeTask();
+        vTaskDelete(NULL);
+    }, "opus_encode", OPUS_ENCODE_TASK_STACK_SIZE, this, CONFIG_OPUS_ENCODE_TASK_PRIORITY,
+        CONFIG_OPUS_ENCODE_TASK_CORE, opus_encode_task_stack_, opus_encode_task_buffer_);
 }
 
 void AudioService::Stop() {
@@ -142,12 +276,23 @@ void AudioService::Stop() {
         AS_EVENT_WAKE_WORD_RUNNING |
         AS_EVENT_AUDIO_PROCESSOR_RUNNING);
 
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    audio_encode_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    audio_encode_queue_.Clear();
+    audio_decode_queue_.Clear();
+    jitter_buffer_.Reset();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    audio_mixer_.Clear(kMixerChannelMusic);
+    audio_mixer_.Clear(kMixerChannelEffect);
+    /* Wake the consumers so they see service_stopped_ */
+    if (audio_output_task_handle_ != nullptr) {
+        xTaskNotifyGive(audio_output_task_handle_);
+    }
+    if (opus_decode_task_handle_ != nullptr) {
+        xTaskNotifyGive(opus_decode_task_handle_);
+    }
+    if (opus_encode_task_handle_ != nullptr) {
+        xTaskNotifyGive(opus_encode_task_handle_);
+    }
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
@@ -157,30 +302,29 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     }
 
     if (codec_->input_sample_rate() != sample_rate) {
-        data.resize(samples * codec_->input_sample_rate() / sample_rate);
-        if (!codec_->InputData(data)) {
+        /* Read into the service's own buffer, then resample straight into the caller's vector */
+        std::lock_guard<std::mutex> lock(input_mutex_);
+        input_buffer_.resize(samples * codec_->input_sample_rate() / sample_rate);
+        if (!codec_->InputData(input_buffer_)) {
             return false;
         }
         if (codec_->input_channels() == 2) {
-            auto mic_channel = std::vector<int16_t>(data.size() / 2);
-            auto reference_channel = std::vector<int16_t>(data.size() / 2);
-            for (size_t i = 0, j = 0; i < mic_channel.size(); ++i, j += 2) {
-                mic_channel[i] = data[j];
-                reference_channel[i] = data[j + 1];
-            }
-            auto resampled_mic = std::vector<int16_t>(input_resampler_.GetOutputSamples(mic_channel.size()));
-            auto resampled_reference = std::vector<int16_t>(reference_resampler_.GetOutputSamples(reference_channel.size()));
-            input_resampler_.Process(mic_channel.data(), mic_channel.size(), resampled_mic.data());
-            reference_resampler_.Process(reference_channel.data(), reference_channel.size(), resampled_reference.data());
-            data.resize(resampled_mic.size() + resampled_reference.size());
-            for (size_t i = 0, j = 0; i < resampled_mic.size(); ++i, j += 2) {
-                data[j] = resampled_mic[i];
-                data[j + 1] = resampled_reference[i];
-            }
+            size_t frames = input_buffer_.size() / 2;
+            int output_frames = input_resampler_.GetOutputSamples(frames);
+            /* Planar layout: [mic | reference] for the input frames, then for the resampled frames */
+            input_planar_buffer_.resize(frames * 2 + output_frames * 2);
+            int16_t* mic = input_planar_buffer_.data();
+            int16_t* reference = mic + frames;
+            int16_t* resampled_mic = reference + frames;
+            int16_t* resampled_reference = resampled_mic + output_frames;
+            DeinterleaveStereo(input_buffer_.data(), mic, reference, frames);
+            input_resampler_.Process(mic, frames, resampled_mic);
+            reference_resampler_.Process(reference, frames, resampled_reference);
+            data.resize(output_frames * 2);
+            InterleaveStereo(resampled_mic, resampled_reference, data.data(), output_frames);
         } else {
-            auto resampled = std::vector<int16_t>(input_resampler_.GetOutputSamples(data.size()));
-            input_resampler_.Process(data.data(), data.size(), resampled.data());
-            data = std::move(resampled);
+            data.resize(input_resampler_.GetOutputSamples(input_buffer_.size()));
+            input_resampler_.Process(input_buffer_.data(), input_buffer_.size(), data.data());
         }
     } else {
         data.resize(samples);
@@ -194,17 +338,16 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
     debug_statistics_.input_count++;
 
 #if CONFIG_USE_AUDIO_DEBUGGER
-    // 音频调试：发送原始音频数据
-    if (audio_debugger_ == nullptr) {
-        audio_debugger_ = std::make_unique<AudioDebugger>();
-    }
-    audio_debugger_->Feed(data);
+    // 音频调试：录制麦克风输入，双声道时第二声道为 AEC 参考信号
+    audio_debugger_->Feed(kAudioDebugStageInput, sample_rate, codec_->input_channels(), data, codec_->input_reference());
 #endif
 
     return true;
 }
 
 void AudioService::AudioInputTask() {
+    /* Reused across reads; the testing path gets a pooled task's buffer back in exchange */
+    std::vector<int16_t> data;
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
             AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING,
@@ -221,21 +364,17 @@ void AudioService::AudioInputTask() {
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+            int frame_duration = frame_duration_ms_;
+            if (audio_testing_queue_.size() >= FramesInDuration(AUDIO_TESTING_MAX_DURATION_MS, frame_duration)) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
-            int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
+            int samples = frame_duration * 16000 / 1000;
             if (ReadAudioData(data, 16000, samples)) {
                 // If input channels is 2, we need to fetch the left channel data
                 if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+                    ExtractLeftChannel(data);
                 }
                 PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
                 continue;
@@ -244,7 +383,6 @@ void AudioService::AudioInputTask() {
 
         /* Feed the wake word */
         if (bits & AS_EVENT_WAKE_WORD_RUNNING) {
-            std::vector<int16_t> data;
             int samples = wake_word_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
@@ -256,10 +394,10 @@ void AudioService::AudioInputTask() {
 
         /* Feed the audio processor */
         if (bits & AS_EVENT_AUDIO_PROCESSOR_RUNNING) {
-            std::vector<int16_t> data;
             int samples = audio_processor_->GetFeedSize();
             if (samples > 0) {
                 if (ReadAudioData(data, 16000, samples)) {
+                    latency_tracer_.MarkCaptured(data.size() / codec_->input_channels());
                     audio_processor_->Feed(std::move(data));
                     continue;
                 }
@@ -273,33 +411,59 @@ void AudioService::AudioInputTask() {
     ESP_LOGW(TAG, "Audio input task stopped");
 }
 
+/* Mean absolute sample value, a cheap loudness measure for the uplink silence gate */
+static int MeanAmplitude(const std::vector<int16_t>& pcm) {
+    if (pcm.empty()) {
+        return 0;
+    }
+    int64_t sum = 0;
+    for (auto sample : pcm) {
+        sum += std::abs(sample);
+    }
+    return sum / (int64_t)pcm.size();
+}
+
 void AudioService::AudioOutputTask() {
+    audio_playback_queue_.SetConsumer(xTaskGetCurrentTaskHandle());
+    audio_mixer_.SetConsumer(xTaskGetCurrentTaskHandle());
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() { return !audio_playback_queue_.empty() || service_stopped_; });
         if (service_stopped_) {
             break;
         }
-
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+        /* Music and effects play on their own, or are mixed into the next voice frame */
+        int sample_rate = codec_->output_sample_rate();
+        audio_mixer_.SetOutputSampleRate(sample_rate);
+        auto task = audio_playback_queue_.Pop();
+        auto& pcm = task ? task->pcm : mix_buffer_;
+        if (!task) {
+            mix_buffer_.clear();
+        }
+        if (!audio_mixer_.Mix(pcm, 0, sample_rate / 1000 * MIXER_BLOCK_DURATION_MS)) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
 
         if (!codec_->output_enabled()) {
             codec_->EnableOutput(true);
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
         }
-        codec_->OutputData(task->pcm);
+#if CONFIG_USE_AUDIO_DEBUGGER
+        audio_debugger_->Feed(kAudioDebugStagePlayback, sample_rate, 1, pcm);
+#endif
+        codec_->OutputData(pcm);
 
         /* Update the last output time */
         last_output_time_ = std::chrono::steady_clock::now();
+        if (!task) {
+            continue;
+        }
+        latency_tracer_.Finish(task->trace, kLatencyStagePlayback, kLatencyStageDownlink);
         debug_statistics_.playback_count++;
 
 #if CONFIG_USE_SERVER_AEC
         /* Record the timestamp for server AEC */
         if (task->timestamp > 0) {
-            lock.lock();
+            std::lock_guard<std::mutex> lock(timestamp_mutex_);
             timestamp_queue_.push_back(task->timestamp);
         }
 #endif
@@ -308,83 +472,269 @@ void AudioService::AudioOutputTask() {
     ESP_LOGW(TAG, "Audio output task stopped");
 }
 
-void AudioService::OpusCodecTask() {
+void AudioService::OpusDecodeTask() {
+    audio_decode_queue_.SetConsumer(xTaskGetCurrentTaskHandle());
+    jitter_buffer_.SetConsumer(xTaskGetCurrentTaskHandle());
+    /* Woken when the output task frees room in the playback queue */
+    audio_playback_queue_.SetProducer(xTaskGetCurrentTaskHandle());
+
     while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return service_stopped_ ||
-                (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
-        });
         if (service_stopped_) {
             break;
         }
-
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
-
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            if (opus_decoder_->Decode(std::move(packet->payload), task->pcm)) {
-                // Resample if the sample rate is different
-                if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
-                    int target_size = output_resampler_.GetOutputSamples(task->pcm.size());
-                    std::vector<int16_t> resampled(target_size);
-                    output_resampler_.Process(task->pcm.data(), task->pcm.size(), resampled.data());
-                    task->pcm = std::move(resampled);
+        std::unique_ptr<AudioStreamPacket> packet;
+        TickType_t wait = portMAX_DELAY;
+        if (audio_playback_queue_.size() < FramesInDuration(MAX_PLAYBACK_QUEUE_DURATION_MS, opus_decoder_->duration_ms())) {
+            packet = audio_decode_queue_.Pop();
+            if (!packet) {
+                /* The jitter buffer tells how long it holds its packets back */
+                int wait_ms;
+                packet = jitter_buffer_.Pop(wait_ms);
+                if (packet) {
+                    latency_tracer_.Stamp(packet->trace, kLatencyStageJitterBuffer);
+                } else if (wait_ms >= 0) {
+                    wait = std::max<TickType_t>(pdMS_TO_TICKS(wait_ms), 1);
                 }
-
-                lock.lock();
-                audio_playback_queue_.push_back(std::move(task));
-                audio_queue_cv_.notify_all();
-            } else {
-                ESP_LOGE(TAG, "Failed to decode audio");
-                lock.lock();
             }
-            debug_statistics_.decode_count++;
-        }
-        
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty() && audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-            if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
-                ESP_LOGE(TAG, "Failed to encode audio");
+        }
+        if (!packet) {
+            ulTaskNotifyTake(pdTRUE, wait);
+            continue;
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        int frame_duration = packet->frame_duration;
+        playback_wait_us_ = 0;
+
+        SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
+        if (decoder_reset_requested_.exchange(false)) {
+            opus_decoder_->ResetState();
+        }
+        if (packet->lost_frames > 0) {
+            ConcealLostFrames(*packet);
+        }
+        UpdatePacketLoss(packet->lost_frames);
+
+        auto task = AudioTask::Create();
+        task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+        task->timestamp = packet->timestamp;
+        task->trace = packet->trace;
+        if (opus_decoder_->Decode(packet->payload, task->pcm)) {
+            PushToPlaybackQueue(std::move(task));
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio");
+        }
+        debug_statistics_.decode_count++;
+
+        /* Waiting for the playback queue is backpressure, not decode time */
+        int64_t elapsed_us = esp_timer_get_time() - start_time - playback_wait_us_;
+        encoder_complexity_.AddDecodeTime(elapsed_us);
+        int64_t elapsed_ms = elapsed_us / 1000;
+        if (elapsed_ms > frame_duration) {
+            debug_statistics_.decode_deadline_misses++;
+            ESP_LOGW(TAG, "Decode took %lldms for a %dms frame (%lu misses)", elapsed_ms, frame_duration,
+                debug_statistics_.decode_deadline_misses);
+        }
+    }
+
+    ESP_LOGW(TAG, "Opus decode task stopped");
+}
+
+/*
+ * Fill a gap in the downlink stream before decoding the packet that follows it. All but the last
+ * missing frame are concealed by the decoder; the last one is rebuilt from the in-band FEC data
+ * carried by this packet, which libopus falls back to concealing when the sender did not add any.
+ */
+void AudioService::ConcealLostFrames(const AudioStreamPacket& packet) {
+    int frames = std::min(packet.lost_frames, MAX_CONCEALED_FRAMES_PER_GAP);
+    debug_statistics_.lost_frames += packet.lost_frames;
+    for (int i = 0; i < frames; i++) {
+        auto task = AudioTask::Create();
+        task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+        bool ok = i + 1 < frames ? opus_decoder_->Conceal(task->pcm) : opus_decoder_->DecodeFec(packet.payload, task->pcm);
+        if (!ok) {
+            break;
+        }
+        PushToPlaybackQueue(std::move(task));
+        debug_statistics_.concealed_frames++;
+    }
+    ESP_LOGD(TAG, "Concealed %d of %d lost frames", frames, packet.lost_frames);
+}
+
+void AudioService::PushToPlaybackQueue(std::unique_ptr<AudioTask> task) {
+    // Resample if the sample rate is different
+    if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+        /* Swap buffers so both the task and the scratch buffer keep their capacity */
+        output_resample_buffer_.resize(output_resampler_.GetOutputSamples(task->pcm.size()));
+        output_resampler_.Process(task->pcm.data(), task->pcm.size(), output_resample_buffer_.data());
+        task->pcm.swap(output_resample_buffer_);
+    }
+    latency_tracer_.Stamp(task->trace, kLatencyStageDecode);
+    /* Concealed frames may overfill the queue by a few frames, so wait for room if needed */
+    int64_t wait_start = esp_timer_get_time();
+    audio_playback_queue_.Push(std::move(task), true);
+    playback_wait_us_ += esp_timer_get_time() - wait_start;
+}
+
+/* Only called from the decode task */
+void AudioService::UpdatePacketLoss(int lost_frames) {
+    loss_window_frames_ += 1 + lost_frames;
+    loss_window_lost_ += lost_frames;
+    if (loss_window_frames_ < PACKET_LOSS_WINDOW_FRAMES) {
+        return;
+    }
+
+    /* Rise at once and decay slowly, so FEC stays on through bursts of loss */
+    int loss = loss_window_lost_ * 100 / loss_window_frames_;
+    int expected = expected_packet_loss_;
+    expected = loss >= expected ? loss : (expected * 3 + loss) / 4;
+    expected = std::min(expected, MAX_EXPECTED_PACKET_LOSS_PERCENT);
+    if (expected != expected_packet_loss_) {
+        ESP_LOGI(TAG, "Packet loss %d%%, expected loss for FEC set to %d%%", loss, expected);
+        expected_packet_loss_ = expected;
+    }
+    loss_window_frames_ = 0;
+    loss_window_lost_ = 0;
+}
+
+void AudioService::OpusEncodeTask() {
+    audio_encode_queue_.SetConsumer(xTaskGetCurrentTaskHandle());
+    /* Woken when the application frees room in the send queue */
+    audio_send_queue_.SetProducer(xTaskGetCurrentTaskHandle());
+
+    while (true) {
+        if (service_stopped_) {
+            break;
+        }
+        std::unique_ptr<AudioTask> task;
+        if (audio_send_queue_.size() < FramesInDuration(MAX_SEND_QUEUE_DURATION_MS, frame_duration_ms_)) {
+            task = audio_encode_queue_.Pop();
+        }
+        if (!task) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+            if (SuppressSilentFrame(task)) {
                 continue;
             }
-
-            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                {
-                    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                    audio_send_queue_.push_back(std::move(packet));
-                }
-                if (callbacks_.on_send_queue_available) {
-                    callbacks_.on_send_queue_available();
-                }
-            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-                audio_testing_queue_.push_back(std::move(packet));
+            /* Speech again: send the end of the silence first, the VAD reports speech a little late */
+            while (!uplink_preroll_.empty()) {
+                EncodeAudioTask(std::move(uplink_preroll_.front()));
+                uplink_preroll_.pop_front();
             }
-            debug_statistics_.encode_count++;
-            lock.lock();
         }
+        EncodeAudioTask(std::move(task));
+    }
+
+    ESP_LOGW(TAG, "Opus encode task stopped");
+}
+
+/* Only called from the encode task, which owns the encoder */
+void AudioService::EncodeAudioTask(std::unique_ptr<AudioTask> task) {
+    /* Follow the frame length the input side produced, which changes after a renegotiation */
+    int frame_duration = task->pcm.size() * 1000 / 16000;
+    if (frame_duration != opus_encoder_->duration_ms() && SetEncodeFrameDuration(frame_duration)) {
+        ESP_LOGI(TAG, "Opus encoder frame duration set to %dms", frame_duration);
+    }
+    /* In-band FEC is always enabled; the expected loss decides how many bits it gets */
+    int packet_loss = expected_packet_loss_;
+    if (packet_loss != opus_encoder_->packet_loss()) {
+        opus_encoder_->SetPacketLoss(packet_loss);
+    }
+    /* Keep the CPU for the music decoder and the spectrum display while music plays */
+    int complexity = encoder_complexity_.Update(!audio_mixer_.empty(kMixerChannelMusic));
+    if (complexity != opus_encoder_->complexity()) {
+        opus_encoder_->SetComplexity(complexity);
+    }
+
+    bool voice = task->voice;
+    int64_t start_time = esp_timer_get_time();
+    auto packet = AudioStreamPacket::Create();
+    packet->frame_duration = opus_encoder_->duration_ms();
+    packet->sample_rate = 16000;
+    packet->timestamp = task->timestamp;
+    packet->trace = task->trace;
+    if (!opus_encoder_->Encode(std::move(task->pcm), packet->payload)) {
+        ESP_LOGE(TAG, "Failed to encode audio");
+        return;
+    }
+    latency_tracer_.Stamp(packet->trace, kLatencyStageEncode);
+
+    if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+        uplink_toc_ = packet->payload[0];
+        has_uplink_toc_ = true;
+        PushToSendQueue(std::move(packet));
+    } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+        audio_testing_queue_.Push(std::move(packet));
+    }
+    debug_statistics_.encode_count++;
+
+    int64_t elapsed_us = esp_timer_get_time() - start_time;
+    /* Silent frames are cheaper to encode than speech with Opus DTX, and would flatter the load */
+    if (voice || !opus_encoder_->dtx()) {
+        encoder_complexity_.AddEncodeTime(elapsed_us, opus_encoder_->duration_ms());
+    }
+    int64_t elapsed_ms = elapsed_us / 1000;
+    if (elapsed_ms > opus_encoder_->duration_ms()) {
+        debug_statistics_.encode_deadline_misses++;
+        ESP_LOGW(TAG, "Encode took %lldms for a %dms frame (%lu misses)", elapsed_ms, opus_encoder_->duration_ms(),
+            debug_statistics_.encode_deadline_misses);
+    }
+}
+
+/*
+ * Only called from the encode task. Returns true if the frame was held back instead of encoded.
+ * Once the VAD has reported silence for UPLINK_DTX_HANGOVER_MS, frames are not encoded at all.
+ * Every UPLINK_DTX_KEEPALIVE_MS a one-byte Opus packet (the stream's TOC byte with no frame data,
+ * which decoders treat as a DTX frame) tells the server the stream is alive and silent.
+ */
+bool AudioService::SuppressSilentFrame(std::unique_ptr<AudioTask>& task) {
+    if (uplink_dtx_reset_requested_.exchange(false)) {
+        uplink_silence_ms_ = 0;
+        has_uplink_toc_ = false;
+        uplink_preroll_.clear();
+    }
+    if (!uplink_dtx_ || task->voice) {
+        uplink_silence_ms_ = 0;
+        return false;
     }
+    int frame_duration = task->pcm.size() * 1000 / 16000;
+    uplink_silence_ms_ += frame_duration;
+    if (uplink_silence_ms_ <= UPLINK_DTX_HANGOVER_MS || !has_uplink_toc_) {
+        return false;
+    }
+
+    int64_t now = esp_timer_get_time();
+    if (now - last_dtx_packet_time_ >= UPLINK_DTX_KEEPALIVE_MS * 1000) {
+        last_dtx_packet_time_ = now;
+        auto packet = AudioStreamPacket::Create();
+        packet->frame_duration = frame_duration;
+        packet->sample_rate = 16000;
+        packet->timestamp = task->timestamp;
+        packet->payload.assign(1, uplink_toc_ & 0xFC);  // Code 0: one frame, here of zero bytes
+        PushToSendQueue(std::move(packet));
+        debug_statistics_.dtx_packets++;
+    }
+    debug_statistics_.suppressed_frames++;
+
+    /* Held back frames would only skew the latency statistics */
+    task->trace = LatencyTrace();
+    uplink_preroll_.push_back(std::move(task));
+    while (uplink_preroll_.size() > 1 && (int)uplink_preroll_.size() * frame_duration > UPLINK_DTX_PREROLL_MS) {
+        uplink_preroll_.pop_front();
+    }
+    return true;
+}
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+void AudioService::PushToSendQueue(std::unique_ptr<AudioStreamPacket> packet) {
+    if (!audio_send_queue_.Push(std::move(packet))) {
+        debug_statistics_.send_queue_drops++;
+    }
+    if (callbacks_.on_send_queue_available) {
+        callbacks_.on_send_queue_available();
+    }
 }
 
 void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
@@ -393,60 +743,88 @@ void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
     }
 
     opus_decoder_.reset();
-    opus_decoder_ = std::make_unique<OpusDecoderWrapper>(sample_rate, 1, frame_duration);
+    opus_decoder_ = std::make_unique<OpusStreamDecoder>(sample_rate, 1, frame_duration);
+
+    if (opus_decoder_->sample_rate() != codec_->output_sample_rate()) {
+        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec_->output_sample_rate());
+        output_resampler_.Configure(opus_decoder_->sample_rate(), codec_->output_sample_rate());
+    }
+}
+
+/* Only called from the encode task, which owns the encoder */
+bool AudioService::SetEncodeFrameDuration(int frame_duration) {
+    if (!IsSupportedFrameDuration(frame_duration)) {
+        return false;
+    }
+    opus_encoder_.reset();
+    opus_encoder_ = std::make_unique<OpusStreamEncoder>(16000, 1, frame_duration);
+    opus_encoder_->SetComplexity(encoder_complexity_.complexity());
+    return true;
+}
+
+bool AudioService::IsSupportedFrameDuration(int frame_duration_ms) {
+    static const int durations[] = OPUS_SUPPORTED_FRAME_DURATIONS;
+    return std::find(std::begin(durations), std::end(durations), frame_duration_ms) != std::end(durations);
+}
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (opus_decoder_->sample_rate() != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", opus_decoder_->sample_rate(), codec->output_sample_rate());
-        output_resampler_.Configure(opus_decoder_->sample_rate(), codec->output_sample_rate());
+bool AudioService::SetFrameDuration(int frame_duration_ms) {
+    if (!IsSupportedFrameDuration(frame_duration_ms)) {
+        ESP_LOGW(TAG, "Unsupported frame duration %dms, keeping %dms", frame_duration_ms, frame_duration_ms_.load());
+        return false;
     }
+    if (frame_duration_ms_ != frame_duration_ms) {
+        ESP_LOGI(TAG, "Frame duration changed from %dms to %dms", frame_duration_ms_.load(), frame_duration_ms);
+        frame_duration_ms_ = frame_duration_ms;
+    }
+    return true;
 }
 
 void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+    auto task = AudioTask::Create();
     task->type = type;
-    task->pcm = std::move(pcm);
+    /* Hand the pooled task's old buffer back to the caller so its capacity is reused */
+    task->pcm.swap(pcm);
     
-    /* Push the task to the encode queue */
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-
     /* If the task is to send queue, we need to set the timestamp */
-    if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
-        if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
-            task->timestamp = timestamp_queue_.front();
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        /* Without a VAD (no processor, or the AFE's is off for device AEC) fall back to the level */
+        if (audio_processor_->IsVadEnabled()) {
+            task->voice = voice_detected_;
         } else {
-            ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+            task->voice = !uplink_dtx_ || MeanAmplitude(task->pcm) >= UPLINK_DTX_SILENCE_LEVEL;
+        }
+        latency_tracer_.Begin(task->trace, latency_tracer_.CaptureTime(task->pcm.size()));
+        latency_tracer_.Stamp(task->trace, kLatencyStageProcess);
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
+        if (!timestamp_queue_.empty()) {
+            if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
+                task->timestamp = timestamp_queue_.front();
+            } else {
+                ESP_LOGW(TAG, "Timestamp queue (%u) is full, dropping timestamp", timestamp_queue_.size());
+            }
+            timestamp_queue_.pop_front();
         }
-        timestamp_queue_.pop_front();
     }
 
-    audio_queue_cv_.wait(lock, [this]() { return audio_encode_queue_.size() < MAX_ENCODE_TASKS_IN_QUEUE; });
-    audio_encode_queue_.push_back(std::move(task));
-    audio_queue_cv_.notify_all();
+    /* Push the task to the encode queue, waiting for the codec task if it is full */
+    audio_encode_queue_.Push(std::move(task), true, FramesInDuration(MAX_ENCODE_QUEUE_DURATION_MS, frame_duration_ms_));
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() { return audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE; });
-        } else {
-            return false;
-        }
-    }
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
-    return true;
+    size_t limit = FramesInDuration(MAX_DECODE_QUEUE_DURATION_MS, packet->frame_duration);
+    return audio_decode_queue_.Push(std::move(packet), wait, limit);
+}
+
+bool AudioService::PushPacketToJitterBuffer(std::unique_ptr<AudioStreamPacket> packet) {
+    latency_tracer_.Begin(packet->trace);
+    return jitter_buffer_.Push(std::move(packet));
 }
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
-        return nullptr;
+    auto packet = audio_send_queue_.Pop();
+    if (packet) {
+        latency_tracer_.Stamp(packet->trace, kLatencyStageSendQueue);
     }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
     return packet;
 }
 
@@ -494,13 +872,18 @@ void AudioService::EnableVoiceProcessing(bool enable) {
     ESP_LOGD(TAG, "%s voice processing", enable ? "Enabling" : "Disabling");
     if (enable) {
         if (!audio_processor_initialized_) {
-            audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS);
+            audio_processor_->Initialize(codec_, frame_duration_ms_);
             audio_processor_initialized_ = true;
+        } else {
+            /* The processor is stopped here, so it is safe to change its output frame size */
+            audio_processor_->SetFrameDuration(frame_duration_ms_);
         }
 
         /* We should make sure no audio is playing */
         ResetDecoder();
         audio_input_need_warmup_ = true;
+        latency_tracer_.ResetCapture();
+        uplink_dtx_reset_requested_ = true;
         audio_processor_->Start();
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
     } else {
@@ -515,28 +898,42 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        audio_queue_cv_.notify_all();
+        /* Move audio_testing_queue_ to audio_decode_queue_ */
+        audio_decode_queue_.Clear();
+        while (auto packet = audio_testing_queue_.Pop()) {
+            audio_decode_queue_.Push(std::move(packet));
+        }
     }
 }
 
 void AudioService::EnableDeviceAec(bool enable) {
     ESP_LOGI(TAG, "%s device AEC", enable ? "Enabling" : "Disabling");
     if (!audio_processor_initialized_) {
-        audio_processor_->Initialize(codec_, OPUS_FRAME_DURATION_MS);
+        audio_processor_->Initialize(codec_, frame_duration_ms_);
         audio_processor_initialized_ = true;
     }
 
     audio_processor_->EnableDeviceAec(enable);
 }
 
+void AudioService::EnableUplinkDtx(bool enable) {
+    ESP_LOGI(TAG, "%s uplink DTX", enable ? "Enabling" : "Disabling");
+    uplink_dtx_ = enable;
+    uplink_dtx_reset_requested_ = true;
+}
+
 void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
     callbacks_ = callbacks;
 }
 
 void AudioService::PlaySound(const std::string_view& sound) {
+    if (sound_cache_ != nullptr) {
+        auto clip = sound_cache_->Get(sound, codec_->output_sample_rate());
+        if (clip != nullptr && audio_mixer_.PlayClip(std::move(clip))) {
+            return;
+        }
+    }
+
     const char* data = sound.data();
     size_t size = sound.size();
     for (const char* p = data; p < data + size; ) {
@@ -544,11 +941,10 @@ void AudioService::PlaySound(const std::string_view& sound) {
         p += sizeof(BinaryProtocol3);
 
         auto payload_size = ntohs(p3->payload_size);
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto packet = AudioStreamPacket::Create();
         packet->sample_rate = 16000;
         packet->frame_duration = 60;
-        packet->payload.resize(payload_size);
-        memcpy(packet->payload.data(), p3->payload, payload_size);
+        packet->payload.assign(p3->payload, p3->payload + payload_size);
         p += payload_size;
 
         PushPacketToDecodeQueue(std::move(packet), true);
@@ -556,18 +952,64 @@ void AudioService::PlaySound(const std::string_view& sound) {
 }
 
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && audio_playback_queue_.empty() && audio_testing_queue_.empty();
+    return audio_encode_queue_.empty() && audio_decode_queue_.empty() && jitter_buffer_.empty() &&
+        audio_playback_queue_.empty() && audio_testing_queue_.empty() && audio_mixer_.empty(kMixerChannelEffect);
 }
 
 void AudioService::ResetDecoder() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    opus_decoder_->ResetState();
-    timestamp_queue_.clear();
-    audio_decode_queue_.clear();
-    audio_playback_queue_.clear();
-    audio_testing_queue_.clear();
-    audio_queue_cv_.notify_all();
+    /* The decoder belongs to the decode task, which resets it before its next packet */
+    decoder_reset_requested_ = true;
+    {
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
+        timestamp_queue_.clear();
+    }
+    audio_decode_queue_.Clear();
+    jitter_buffer_.Reset();
+    audio_playback_queue_.Clear();
+    audio_testing_queue_.Clear();
+    audio_mixer_.Clear(kMixerChannelEffect);
+}
+
+bool AudioService::PushMusicPcm(const int16_t* pcm, size_t samples, int sample_rate) {
+    if (service_stopped_) {
+        return false;
+    }
+    return audio_mixer_.Write(kMixerChannelMusic, pcm, samples, sample_rate, pdMS_TO_TICKS(MIXER_WRITE_TIMEOUT_MS));
+}
+
+bool AudioService::PushEffectPcm(const int16_t* pcm, size_t samples, int sample_rate) {
+    if (service_stopped_) {
+        return false;
+    }
+    return audio_mixer_.Write(kMixerChannelEffect, pcm, samples, sample_rate, pdMS_TO_TICKS(MIXER_WRITE_TIMEOUT_MS));
+}
+
+void AudioService::ClearMusic() {
+    audio_mixer_.Clear(kMixerChannelMusic);
+}
+
+cJSON* AudioService::DownlinkStatisticsJson() const {
+    auto jitter = jitter_buffer_.statistics();
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "jitter_ms", jitter.jitter_ms);
+    cJSON_AddNumberToObject(json, "target_delay_ms", jitter.target_delay_ms);
+    cJSON_AddNumberToObject(json, "buffered_ms", jitter.buffered_ms);
+    cJSON_AddNumberToObject(json, "late_discards", jitter.late_discards);
+    cJSON_AddNumberToObject(json, "duplicate_discards", jitter.duplicate_discards);
+    cJSON_AddNumberToObject(json, "overflow_discards", jitter.overflow_discards);
+    cJSON_AddNumberToObject(json, "underruns", jitter.underruns);
+    cJSON_AddNumberToObject(json, "lost_frames", debug_statistics_.lost_frames);
+    cJSON_AddNumberToObject(json, "concealed_frames", debug_statistics_.concealed_frames);
+    return json;
+}
+
+AudioQueueDepths AudioService::queue_depths() const {
+    AudioQueueDepths depths;
+    depths.encode = audio_encode_queue_.size();
+    depths.send = audio_send_queue_.size();
+    depths.decode = audio_decode_queue_.size();
+    depths.playback = audio_playback_queue_.size();
+    return depths;
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
@@ -2,23 +2,31 @@
 #define AUDIO_SERVICE_H
 
 #include <memory>
+#include <algorithm>
 #include <deque>
-#include <condition_variable>
 #include <chrono>
 #include <mutex>
+#include <atomic>
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
 #include <esp_timer.h>
+#include <cJSON.h>
 
 #include <opus_encoder.h>
-#include <opus_decoder.h>
 #include <opus_resampler.h>
 
 #include "audio_codec.h"
+#include "audio_mixer.h"
 #include "audio_processor.h"
+#include "audio_queue.h"
+#include "encoder_complexity_controller.h"
+#include "jitter_buffer.h"
+#include "latency_tracer.h"
+#include "opus_stream.h"
 #include "processors/audio_debugger.h"
+#include "sound_cache.h"
 #include "wake_word.h"
 #include "protocol.h"
 
@@ -26,21 +34,68 @@
 /*
  * There are two types of audio data flow:
  * 1. (MIC) -> [Processors] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
- * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
+ * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> [Mixer] -> (Speaker)
  *
- * We use one task for MIC / Speaker / Processors, and one task for Opus Encoder / Opus Decoder.
+ * The mixer also plays the music and effect PCM written with PushMusicPcm / PushEffectPcm,
+ * ducking the music while the voice or an effect plays.
+ *
+ * We use one task for MIC / Speaker / Processors, and separate tasks for the Opus Encoder and the
+ * Opus Decoder, so a slow encode never delays playback in full-duplex mode and vice versa.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
+ *
+ * Each queue is a bounded AudioQueue that wakes only the task on the other side of it,
+ * so a push to the playback queue does not wake the input task or the codec task.
  * 
  */
 
-#define OPUS_FRAME_DURATION_MS 60
-#define MAX_ENCODE_TASKS_IN_QUEUE 2
-#define MAX_PLAYBACK_TASKS_IN_QUEUE 2
-#define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
-#define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
+/* Default Opus frame duration; the server may pick another supported one in its hello */
+#define OPUS_FRAME_DURATION_MS CONFIG_OPUS_FRAME_DURATION_MS
+#define OPUS_SUPPORTED_FRAME_DURATIONS {20, 40, 60}
+#define OPUS_MIN_FRAME_DURATION_MS 20
+/* The uplink encoder complexity follows the CPU load within this range; 0 is the fastest */
+#define OPUS_MIN_COMPLEXITY 0
+#define OPUS_MAX_COMPLEXITY CONFIG_OPUS_MAX_COMPLEXITY
+
+/*
+ * Queue depths are given in milliseconds of audio and converted to a frame count with the
+ * frame duration in use, so the buffered latency is the same for every frame duration.
+ * Queue capacities are sized for the shortest frame duration.
+ */
+#define MAX_ENCODE_QUEUE_DURATION_MS 120
+#define MAX_PLAYBACK_QUEUE_DURATION_MS 120
+#define MAX_DECODE_QUEUE_DURATION_MS 2400
+#define MAX_SEND_QUEUE_DURATION_MS 2400
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
+#define MAX_ENCODE_TASKS_IN_QUEUE (MAX_ENCODE_QUEUE_DURATION_MS / OPUS_MIN_FRAME_DURATION_MS)
+#define MAX_PLAYBACK_TASKS_IN_QUEUE (MAX_PLAYBACK_QUEUE_DURATION_MS / OPUS_MIN_FRAME_DURATION_MS)
+#define MAX_DECODE_PACKETS_IN_QUEUE (MAX_DECODE_QUEUE_DURATION_MS / OPUS_MIN_FRAME_DURATION_MS)
+#define MAX_SEND_PACKETS_IN_QUEUE (MAX_SEND_QUEUE_DURATION_MS / OPUS_MIN_FRAME_DURATION_MS)
+#define MAX_TESTING_PACKETS_IN_QUEUE (AUDIO_TESTING_MAX_DURATION_MS / OPUS_MIN_FRAME_DURATION_MS)
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+/* Without a voice frame, the output task mixes the music and effects in blocks of this length */
+#define MIXER_BLOCK_DURATION_MS 20
+/* A music or effect producer gives up on a frame if playback has not made room for this long */
+#define MIXER_WRITE_TIMEOUT_MS 1000
+/*
+ * Uplink silence suppression, when the server accepts it: after this much silence the encoder
+ * stops and a one-byte DTX packet is sent now and then, and the last frames of the silence are
+ * kept to be sent ahead of the next speech, since the VAD reports it a bit late. A frame is
+ * silent when the VAD says so; processors without a VAD (or with it off for device AEC) use
+ * the frame's mean amplitude against the level instead.
+ */
+#define UPLINK_DTX_HANGOVER_MS 600
+#define UPLINK_DTX_SILENCE_LEVEL 200
+#define UPLINK_DTX_KEEPALIVE_MS 400
+#define UPLINK_DTX_PREROLL_MS 120
+/* Longer gaps are not worth bridging; the decoder simply resumes with the next packet */
+#define MAX_CONCEALED_FRAMES_PER_GAP 3
+/* Downlink packet loss is measured over this many frames and used as the uplink's expected loss */
+#define PACKET_LOSS_WINDOW_FRAMES 50
+#define MAX_EXPECTED_PACKET_LOSS_PERCENT 30
+
+#define OPUS_DECODE_TASK_STACK_SIZE (2048 * 8)
+#define OPUS_ENCODE_TASK_STACK_SIZE (2048 * 13)
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -69,13 +124,45 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp;
+    bool voice;    // VAD state when the frame left the audio processor
+    LatencyTrace trace;
+
+    /* Takes a task from a preallocated pool (or the heap when the pool is empty).
+     * Pooled tasks keep their PCM capacity between frames. */
+    static std::unique_ptr<AudioTask> Create();
+};
+
+namespace std {
+template <>
+struct default_delete<AudioTask> {
+    void operator()(AudioTask* task) const;
 };
+}
 
 struct DebugStatistics {
     uint32_t input_count = 0;
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    /* Frames that took longer to decode / encode than the audio they contain */
+    uint32_t decode_deadline_misses = 0;
+    uint32_t encode_deadline_misses = 0;
+    /* Downlink frames reported missing by the transport, and frames synthesized for them */
+    uint32_t lost_frames = 0;
+    uint32_t concealed_frames = 0;
+    /* Uplink frames not encoded during silence, and the DTX packets sent instead */
+    uint32_t suppressed_frames = 0;
+    uint32_t dtx_packets = 0;
+    /* Encoded packets dropped because the application did not drain the send queue */
+    uint32_t send_queue_drops = 0;
+};
+
+/* Items waiting in each pipeline queue at one instant */
+struct AudioQueueDepths {
+    size_t encode = 0;
+    size_t send = 0;
+    size_t decode = 0;
+    size_t playback = 0;
 };
 
 class AudioService {
@@ -83,7 +170,8 @@ public:
     AudioService();
     ~AudioService();
 
-    void Initialize(AudioCodec* codec);
+    /* Without an audio processor, the one selected in the build configuration is used */
+    void Initialize(AudioCodec* codec, std::unique_ptr<AudioProcessor> audio_processor = nullptr);
     void Start();
     void Stop();
     void EncodeWakeWord();
@@ -98,16 +186,35 @@ public:
     void EnableVoiceProcessing(bool enable);
     void EnableAudioTesting(bool enable);
     void EnableDeviceAec(bool enable);
+    /* Stop encoding the uplink during silence; only when the server accepted "dtx" in its hello */
+    void EnableUplinkDtx(bool enable);
 
     void SetCallbacks(AudioServiceCallbacks& callbacks);
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
+    /* Audio from the server goes through the jitter buffer, local sounds straight to the decode queue */
+    bool PushPacketToJitterBuffer(std::unique_ptr<AudioStreamPacket> packet);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    /* Plays through the sound cache on the mixer's effect channel when enabled, else through the Opus decoder */
     void PlaySound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
+    /* Blocking: returns once the PCM is queued in the mixer, so the caller is paced by playback */
+    bool PushMusicPcm(const int16_t* pcm, size_t samples, int sample_rate);
+    bool PushEffectPcm(const int16_t* pcm, size_t samples, int sample_rate);
+    void ClearMusic();
+    /* Set the uplink frame duration negotiated with the server, returns false if unsupported */
+    bool SetFrameDuration(int frame_duration_ms);
+    int frame_duration_ms() const { return frame_duration_ms_; }
     
     void UpdateOutputTimestamp();
+    const DebugStatistics& debug_statistics() const { return debug_statistics_; }
+    JitterBufferStatistics jitter_buffer_statistics() const { return jitter_buffer_.statistics(); }
+    /* Jitter buffer statistics plus the downlink loss and concealment counters, for device status reports */
+    cJSON* DownlinkStatisticsJson() const;
+    AudioQueueDepths queue_depths() const;
+    LatencyTracer& latency_tracer() { return latency_tracer_; }
+    AudioMixer& audio_mixer() { return audio_mixer_; }
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -115,33 +222,63 @@ private:
     std::unique_ptr<AudioProcessor> audio_processor_;
     std::unique_ptr<WakeWord> wake_word_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
-    std::unique_ptr<OpusEncoderWrapper> opus_encoder_;
-    std::unique_ptr<OpusDecoderWrapper> opus_decoder_;
+    std::unique_ptr<SoundCache> sound_cache_;
+    std::unique_ptr<OpusStreamEncoder> opus_encoder_;
+    std::unique_ptr<OpusStreamDecoder> opus_decoder_;
     OpusResampler input_resampler_;
     OpusResampler reference_resampler_;
     OpusResampler output_resampler_;
+    std::vector<int16_t> output_resample_buffer_;  // Only used by the decode task
+    int64_t playback_wait_us_ = 0;  // Time the decode task spent waiting for room in the playback queue
+    AudioMixer audio_mixer_;
+    std::vector<int16_t> mix_buffer_;  // Only used by the output task
+    // Scratch buffers for ReadAudioData, which is also called from outside the input task
+    std::mutex input_mutex_;
+    std::vector<int16_t> input_buffer_;
+    std::vector<int16_t> input_planar_buffer_;
     DebugStatistics debug_statistics_;
+    LatencyTracer latency_tracer_;
+    EncoderComplexityController encoder_complexity_{OPUS_MIN_COMPLEXITY, OPUS_MAX_COMPLEXITY};
 
     EventGroupHandle_t event_group_;
 
     // Audio encode / decode
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
+    TaskHandle_t opus_decode_task_handle_ = nullptr;
+    TaskHandle_t opus_encode_task_handle_ = nullptr;
+    StaticTask_t* opus_decode_task_buffer_ = nullptr;
+    StaticTask_t* opus_encode_task_buffer_ = nullptr;
+    StackType_t* opus_decode_task_stack_ = nullptr;
+    StackType_t* opus_encode_task_stack_ = nullptr;
+    // The decode queue also receives the recorded packets when audio testing ends
+    AudioQueue<AudioStreamPacket> audio_decode_queue_{std::max(MAX_DECODE_PACKETS_IN_QUEUE, MAX_TESTING_PACKETS_IN_QUEUE)};
+    AudioQueue<AudioStreamPacket> audio_send_queue_{MAX_SEND_PACKETS_IN_QUEUE};
+    AudioQueue<AudioStreamPacket> audio_testing_queue_{MAX_TESTING_PACKETS_IN_QUEUE};
+    AudioQueue<AudioTask> audio_encode_queue_{MAX_ENCODE_TASKS_IN_QUEUE};
+    AudioQueue<AudioTask> audio_playback_queue_{MAX_PLAYBACK_TASKS_IN_QUEUE};
+    JitterBuffer jitter_buffer_;
     // For server AEC
+    std::mutex timestamp_mutex_;
     std::deque<uint32_t> timestamp_queue_;
 
     bool wake_word_initialized_ = false;
     bool audio_processor_initialized_ = false;
     bool voice_detected_ = false;
     bool service_stopped_ = true;
+    std::atomic<int> frame_duration_ms_{OPUS_FRAME_DURATION_MS};
+    std::atomic<int> expected_packet_loss_{0};
+    std::atomic<bool> decoder_reset_requested_{false};
+    std::atomic<bool> uplink_dtx_{false};
+    std::atomic<bool> uplink_dtx_reset_requested_{false};
+    // Only used by the encode task
+    int uplink_silence_ms_ = 0;
+    int64_t last_dtx_packet_time_ = 0;
+    bool has_uplink_toc_ = false;
+    uint8_t uplink_toc_ = 0;
+    std::deque<std::unique_ptr<AudioTask>> uplink_preroll_;
+    int loss_window_frames_ = 0;
+    int loss_window_lost_ = 0;
     bool audio_input_need_warmup_ = false;
 
     esp_timer_handle_t audio_power_timer_ = nullptr;
@@ -150,9 +287,18 @@ private:
 
     void AudioInputTask();
     void AudioOutputTask();
-    void OpusCodecTask();
+    void OpusDecodeTask();
+    void OpusEncodeTask();
     void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void EncodeAudioTask(std::unique_ptr<AudioTask> task);
+    bool SuppressSilentFrame(std::unique_ptr<AudioTask>& task);
+    void PushToSendQueue(std::unique_ptr<AudioStreamPacket> packet);
     void SetDecodeSampleRate(int sample_rate, int frame_duration);
+    void ConcealLostFrames(const AudioStreamPacket& packet);
+    void PushToPlaybackQueue(std::unique_ptr<AudioTask> task);
+    void UpdatePacketLoss(int lost_frames);
+    bool SetEncodeFrameDuration(int frame_duration);
+    static bool IsSupportedFrameDuration(int frame_duration_ms);
     void CheckAndUpdateAudioPowerState();
 };
 
@@ -0,0 +1,97 @@
+#include "encoder_complexity_controller.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#define TAG "EncoderComplexity"
+
+/* Audio encoded per evaluation */
+#define COMPLEXITY_WINDOW_MS 2000
+/*
+ * Loads in 1/1000 of the frame budget. The mean load is encode time per encoded audio plus the
+ * decode task's share of the wall time; above the high mark, or with a single frame above the
+ * peak mark, the complexity steps down. A step up is taken if the load expected after it (the
+ * encode part grows by about half per step) stays below the high mark.
+ */
+#define COMPLEXITY_HIGH_LOAD_PERMILLE 600
+#define COMPLEXITY_PEAK_LOAD_PERMILLE 850
+#define COMPLEXITY_STEP_UP_COST_PERCENT 150
+#define COMPLEXITY_STEP_DOWN 2
+/* Windows to wait before stepping up, doubled after every step down */
+#define COMPLEXITY_MIN_STEP_UP_WINDOWS 2
+#define COMPLEXITY_MAX_STEP_UP_WINDOWS 64
+
+EncoderComplexityController::EncoderComplexityController(int min_complexity, int max_complexity)
+    : min_complexity_(min_complexity), max_complexity_(std::max(min_complexity, max_complexity)),
+      complexity_(min_complexity), step_up_windows_(COMPLEXITY_MIN_STEP_UP_WINDOWS) {
+}
+
+void EncoderComplexityController::AddEncodeTime(int64_t elapsed_us, int frame_duration_ms) {
+    if (pinned_ || frame_duration_ms <= 0) {
+        return;
+    }
+    if (encoded_ms_ == 0) {
+        StartWindow(esp_timer_get_time() - elapsed_us);
+    }
+    encode_us_ += elapsed_us;
+    encoded_ms_ += frame_duration_ms;
+    peak_permille_ = std::max(peak_permille_, (int)(elapsed_us / frame_duration_ms));
+}
+
+int EncoderComplexityController::Update(bool pinned) {
+    if (pinned != pinned_) {
+        pinned_ = pinned;
+        encoded_ms_ = 0;
+        if (pinned && complexity_ != min_complexity_) {
+            ESP_LOGI(TAG, "Pinned to complexity %d", min_complexity_);
+            complexity_ = min_complexity_;
+        }
+    }
+    if (pinned_ || encoded_ms_ < COMPLEXITY_WINDOW_MS) {
+        return complexity_;
+    }
+
+    int64_t now = esp_timer_get_time();
+    int64_t wall_us = std::max<int64_t>(now - window_start_us_, 1);
+    int encode_load = encode_us_ / encoded_ms_;
+    int decode_load = decode_us_.load(std::memory_order_relaxed) * 1000 / wall_us;
+    int load = encode_load + decode_load;
+    int peak = peak_permille_;
+    StartWindow(now);
+    windows_since_change_++;
+
+    if ((load > COMPLEXITY_HIGH_LOAD_PERMILLE || peak > COMPLEXITY_PEAK_LOAD_PERMILLE) && complexity_ > min_complexity_) {
+        complexity_ = std::max(complexity_ - COMPLEXITY_STEP_DOWN, min_complexity_);
+        /* Only a step up that just failed backs off; a load that came up later starts over */
+        if (windows_since_change_ <= step_up_windows_) {
+            step_up_windows_ = std::min(step_up_windows_ * 2, COMPLEXITY_MAX_STEP_UP_WINDOWS);
+        } else {
+            step_up_windows_ = COMPLEXITY_MIN_STEP_UP_WINDOWS;
+        }
+        windows_since_change_ = 0;
+        ESP_LOGW(TAG, "Load %d%% (encode %d%%, decode %d%%, peak %d%%), complexity down to %d",
+            load / 10, encode_load / 10, decode_load / 10, peak / 10, complexity_);
+        return complexity_;
+    }
+
+    int expected_load = encode_load * COMPLEXITY_STEP_UP_COST_PERCENT / 100 + decode_load;
+    int expected_peak = peak * COMPLEXITY_STEP_UP_COST_PERCENT / 100;
+    if (complexity_ < max_complexity_ && windows_since_change_ >= step_up_windows_ &&
+        expected_load <= COMPLEXITY_HIGH_LOAD_PERMILLE && expected_peak <= COMPLEXITY_PEAK_LOAD_PERMILLE) {
+        complexity_++;
+        windows_since_change_ = 0;
+        ESP_LOGI(TAG, "Load %d%% (encode %d%%, decode %d%%, peak %d%%), complexity up to %d",
+            load / 10, encode_load / 10, decode_load / 10, peak / 10, complexity_);
+    }
+    return complexity_;
+}
+
+void EncoderComplexityController::StartWindow(int64_t now) {
+    window_start_us_ = now;
+    encode_us_ = 0;
+    encoded_ms_ = 0;
+    peak_permille_ = 0;
+    decode_us_.store(0, std::memory_order_relaxed);
+}
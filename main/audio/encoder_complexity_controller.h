@@ -0,0 +1,54 @@
+#ifndef ENCODER_COMPLEXITY_CONTROLLER_H
+#define ENCODER_COMPLEXITY_CONTROLLER_H
+
+#include <atomic>
+#include <cstdint>
+
+/*
+ * Picks the uplink Opus encoder complexity from the measured CPU load.
+ *
+ * The encode task reports the wall time of every frame it encodes, which includes the time it
+ * was preempted by the AFE and the other audio tasks, and the decode task reports its busy time.
+ * Every window the load is compared with the frame budget: the complexity goes down at once when
+ * the load or a single frame comes too close to it, and up one step at a time when the load
+ * expected at the next step still leaves the safety margin. After a step down, stepping up again
+ * waits longer each time, so a setting that does not fit is not retried every window.
+ *
+ * While pinned (music playing, with the spectrum display running beside it) the complexity stays
+ * at the minimum and no window is evaluated.
+ */
+class EncoderComplexityController {
+public:
+    EncoderComplexityController(int min_complexity, int max_complexity);
+    EncoderComplexityController(const EncoderComplexityController&) = delete;
+    EncoderComplexityController& operator=(const EncoderComplexityController&) = delete;
+
+    /* Encode task: one encoded frame */
+    void AddEncodeTime(int64_t elapsed_us, int frame_duration_ms);
+    /* Decode task: time spent decoding, from any number of frames */
+    void AddDecodeTime(int64_t elapsed_us) { decode_us_.fetch_add(elapsed_us, std::memory_order_relaxed); }
+
+    /* Encode task: returns the complexity to use for the next frame */
+    int Update(bool pinned);
+    int complexity() const { return complexity_; }
+
+private:
+    void StartWindow(int64_t now);
+
+    int min_complexity_;
+    int max_complexity_;
+    int complexity_;
+    bool pinned_ = false;
+
+    // Current window, only touched by the encode task except for decode_us_
+    int64_t window_start_us_ = 0;
+    int64_t encode_us_ = 0;
+    int encoded_ms_ = 0;
+    int peak_permille_ = 0;      // Slowest frame of the window, in 1/1000 of its duration
+    std::atomic<int64_t> decode_us_{0};
+
+    int step_up_windows_;        // Windows to wait after a step down before trying to step up
+    int windows_since_change_ = 0;
+};
+
+#endif // ENCODER_COMPLEXITY_CONTROLLER_H
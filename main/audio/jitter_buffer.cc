@@ -0,0 +1,195 @@
+#include "jitter_buffer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "JitterBuffer"
+
+/* Used until the first packet tells the frame duration */
+#define JITTER_BUFFER_DEFAULT_FRAME_DURATION_MS 60
+/* Same budget as the decode queue it feeds */
+#define JITTER_BUFFER_MAX_DURATION_MS 2400
+/* Target delay = one frame + this many times the jitter, capped */
+#define JITTER_BUFFER_JITTER_MULTIPLIER 4
+#define JITTER_BUFFER_MAX_TARGET_DELAY_MS 1000
+/* A sequence number this far behind the next frame means the sender restarted its stream */
+#define JITTER_BUFFER_RESYNC_FRAMES 100
+/* A longer silence between packets is a pause between streams, not jitter or an underrun */
+#define JITTER_BUFFER_STREAM_GAP_MS 500
+
+static int64_t NowMs() {
+    return esp_timer_get_time() / 1000;
+}
+
+bool JitterBuffer::Push(std::unique_ptr<AudioStreamPacket> packet) {
+    int64_t now = NowMs();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (packet->frame_duration > 0) {
+            frame_duration_ = packet->frame_duration;
+        } else if (frame_duration_ == 0) {
+            frame_duration_ = JITTER_BUFFER_DEFAULT_FRAME_DURATION_MS;
+        }
+        /* Reliable transports deliver in order, number their packets by arrival */
+        if (packet->sequence == 0) {
+            packet->sequence = ++local_sequence_;
+        }
+        uint32_t sequence = packet->sequence;
+
+        if (playing_ || !entries_.empty()) {
+            uint32_t reference = playing_ ? next_sequence_ : entries_.front().packet->sequence;
+            int32_t behind = (int32_t)(reference - sequence);
+            if (behind > JITTER_BUFFER_RESYNC_FRAMES) {
+                ESP_LOGI(TAG, "Sequence jumped back from %lu to %lu, restarting", reference, sequence);
+                entries_.clear();
+                playing_ = false;
+                has_last_ = false;
+            } else if (playing_ && behind > 0) {
+                statistics_.late_discards++;
+                ESP_LOGW(TAG, "Discarding late packet %lu, next frame is %lu", sequence, next_sequence_);
+                return false;
+            }
+        } else if (dry_since_ms_ > 0) {
+            /* Ran dry while playing: if this packet is more than a frame late, playback starved */
+            int64_t late = now - dry_since_ms_;
+            if (late > frame_duration_ && late < JITTER_BUFFER_STREAM_GAP_MS) {
+                statistics_.underruns++;
+            }
+        }
+        dry_since_ms_ = 0;
+
+        /* Keep the entries in sequence order, searching from the back as most packets arrive in order */
+        auto it = entries_.end();
+        while (it != entries_.begin() && (int32_t)((it - 1)->packet->sequence - sequence) >= 0) {
+            --it;
+            if (it->packet->sequence == sequence) {
+                statistics_.duplicate_discards++;
+                ESP_LOGD(TAG, "Discarding duplicate packet %lu", sequence);
+                return false;
+            }
+        }
+        if (BufferedMs() >= JITTER_BUFFER_MAX_DURATION_MS) {
+            statistics_.overflow_discards++;
+            ESP_LOGW(TAG, "Buffer full (%dms), discarding packet %lu", BufferedMs(), sequence);
+            return false;
+        }
+
+        UpdateJitter(*packet, now);
+        entries_.insert(it, Entry{std::move(packet), now});
+    }
+
+    if (consumer_ != nullptr) {
+        xTaskNotifyGive(consumer_);
+    }
+    return true;
+}
+
+std::unique_ptr<AudioStreamPacket> JitterBuffer::Pop(int& wait_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    wait_ms = -1;
+    if (entries_.empty()) {
+        if (playing_) {
+            /* Build up the target delay again before the next packet is played */
+            playing_ = false;
+            dry_since_ms_ = NowMs();
+        }
+        return nullptr;
+    }
+
+    auto& front = entries_.front();
+    int target = TargetDelayMs();
+    int buffered = BufferedMs();
+    int waited = NowMs() - front.arrival_ms;
+
+    if (!playing_) {
+        /* Build up the target delay, or release what we have once the first packet waited that long */
+        if (buffered < target && waited < target) {
+            wait_ms = target - waited;
+            return nullptr;
+        }
+        playing_ = true;
+        next_sequence_ = front.packet->sequence;
+        ESP_LOGD(TAG, "Start playing with %dms buffered, target %dms, jitter %dms", buffered, target, jitter_q4_ >> 4);
+    }
+
+    int lost = (int32_t)(front.packet->sequence - next_sequence_);
+    if (lost > 0) {
+        /* The next frame is missing: give it time to arrive until the frames behind it cover the target delay */
+        if (buffered < target && waited < target) {
+            wait_ms = target - waited;
+            return nullptr;
+        }
+        statistics_.lost_frames += lost;
+        ESP_LOGD(TAG, "Frames %lu-%lu lost", next_sequence_, front.packet->sequence - 1);
+    }
+
+    auto packet = std::move(front.packet);
+    entries_.pop_front();
+    packet->lost_frames = std::max(lost, 0);
+    next_sequence_ = packet->sequence + 1;
+    return packet;
+}
+
+void JitterBuffer::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    playing_ = false;
+    has_last_ = false;
+    dry_since_ms_ = 0;
+}
+
+bool JitterBuffer::empty() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.empty();
+}
+
+JitterBufferStatistics JitterBuffer::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    JitterBufferStatistics statistics = statistics_;
+    statistics.jitter_ms = jitter_q4_ >> 4;
+    statistics.target_delay_ms = TargetDelayMs();
+    statistics.buffered_ms = BufferedMs();
+    return statistics;
+}
+
+/* Must be called with mutex_ held */
+int JitterBuffer::BufferedMs() const {
+    if (entries_.empty()) {
+        return 0;
+    }
+    return ((int32_t)(entries_.back().packet->sequence - entries_.front().packet->sequence) + 1) * frame_duration_;
+}
+
+/* Must be called with mutex_ held */
+int JitterBuffer::TargetDelayMs() const {
+    int target = frame_duration_ + JITTER_BUFFER_JITTER_MULTIPLIER * (jitter_q4_ >> 4);
+    return std::min(target, JITTER_BUFFER_MAX_TARGET_DELAY_MS);
+}
+
+/* Interarrival jitter as in RFC 3550: J += (|D| - J) / 16, where D is how much the arrival
+ * spacing of two consecutive frames differs from their spacing in the stream */
+void JitterBuffer::UpdateJitter(const AudioStreamPacket& packet, int64_t arrival_ms) {
+    if (has_last_ && (int32_t)(packet.sequence - last_sequence_) <= 0) {
+        return;
+    }
+    if (has_last_) {
+        int expected;
+        if (packet.timestamp != 0 && last_timestamp_ != 0) {
+            expected = (int32_t)(packet.timestamp - last_timestamp_);
+        } else {
+            expected = (int32_t)(packet.sequence - last_sequence_) * frame_duration_;
+        }
+        int d = std::abs((int)(arrival_ms - last_arrival_ms_) - expected);
+        /* The pause before a new stream (e.g. the next sentence) says nothing about the jitter */
+        if (d < JITTER_BUFFER_STREAM_GAP_MS) {
+            jitter_q4_ += d - ((jitter_q4_ + 8) >> 4);
+        }
+    }
+    has_last_ = true;
+    last_sequence_ = packet.sequence;
+    last_timestamp_ = packet.timestamp;
+    last_arrival_ms_ = arrival_ms;
+}
@@ -0,0 +1,83 @@
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "protocol.h"
+
+struct JitterBufferStatistics {
+    int jitter_ms = 0;          // Smoothed interarrival jitter (RFC 3550)
+    int target_delay_ms = 0;    // Playout delay built up before (re)starting playback
+    int buffered_ms = 0;
+    uint32_t late_discards = 0;       // Arrived after its frame was played or concealed
+    uint32_t duplicate_discards = 0;
+    uint32_t overflow_discards = 0;   // Arrived while the buffer was full
+    uint32_t lost_frames = 0;         // Declared lost and handed to the decoder for concealment
+    uint32_t underruns = 0;           // Ran dry mid-stream and the next packet was more than a frame late
+};
+
+/*
+ * Adaptive jitter buffer for incoming (server to device) audio.
+ *
+ * Packets are kept in sequence order, so packets that arrive out of order are reordered as long
+ * as their frame has not been released yet. The interarrival jitter is estimated from the
+ * packets' timestamps (or their sequence numbers when the transport has no timestamps), and the
+ * target delay follows it: playback of a stream starts once the target delay is buffered, and a
+ * missing frame is declared lost once the frames behind it cover the target delay. Every discard
+ * is counted in the statistics.
+ *
+ * Push() is called from the network task and Pop() from the decode task, which is notified on
+ * every push and told how long to sleep before the next decision.
+ */
+class JitterBuffer {
+public:
+    JitterBuffer() = default;
+    JitterBuffer(const JitterBuffer&) = delete;
+    JitterBuffer& operator=(const JitterBuffer&) = delete;
+
+    void SetConsumer(TaskHandle_t task) { consumer_ = task; }
+
+    /* Returns false if the packet was discarded */
+    bool Push(std::unique_ptr<AudioStreamPacket> packet);
+    /* Returns the next packet to decode, or nullptr with wait_ms set to when to ask again (-1: on the next push) */
+    std::unique_ptr<AudioStreamPacket> Pop(int& wait_ms);
+    void Reset();
+    bool empty() const;
+    JitterBufferStatistics statistics() const;
+
+private:
+    struct Entry {
+        std::unique_ptr<AudioStreamPacket> packet;
+        int64_t arrival_ms;
+    };
+
+    int BufferedMs() const;
+    int TargetDelayMs() const;
+    void UpdateJitter(const AudioStreamPacket& packet, int64_t arrival_ms);
+
+    mutable std::mutex mutex_;
+    std::deque<Entry> entries_;
+    TaskHandle_t consumer_ = nullptr;
+    bool playing_ = false;
+    uint32_t next_sequence_ = 0;     // Next frame to release while playing
+    uint32_t local_sequence_ = 0;    // Assigned to packets from transports without sequence numbers
+    int frame_duration_ = 0;
+    int64_t dry_since_ms_ = 0;       // When the buffer last ran dry while playing
+
+    /* Last in-order arrival, for the jitter estimate */
+    bool has_last_ = false;
+    uint32_t last_sequence_ = 0;
+    uint32_t last_timestamp_ = 0;
+    int64_t last_arrival_ms_ = 0;
+    int jitter_q4_ = 0;              // Jitter in 1/16 ms
+
+    JitterBufferStatistics statistics_;
+};
+
+#endif // JITTER_BUFFER_H
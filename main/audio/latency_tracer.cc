@@ -0,0 +1,178 @@
+#include "latency_tracer.h"
+#include "sdkconfig.h"
+
+#include <esp_timer.h>
+
+#include <algorithm>
+
+/* Halve the histogram counts once they reach this many samples */
+#define LATENCY_WINDOW_SAMPLES 500
+/* The audio processor works on 16 kHz mono */
+#define LATENCY_CAPTURE_SAMPLE_RATE 16000
+
+/* Upper bounds of the histogram buckets in milliseconds, the last bucket takes everything above */
+static const int kBucketBounds[] = {
+    1, 2, 3, 4, 5, 6, 8, 10, 12, 15, 20, 25, 30, 40, 50, 60,
+    80, 100, 120, 150, 200, 250, 300, 400, 500, 600, 800, 1000, 1500, 2000, 3000, 5000,
+};
+
+static const char* const kStageNames[kLatencyStageCount] = {
+    "process", "encode", "send_queue", "send", "uplink",
+    "jitter_buffer", "decode", "playback", "downlink", "response",
+};
+
+void LatencyHistogram::Add(int ms) {
+    int bucket = std::upper_bound(std::begin(kBucketBounds), std::end(kBucketBounds), ms - 1) - std::begin(kBucketBounds);
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    int max = max_ms_.load(std::memory_order_relaxed);
+    while (ms > max && !max_ms_.compare_exchange_weak(max, ms, std::memory_order_relaxed)) {
+    }
+
+    if (count_.fetch_add(1, std::memory_order_relaxed) + 1 >= LATENCY_WINDOW_SAMPLES) {
+        /* Not atomic as a whole, a sample added meanwhile may be halved too */
+        uint32_t count = 0;
+        for (auto& b : buckets_) {
+            uint32_t n = b.load(std::memory_order_relaxed) / 2;
+            b.store(n, std::memory_order_relaxed);
+            count += n;
+        }
+        count_.store(count, std::memory_order_relaxed);
+        max_ms_.store(ms, std::memory_order_relaxed);
+    }
+}
+
+/* Upper bound of the bucket holding the percentile, or the maximum for the last bucket */
+int LatencyHistogram::Percentile(int percent) const {
+    uint32_t total = 0;
+    uint32_t counts[kBucketCount];
+    for (int i = 0; i < kBucketCount; i++) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+
+    uint32_t rank = (total * percent + 99) / 100;
+    uint32_t seen = 0;
+    int max = max_ms_.load(std::memory_order_relaxed);
+    for (int i = 0; i < kBucketCount - 1; i++) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return std::min(kBucketBounds[i], max);
+        }
+    }
+    return max;
+}
+
+cJSON* LatencyHistogram::ToJson() const {
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "count", count());
+    cJSON_AddNumberToObject(json, "p50_ms", Percentile(50));
+    cJSON_AddNumberToObject(json, "p90_ms", Percentile(90));
+    cJSON_AddNumberToObject(json, "p99_ms", Percentile(99));
+    cJSON_AddNumberToObject(json, "max_ms", max_ms_.load(std::memory_order_relaxed));
+    return json;
+}
+
+void LatencyTracer::Begin(LatencyTrace& trace, int64_t origin_us) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    int64_t now = esp_timer_get_time();
+    trace.origin_us = origin_us > 0 ? std::min(origin_us, now) : now;
+    trace.stage_us = trace.origin_us;
+#endif
+}
+
+void LatencyTracer::Stamp(LatencyTrace& trace, LatencyStage stage) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    if (trace.origin_us == 0) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    histograms_[stage].Add((now - trace.stage_us) / 1000);
+    trace.stage_us = now;
+#endif
+}
+
+void LatencyTracer::Finish(LatencyTrace& trace, LatencyStage stage, LatencyStage total) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    if (trace.origin_us == 0) {
+        return;
+    }
+    Stamp(trace, stage);
+    histograms_[total].Add((trace.stage_us - trace.origin_us) / 1000);
+    if (total == kLatencyStageDownlink) {
+        int64_t speech_end = speech_end_us_.exchange(0);
+        if (speech_end > 0) {
+            histograms_[kLatencyStageResponse].Add((trace.stage_us - speech_end) / 1000);
+        }
+    }
+    trace.origin_us = 0;
+#endif
+}
+
+void LatencyTracer::ResetCapture() {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    capture_mark_count_ = 0;
+    capture_mark_next_ = 0;
+    captured_samples_ = 0;
+    processed_samples_ = 0;
+#endif
+}
+
+/* Called after every read that feeds the audio processor */
+void LatencyTracer::MarkCaptured(size_t samples) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    captured_samples_ += samples;
+    capture_marks_[capture_mark_next_] = CaptureMark{captured_samples_, esp_timer_get_time()};
+    capture_mark_next_ = (capture_mark_next_ + 1) % kCaptureMarks;
+    capture_mark_count_ = std::min(capture_mark_count_ + 1, kCaptureMarks);
+#endif
+}
+
+/* Called for every processor output frame; returns when its last sample was captured, 0 if unknown */
+int64_t LatencyTracer::CaptureTime(size_t samples) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    std::lock_guard<std::mutex> lock(capture_mutex_);
+    processed_samples_ += samples;
+    if (capture_mark_count_ == 0) {
+        return 0;
+    }
+
+    /* The first read (oldest first) that covers the sample, minus the time of the samples after it */
+    int oldest = (capture_mark_next_ - capture_mark_count_ + kCaptureMarks) % kCaptureMarks;
+    const CaptureMark* mark = nullptr;
+    for (int i = 0; i < capture_mark_count_; i++) {
+        mark = &capture_marks_[(oldest + i) % kCaptureMarks];
+        if (mark->end_sample >= processed_samples_) {
+            break;
+        }
+    }
+    if (mark->end_sample < processed_samples_) {
+        return mark->time_us;
+    }
+    return mark->time_us - (int64_t)(mark->end_sample - processed_samples_) * 1000000 / LATENCY_CAPTURE_SAMPLE_RATE;
+#else
+    return 0;
+#endif
+}
+
+/* The response latency runs from the last time the voice stopped until the reply is played */
+void LatencyTracer::MarkSpeechEnd(bool speaking) {
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    speech_end_us_ = speaking ? 0 : esp_timer_get_time();
+#endif
+}
+
+cJSON* LatencyTracer::ToJson(bool stages) const {
+    auto json = cJSON_CreateObject();
+    for (int i = 0; i < kLatencyStageCount; i++) {
+        bool is_total = i == kLatencyStageUplink || i == kLatencyStageDownlink || i == kLatencyStageResponse;
+        if (stages || is_total) {
+            cJSON_AddItemToObject(json, kStageNames[i], histograms_[i].ToJson());
+        }
+    }
+    return json;
+}
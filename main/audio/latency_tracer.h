@@ -0,0 +1,104 @@
+#ifndef LATENCY_TRACER_H
+#define LATENCY_TRACER_H
+
+#include <cJSON.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/*
+ * Audio pipeline stages. Each stage is the time from the previous stamp to this one, and the
+ * totals span the whole uplink (microphone to server) or downlink (server to speaker).
+ */
+enum LatencyStage {
+    kLatencyStageProcess,       // Microphone read -> audio processor output (AFE buffering and processing)
+    kLatencyStageEncode,        // Processor output -> Opus packet (encode queue wait and encoding)
+    kLatencyStageSendQueue,     // Opus packet -> taken from the send queue by the application
+    kLatencyStageSend,          // Taken from the send queue -> Protocol::SendAudio returned
+    kLatencyStageUplink,        // Total: microphone read -> sent
+    kLatencyStageJitterBuffer,  // Received -> released by the jitter buffer
+    kLatencyStageDecode,        // Released -> decoded and resampled
+    kLatencyStagePlayback,      // Decoded -> written to the codec (playback queue wait and I2S write)
+    kLatencyStageDownlink,      // Total: received -> written to the codec
+    kLatencyStageResponse,      // End of speech (VAD) -> first frame of the reply written to the codec
+    kLatencyStageCount,
+};
+
+/* Carried by every traced frame; frames that were not started (local sounds, concealment) are not recorded */
+struct LatencyTrace {
+    int64_t origin_us = 0;
+    int64_t stage_us = 0;
+};
+
+/*
+ * Rolling latency histogram with fixed millisecond buckets. Once it holds LATENCY_WINDOW_SAMPLES
+ * samples all counts are halved, so old samples fade out and the percentiles follow the
+ * recent behaviour. Counters are relaxed atomics: Add() is called from the audio tasks and the
+ * JSON is built from whichever task asks.
+ */
+class LatencyHistogram {
+public:
+    void Add(int ms);
+    int Percentile(int percent) const;
+    uint32_t count() const { return count_.load(std::memory_order_relaxed); }
+    cJSON* ToJson() const;
+
+private:
+    static constexpr int kBucketCount = 33;
+
+    std::atomic<uint32_t> buckets_[kBucketCount] = {};
+    std::atomic<uint32_t> count_{0};
+    std::atomic<int> max_ms_{0};
+};
+
+/*
+ * End-to-end audio latency tracing.
+ *
+ * Frames are stamped with esp_timer time as they move through the pipeline and every stage
+ * delay goes into its own LatencyHistogram. The audio processor (AFE) does not keep frame
+ * boundaries, so the capture time of its output is looked up from the number of samples fed
+ * and produced since it started. Everything compiles to nothing when
+ * CONFIG_USE_AUDIO_LATENCY_TRACE is off.
+ */
+class LatencyTracer {
+public:
+    /* Start tracing a frame; origin_us defaults to now */
+    void Begin(LatencyTrace& trace, int64_t origin_us = 0);
+    /* Record the time since the previous stamp as `stage` */
+    void Stamp(LatencyTrace& trace, LatencyStage stage);
+    /* Stamp the last stage and record the time since Begin() as `total` */
+    void Finish(LatencyTrace& trace, LatencyStage stage, LatencyStage total);
+
+    /* Audio processor input / output, in mono samples */
+    void ResetCapture();
+    void MarkCaptured(size_t samples);
+    int64_t CaptureTime(size_t samples);
+
+    void MarkSpeechEnd(bool speaking);
+
+    /* With `stages` false only the totals are reported */
+    cJSON* ToJson(bool stages) const;
+
+private:
+    static constexpr int kCaptureMarks = 16;
+
+    struct CaptureMark {
+        uint64_t end_sample;
+        int64_t time_us;
+    };
+
+    LatencyHistogram histograms_[kLatencyStageCount];
+
+    std::mutex capture_mutex_;
+    CaptureMark capture_marks_[kCaptureMarks] = {};
+    int capture_mark_count_ = 0;
+    int capture_mark_next_ = 0;
+    uint64_t captured_samples_ = 0;
+    uint64_t processed_samples_ = 0;
+
+    std::atomic<int64_t> speech_end_us_{0};
+};
+
+#endif // LATENCY_TRACER_H
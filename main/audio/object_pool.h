@@ -0,0 +1,74 @@
+#ifndef OBJECT_POOL_H
+#define OBJECT_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Fixed-capacity pool of preallocated objects with a lock-free free list.
+ *
+ * Objects are constructed once and never destroyed, so members such as vectors keep their
+ * capacity between uses; the caller resets the fields it needs after Acquire(). The free list
+ * is a Treiber stack of indices whose head carries a 16-bit tag to avoid the ABA problem.
+ * Acquire() returns nullptr when the pool is exhausted so callers can fall back to the heap.
+ */
+template <typename T, size_t N>
+class ObjectPool {
+    static_assert(N > 0 && N < 0xFFFF, "pool size must fit in a 16-bit index");
+
+public:
+    ObjectPool() {
+        for (size_t i = 0; i < N; i++) {
+            next_[i].store(i + 1 < N ? i + 1 : kEnd, std::memory_order_relaxed);
+        }
+        head_.store(0, std::memory_order_release);
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    T* Acquire() {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        while (true) {
+            uint16_t index = head & 0xFFFF;
+            if (index == kEnd) {
+                return nullptr;
+            }
+            uint32_t next = next_[index].load(std::memory_order_relaxed);
+            uint32_t new_head = (((head >> 16) + 1) << 16) | next;
+            if (head_.compare_exchange_weak(head, new_head, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return &objects_[index];
+            }
+        }
+    }
+
+    /* Returns false if the object does not belong to this pool */
+    bool Release(T* object) {
+        if (!Owns(object)) {
+            return false;
+        }
+        uint16_t index = object - objects_;
+        uint32_t head = head_.load(std::memory_order_relaxed);
+        while (true) {
+            next_[index].store(head & 0xFFFF, std::memory_order_relaxed);
+            uint32_t new_head = (((head >> 16) + 1) << 16) | index;
+            if (head_.compare_exchange_weak(head, new_head, std::memory_order_release, std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+    }
+
+    bool Owns(const T* object) const {
+        return object >= objects_ && object < objects_ + N;
+    }
+
+private:
+    static constexpr uint16_t kEnd = 0xFFFF;
+
+    T objects_[N];
+    std::atomic<uint16_t> next_[N];
+    std::atomic<uint32_t> head_;
+};
+
+#endif // OBJECT_POOL_H
@@ -0,0 +1,151 @@
+#include "opus_stream.h"
+
+#include <esp_log.h>
+
+#define TAG "OpusStream"
+
+/* Fits any voice frame up to 60 ms, and stays within the packet pool's pooled payload size */
+#define OPUS_STREAM_MAX_PACKET_SIZE 1500
+
+OpusStreamEncoder::OpusStreamEncoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms),
+      frame_size_(sample_rate / 1000 * duration_ms) {
+    int error;
+    encoder_ = opus_encoder_create(sample_rate, channels, OPUS_APPLICATION_VOIP, &error);
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", error);
+        return;
+    }
+    opus_encoder_ctl(encoder_, OPUS_SET_DTX(1));
+    opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(1));
+}
+
+OpusStreamEncoder::~OpusStreamEncoder() {
+    if (encoder_ != nullptr) {
+        opus_encoder_destroy(encoder_);
+    }
+}
+
+void OpusStreamEncoder::SetComplexity(int complexity) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_COMPLEXITY(complexity));
+        complexity_ = complexity;
+    }
+}
+
+void OpusStreamEncoder::SetDtx(bool enable) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_DTX(enable ? 1 : 0));
+        dtx_ = enable;
+    }
+}
+
+void OpusStreamEncoder::SetInbandFec(bool enable) {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_INBAND_FEC(enable ? 1 : 0));
+    }
+}
+
+void OpusStreamEncoder::SetPacketLoss(int percent) {
+    packet_loss_ = percent;
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_SET_PACKET_LOSS_PERC(percent));
+    }
+}
+
+bool OpusStreamEncoder::Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus) {
+    if (encoder_ == nullptr) {
+        ESP_LOGE(TAG, "Audio encoder is not configured");
+        return false;
+    }
+    if ((int)pcm.size() != frame_size_ * channels_) {
+        ESP_LOGE(TAG, "Audio data size %u does not match frame size %d", pcm.size(), frame_size_ * channels_);
+        return false;
+    }
+
+    opus.resize(OPUS_STREAM_MAX_PACKET_SIZE);
+    auto ret = opus_encode(encoder_, pcm.data(), frame_size_, opus.data(), opus.size());
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
+        opus.clear();
+        return false;
+    }
+    opus.resize(ret);
+    return true;
+}
+
+void OpusStreamEncoder::ResetState() {
+    if (encoder_ != nullptr) {
+        opus_encoder_ctl(encoder_, OPUS_RESET_STATE);
+    }
+}
+
+OpusStreamDecoder::OpusStreamDecoder(int sample_rate, int channels, int duration_ms)
+    : sample_rate_(sample_rate), channels_(channels), duration_ms_(duration_ms),
+      frame_size_(sample_rate / 1000 * duration_ms) {
+    int error;
+    decoder_ = opus_decoder_create(sample_rate, channels, &error);
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio decoder, error code: %d", error);
+    }
+}
+
+OpusStreamDecoder::~OpusStreamDecoder() {
+    if (decoder_ != nullptr) {
+        opus_decoder_destroy(decoder_);
+    }
+}
+
+bool OpusStreamDecoder::Decode(const std::vector<uint8_t>& opus, std::vector<int16_t>& pcm) {
+    if (decoder_ == nullptr) {
+        ESP_LOGE(TAG, "Audio decoder is not configured");
+        return false;
+    }
+
+    /* A packet may hold up to 120 ms, but the server sends one negotiated frame per packet */
+    pcm.resize(frame_size_ * channels_);
+    auto ret = opus_decode(decoder_, opus.data(), opus.size(), pcm.data(), frame_size_, 0);
+    if (ret < 0) {
+        ESP_LOGE(TAG, "Failed to decode audio, error code: %d", ret);
+        return false;
+    }
+    pcm.resize(ret * channels_);
+    return true;
+}
+
+bool OpusStreamDecoder::DecodeFec(const std::vector<uint8_t>& next_opus, std::vector<int16_t>& pcm) {
+    if (decoder_ == nullptr) {
+        return false;
+    }
+
+    /* The frame size must be the duration of the missing frame, libopus conceals it if there is no FEC data */
+    pcm.resize(frame_size_ * channels_);
+    auto ret = opus_decode(decoder_, next_opus.data(), next_opus.size(), pcm.data(), frame_size_, 1);
+    if (ret < 0) {
+        ESP_LOGW(TAG, "Failed to decode FEC data, error code: %d", ret);
+        return false;
+    }
+    pcm.resize(ret * channels_);
+    return true;
+}
+
+bool OpusStreamDecoder::Conceal(std::vector<int16_t>& pcm) {
+    if (decoder_ == nullptr) {
+        return false;
+    }
+
+    pcm.resize(frame_size_ * channels_);
+    auto ret = opus_decode(decoder_, nullptr, 0, pcm.data(), frame_size_, 0);
+    if (ret < 0) {
+        ESP_LOGW(TAG, "Failed to conceal lost frame, error code: %d", ret);
+        return false;
+    }
+    pcm.resize(ret * channels_);
+    return true;
+}
+
+void OpusStreamDecoder::ResetState() {
+    if (decoder_ != nullptr) {
+        opus_decoder_ctl(decoder_, OPUS_RESET_STATE);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef OPUS_STREAM_H
+#define OPUS_STREAM_H
+
+#include <cstdint>
+#include <vector>
+
+#include <opus.h>
+
+/*
+ * Thin libopus wrappers for the conversation stream.
+ *
+ * Unlike OpusEncoderWrapper / OpusDecoderWrapper they expose the loss-resilience controls:
+ * in-band FEC and the expected packet loss on the encoder side, and packet-loss concealment
+ * and FEC recovery on the decoder side. Like OpusEncoderWrapper, the encoder starts with DTX on,
+ * so silence costs a byte or two per frame. Both work on exactly one frame per call and are only
+ * used by the task that owns them, so they have no locking.
+ */
+class OpusStreamEncoder {
+public:
+    OpusStreamEncoder(int sample_rate, int channels, int duration_ms);
+    ~OpusStreamEncoder();
+
+    OpusStreamEncoder(const OpusStreamEncoder&) = delete;
+    OpusStreamEncoder& operator=(const OpusStreamEncoder&) = delete;
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int duration_ms() const { return duration_ms_; }
+    inline int packet_loss() const { return packet_loss_; }
+    inline bool dtx() const { return dtx_; }
+    inline int complexity() const { return complexity_; }
+
+    void SetComplexity(int complexity);
+    void SetDtx(bool enable);
+    /* In-band FEC only costs bits when the expected packet loss is above zero */
+    void SetInbandFec(bool enable);
+    void SetPacketLoss(int percent);
+    bool Encode(std::vector<int16_t>&& pcm, std::vector<uint8_t>& opus);
+    void ResetState();
+
+private:
+    OpusEncoder* encoder_ = nullptr;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    int frame_size_;
+    int packet_loss_ = 0;
+    bool dtx_ = true;
+    int complexity_ = -1;
+};
+
+class OpusStreamDecoder {
+public:
+    OpusStreamDecoder(int sample_rate, int channels, int duration_ms);
+    ~OpusStreamDecoder();
+
+    OpusStreamDecoder(const OpusStreamDecoder&) = delete;
+    OpusStreamDecoder& operator=(const OpusStreamDecoder&) = delete;
+
+    inline int sample_rate() const { return sample_rate_; }
+    inline int duration_ms() const { return duration_ms_; }
+
+    bool Decode(const std::vector<uint8_t>& opus, std::vector<int16_t>& pcm);
+    /* Rebuild the frame before `next_opus` from its in-band FEC data, or conceal it if there is none */
+    bool DecodeFec(const std::vector<uint8_t>& next_opus, std::vector<int16_t>& pcm);
+    /* Synthesize one missing frame from the decoder state (packet-loss concealment) */
+    bool Conceal(std::vector<int16_t>& pcm);
+    void ResetState();
+
+private:
+    OpusDecoder* decoder_ = nullptr;
+    int sample_rate_;
+    int channels_;
+    int duration_ms_;
+    int frame_size_;
+};
+
+#endif // OPUS_STREAM_H
@@ -6,6 +6,7 @@
 #include <freertos/task.h>
 #include <freertos/event_groups.h>
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <functional>
@@ -19,12 +20,14 @@ public:
     ~AfeAudioProcessor();
 
     void Initialize(AudioCodec* codec, int frame_duration_ms) override;
+    void SetFrameDuration(int frame_duration_ms) override;
     void Feed(std::vector<int16_t>&& data) override;
     void Start() override;
     void Stop() override;
     bool IsRunning() override;
     void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
+    bool IsVadEnabled() override;
     size_t GetFeedSize() override;
     void EnableDeviceAec(bool enable) override;
 
@@ -37,6 +40,7 @@ private:
     AudioCodec* codec_ = nullptr;
     int frame_samples_ = 0;
     bool is_speaking_ = false;
+    std::atomic<bool> vad_enabled_{false};
     std::vector<int16_t> output_buffer_;
 
     void AudioProcessorTask();
@@ -3,66 +3,301 @@
 
 #if CONFIG_USE_AUDIO_DEBUGGER
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <errno.h>
 #include <cstring>
 #include <string>
+#include <algorithm>
+#if CONFIG_AUDIO_DEBUG_SINK_SERIAL
+#include <driver/uart.h>
+#endif
 #endif
 
 #define TAG "AudioDebugger"
 
+#define AUDIO_DEBUG_TASK_STACK_SIZE 4096
+#define AUDIO_DEBUG_TASK_PRIORITY 1
+#define AUDIO_DEBUG_FLASH_SECTOR_SIZE 4096
+
+#if CONFIG_USE_AUDIO_DEBUGGER
+static const int16_t kAdpcmStepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static const int8_t kAdpcmIndexTable[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8,
+};
+#endif
+
 
 AudioDebugger::AudioDebugger() {
 #if CONFIG_USE_AUDIO_DEBUGGER
+    if (!OpenSink()) {
+        return;
+    }
+
+    // 优先在 PSRAM 中分配环形缓冲区，实时任务只做一次内存拷贝
+    ring_ = xRingbufferCreateWithCaps(CONFIG_AUDIO_DEBUG_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT, MALLOC_CAP_SPIRAM);
+    if (ring_ == nullptr) {
+        ring_ = xRingbufferCreateWithCaps(CONFIG_AUDIO_DEBUG_BUFFER_SIZE / 4, RINGBUF_TYPE_NOSPLIT, MALLOC_CAP_INTERNAL);
+    }
+    if (ring_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to create capture ring buffer");
+        CloseSink();
+        return;
+    }
+
+    xTaskCreate([](void* arg) {
+        auto debugger = (AudioDebugger*)arg;
+        debugger->DrainTask();
+        debugger->drain_task_ = nullptr;
+        vTaskDelete(NULL);
+    }, "audio_debug", AUDIO_DEBUG_TASK_STACK_SIZE, this, AUDIO_DEBUG_TASK_PRIORITY, &drain_task_);
+#endif
+}
+
+AudioDebugger::~AudioDebugger() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    stopping_ = true;
+    while (drain_task_ != nullptr) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    if (ring_ != nullptr) {
+        vRingbufferDeleteWithCaps(ring_);
+    }
+    CloseSink();
+#endif
+}
+
+bool AudioDebugger::OpenSink() {
+#if CONFIG_AUDIO_DEBUG_SINK_UDP
     udp_sockfd_ = socket(AF_INET, SOCK_DGRAM, 0);
-    if (udp_sockfd_ >= 0) {
-        // 解析配置的服务器地址 "IP:PORT"
-        std::string server_addr = CONFIG_AUDIO_DEBUG_UDP_SERVER;
-        size_t colon_pos = server_addr.find(':');
-        
-        if (colon_pos != std::string::npos) {
-            std::string ip = server_addr.substr(0, colon_pos);
-            int port = std::stoi(server_addr.substr(colon_pos + 1));
-            
-            memset(&udp_server_addr_, 0, sizeof(udp_server_addr_));
-            udp_server_addr_.sin_family = AF_INET;
-            udp_server_addr_.sin_port = htons(port);
-            inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
-            
-            ESP_LOGI(TAG, "Initialized server address: %s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
-        } else {
-            ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_AUDIO_DEBUG_UDP_SERVER);
-            close(udp_sockfd_);
-            udp_sockfd_ = -1;
-        }
-    } else {
+    if (udp_sockfd_ < 0) {
         ESP_LOGW(TAG, "Failed to create UDP socket: %d", errno);
+        return false;
+    }
+    // 解析配置的服务器地址 "IP:PORT"
+    std::string server_addr = CONFIG_AUDIO_DEBUG_UDP_SERVER;
+    size_t colon_pos = server_addr.find(':');
+    if (colon_pos == std::string::npos) {
+        ESP_LOGW(TAG, "Invalid server address: %s, should be IP:PORT", CONFIG_AUDIO_DEBUG_UDP_SERVER);
+        close(udp_sockfd_);
+        udp_sockfd_ = -1;
+        return false;
+    }
+    std::string ip = server_addr.substr(0, colon_pos);
+    int port = std::stoi(server_addr.substr(colon_pos + 1));
+
+    memset(&udp_server_addr_, 0, sizeof(udp_server_addr_));
+    udp_server_addr_.sin_family = AF_INET;
+    udp_server_addr_.sin_port = htons(port);
+    inet_pton(AF_INET, ip.c_str(), &udp_server_addr_.sin_addr);
+    ESP_LOGI(TAG, "Capturing audio to udp://%s", CONFIG_AUDIO_DEBUG_UDP_SERVER);
+    return true;
+#elif CONFIG_AUDIO_DEBUG_SINK_SERIAL
+    // 与日志共用控制台串口，主机端按记录头重新同步
+    if (!uart_is_driver_installed((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM)) {
+        if (uart_driver_install((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM, 256, 0, 0, NULL, 0) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to install the console UART driver");
+            return false;
+        }
     }
+    ESP_LOGI(TAG, "Capturing audio to UART%d", CONFIG_ESP_CONSOLE_UART_NUM);
+    return true;
+#elif CONFIG_AUDIO_DEBUG_SINK_FLASH
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, CONFIG_AUDIO_DEBUG_FLASH_PARTITION);
+    if (partition_ == nullptr) {
+        ESP_LOGW(TAG, "Partition %s not found", CONFIG_AUDIO_DEBUG_FLASH_PARTITION);
+        return false;
+    }
+    flash_offset_ = 0;
+    flash_erased_ = 0;
+    ESP_LOGI(TAG, "Capturing audio to partition %s (%lu bytes)", partition_->label, partition_->size);
+    return true;
+#else
+    return false;
 #endif
 }
 
-AudioDebugger::~AudioDebugger() {
+void AudioDebugger::CloseSink() {
 #if CONFIG_USE_AUDIO_DEBUGGER
     if (udp_sockfd_ >= 0) {
         close(udp_sockfd_);
+        udp_sockfd_ = -1;
         ESP_LOGI(TAG, "Closed UDP socket");
     }
+    partition_ = nullptr;
 #endif
 }
 
-void AudioDebugger::Feed(const std::vector<int16_t>& data) {
+void AudioDebugger::Feed(AudioDebugStage stage, int sample_rate, int channels, const std::vector<int16_t>& data, bool reference) {
 #if CONFIG_USE_AUDIO_DEBUGGER
-    if (udp_sockfd_ >= 0) {
-        ssize_t sent = sendto(udp_sockfd_, data.data(), data.size() * sizeof(int16_t), 0,
-                             (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
-        if (sent < 0) {
-            ESP_LOGW(TAG, "Failed to send audio data to %s: %d", CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
+    if (ring_ == nullptr || data.empty() || channels <= 0 || channels > AUDIO_DEBUG_MAX_CHANNELS) {
+        return;
+    }
+
+    /* Write the record straight into the ring; never wait, a full ring drops the frame */
+    size_t payload_size = data.size() * sizeof(int16_t);
+    void* item = nullptr;
+    if (xRingbufferSendAcquire(ring_, &item, sizeof(AudioDebugRecordHeader) + payload_size, 0) != pdTRUE) {
+        dropped_records_++;
+        sequences_[stage]++;
+        return;
+    }
+
+    AudioDebugRecordHeader header = {};
+    header.magic = AUDIO_DEBUG_RECORD_MAGIC;
+    header.version = AUDIO_DEBUG_RECORD_VERSION;
+    header.stage = stage;
+    header.codec = kAudioDebugCodecPcm16;
+    header.channels = channels;
+    header.flags = reference ? AUDIO_DEBUG_FLAG_REFERENCE : 0;
+    header.sample_rate = sample_rate;
+    header.sequence = sequences_[stage]++;
+    header.frames = data.size() / channels;
+    header.payload_size = payload_size;
+    header.timestamp_us = esp_timer_get_time();
+    memcpy(item, &header, sizeof(header));
+    memcpy((uint8_t*)item + sizeof(header), data.data(), payload_size);
+    xRingbufferSendComplete(ring_, item);
+#endif
+}
+
+void AudioDebugger::DrainTask() {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    uint32_t reported_drops = 0;
+    while (!stopping_) {
+        size_t size = 0;
+        auto item = (uint8_t*)xRingbufferReceive(ring_, &size, pdMS_TO_TICKS(100));
+        if (item == nullptr) {
+            continue;
+        }
+
+        AudioDebugRecordHeader header;
+        memcpy(&header, item, sizeof(header));
+        const int16_t* pcm = (const int16_t*)(item + sizeof(header));
+        bool ok;
+#if CONFIG_AUDIO_DEBUG_ADPCM
+        output_buffer_.resize(sizeof(header) + header.channels * 4 + (header.frames * header.channels + 1) / 2);
+        header.codec = kAudioDebugCodecImaAdpcm;
+        header.payload_size = EncodeAdpcm(header, pcm, output_buffer_.data() + sizeof(header));
+        memcpy(output_buffer_.data(), &header, sizeof(header));
+        ok = Write(output_buffer_.data(), sizeof(header) + header.payload_size);
+#else
+        ok = Write(item, size);
+#endif
+        vRingbufferReturnItem(ring_, item);
+        if (!ok) {
+            break;
+        }
+
+        uint32_t dropped = dropped_records_;
+        if (dropped != reported_drops) {
+            ESP_LOGW(TAG, "Capture ring full, %lu records dropped", dropped);
+            reported_drops = dropped;
+        }
+    }
+    ESP_LOGW(TAG, "Audio capture stopped");
+#endif
+}
+
+/* IMA ADPCM, carrying the encoder state across records of the same stage */
+size_t AudioDebugger::EncodeAdpcm(const AudioDebugRecordHeader& header, const int16_t* pcm, uint8_t* output) {
+#if CONFIG_USE_AUDIO_DEBUGGER
+    AdpcmState* states = adpcm_states_[header.stage];
+    uint8_t* p = output;
+    for (int c = 0; c < header.channels; c++) {
+        uint16_t predictor = (uint16_t)states[c].predictor;
+        *p++ = predictor & 0xFF;
+        *p++ = predictor >> 8;
+        *p++ = states[c].index;
+        *p++ = 0;
+    }
+
+    size_t samples = header.frames * header.channels;
+    for (size_t i = 0; i < samples; i++) {
+        AdpcmState& state = states[i % header.channels];
+        int step = kAdpcmStepTable[state.index];
+        int diff = pcm[i] - state.predictor;
+        int code = 0;
+        if (diff < 0) {
+            code = 8;
+            diff = -diff;
+        }
+        int delta = step >> 3;
+        if (diff >= step) {
+            code |= 4;
+            diff -= step;
+            delta += step;
+        }
+        step >>= 1;
+        if (diff >= step) {
+            code |= 2;
+            diff -= step;
+            delta += step;
+        }
+        step >>= 1;
+        if (diff >= step) {
+            code |= 1;
+            delta += step;
+        }
+        int predictor = state.predictor + ((code & 8) ? -delta : delta);
+        state.predictor = std::clamp(predictor, -32768, 32767);
+        state.index = std::clamp(state.index + kAdpcmIndexTable[code], 0, 88);
+
+        if (i % 2 == 0) {
+            *p = code;
         } else {
-            ESP_LOGD(TAG, "Sent %d bytes audio data to %s", sent, CONFIG_AUDIO_DEBUG_UDP_SERVER);
+            *p++ |= code << 4;
         }
     }
+    if (samples % 2 != 0) {
+        p++;
+    }
+    return p - output;
+#else
+    return 0;
 #endif
 }
 
- 
\ No newline at end of file
+bool AudioDebugger::Write(const void* data, size_t size) {
+#if CONFIG_AUDIO_DEBUG_SINK_UDP
+    /* One record per datagram, so a lost datagram only loses its record */
+    ssize_t sent = sendto(udp_sockfd_, data, size, 0, (struct sockaddr*)&udp_server_addr_, sizeof(udp_server_addr_));
+    if (sent < 0) {
+        ESP_LOGD(TAG, "Failed to send %u bytes to %s: %d", size, CONFIG_AUDIO_DEBUG_UDP_SERVER, errno);
+    }
+    return true;
+#elif CONFIG_AUDIO_DEBUG_SINK_SERIAL
+    uart_write_bytes((uart_port_t)CONFIG_ESP_CONSOLE_UART_NUM, data, size);
+    return true;
+#elif CONFIG_AUDIO_DEBUG_SINK_FLASH
+    if (flash_offset_ + size > partition_->size) {
+        ESP_LOGW(TAG, "Partition %s is full", partition_->label);
+        return false;
+    }
+    /* Erase sector by sector ahead of the write position */
+    while (flash_erased_ < flash_offset_ + size) {
+        if (esp_partition_erase_range(partition_, flash_erased_, AUDIO_DEBUG_FLASH_SECTOR_SIZE) != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase partition %s at 0x%x", partition_->label, flash_erased_);
+            return false;
+        }
+        flash_erased_ += AUDIO_DEBUG_FLASH_SECTOR_SIZE;
+    }
+    if (esp_partition_write(partition_, flash_offset_, data, size) != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write partition %s at 0x%x", partition_->label, flash_offset_);
+        return false;
+    }
+    flash_offset_ += size;
+    return true;
+#else
+    return false;
+#endif
+}
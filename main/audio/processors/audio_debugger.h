@@ -3,20 +3,91 @@
 
 #include <vector>
 #include <cstdint>
+#include <atomic>
 
 #include <sys/socket.h>
 #include <netinet/in.h>
 
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/ringbuf.h>
+#include <esp_partition.h>
+
+enum AudioDebugStage : uint8_t {
+    kAudioDebugStageInput = 0,      // Microphone input at 16 kHz, with the AEC reference as the last channel if present
+    kAudioDebugStageProcessed = 1,  // Audio processor (AFE) output
+    kAudioDebugStagePlayback = 2,   // PCM written to the codec
+    kAudioDebugStageCount,
+};
+
+enum AudioDebugCodec : uint8_t {
+    kAudioDebugCodecPcm16 = 0,
+    kAudioDebugCodecImaAdpcm = 1,   // Per channel: int16 predictor, uint8 step index, uint8 0; then 4-bit codes, interleaved, low nibble first
+};
+
+#define AUDIO_DEBUG_RECORD_MAGIC 0x4441   // "AD"
+#define AUDIO_DEBUG_RECORD_VERSION 1
+#define AUDIO_DEBUG_FLAG_REFERENCE 0x01   // The last channel is the AEC reference
+#define AUDIO_DEBUG_MAX_CHANNELS 4
+
+/* Every record starts with this header (little endian), followed by payload_size bytes of audio */
+struct AudioDebugRecordHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t stage;
+    uint8_t codec;
+    uint8_t channels;
+    uint8_t flags;
+    uint8_t reserved;
+    uint32_t sample_rate;
+    uint32_t sequence;       // Per stage, a gap means records were dropped
+    uint32_t frames;         // Samples per channel
+    uint32_t payload_size;
+    int64_t timestamp_us;    // esp_timer time when the frame was captured
+} __attribute__((packed));
+
+/*
+ * Audio capture for debugging the audio pipeline.
+ *
+ * Feed() only copies the frame into a ring buffer (in PSRAM when available) and drops it if the
+ * ring is full, so it never blocks the realtime tasks. A low priority task drains the ring,
+ * optionally compresses the records with IMA ADPCM and writes them to the sink chosen in
+ * Kconfig: UDP, the serial console, or a raw flash partition. scripts/audio_debug_server.py
+ * reads the records back and writes one WAV file per stage.
+ */
 class AudioDebugger {
 public:
     AudioDebugger();
     ~AudioDebugger();
 
-    void Feed(const std::vector<int16_t>& data);
+    void Feed(AudioDebugStage stage, int sample_rate, int channels, const std::vector<int16_t>& data, bool reference = false);
 
 private:
+    struct AdpcmState {
+        int16_t predictor = 0;
+        uint8_t index = 0;
+    };
+
+    void DrainTask();
+    size_t EncodeAdpcm(const AudioDebugRecordHeader& header, const int16_t* pcm, uint8_t* output);
+    bool Write(const void* data, size_t size);
+    bool OpenSink();
+    void CloseSink();
+
+    RingbufHandle_t ring_ = nullptr;
+    TaskHandle_t drain_task_ = nullptr;
+    std::atomic<bool> stopping_{false};
+    uint32_t sequences_[kAudioDebugStageCount] = {};
+    std::atomic<uint32_t> dropped_records_{0};
+    // Only used by the drain task
+    AdpcmState adpcm_states_[kAudioDebugStageCount][AUDIO_DEBUG_MAX_CHANNELS];
+    std::vector<uint8_t> output_buffer_;
+
     int udp_sockfd_ = -1;
     struct sockaddr_in udp_server_addr_;
+    const esp_partition_t* partition_ = nullptr;
+    size_t flash_offset_ = 0;
+    size_t flash_erased_ = 0;
 };
 
-#endif 
\ No newline at end of file
+#endif
@@ -8,26 +8,29 @@ void NoAudioProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
     frame_samples_ = frame_duration_ms * 16000 / 1000;
 }
 
+void NoAudioProcessor::SetFrameDuration(int frame_duration_ms) {
+    frame_samples_ = frame_duration_ms * 16000 / 1000;
+}
+
 void NoAudioProcessor::Feed(std::vector<int16_t>&& data) {
     if (!is_running_ || !output_callback_) {
         return;
     }
 
-    if (data.size() != frame_samples_) {
+    if (data.size() != (size_t)frame_samples_) {
         ESP_LOGE(TAG, "Feed data size is not equal to frame size, feed size: %u, frame size: %u", data.size(), frame_samples_);
         return;
     }
 
     if (codec_->input_channels() == 2) {
-        // If input channels is 2, we need to fetch the left channel data
-        auto mono_data = std::vector<int16_t>(data.size() / 2);
-        for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-            mono_data[i] = data[j];
+        // If input channels is 2, we need to fetch the left channel data (in place, no new buffer)
+        size_t frames = data.size() / 2;
+        for (size_t i = 0; i < frames; i++) {
+            data[i] = data[i * 2];
         }
-        output_callback_(std::move(mono_data));
-    } else {
-        output_callback_(std::move(data));
+        data.resize(frames);
     }
+    output_callback_(std::move(data));
 }
 
 void NoAudioProcessor::Start() {
@@ -57,6 +60,10 @@ size_t NoAudioProcessor::GetFeedSize() {
     return frame_samples_;
 }
 
+bool NoAudioProcessor::IsVadEnabled() {
+    return false;
+}
+
 void NoAudioProcessor::EnableDeviceAec(bool enable) {
     if (enable) {
         ESP_LOGE(TAG, "Device AEC is not supported");
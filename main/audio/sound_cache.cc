@@ -0,0 +1,204 @@
+#include "sound_cache.h"
+#include "opus_stream.h"
+#include "protocol.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+#include <arpa/inet.h>
+#include <opus_resampler.h>
+
+#include <algorithm>
+
+#define TAG "SoundCache"
+
+/* The embedded p3 sounds are 16 kHz mono in 60 ms frames */
+#define SOUND_SAMPLE_RATE 16000
+#define SOUND_FRAME_DURATION_MS 60
+#define SOUND_DECODE_TASK_STACK_SIZE (2048 * 8)
+#define SOUND_DECODE_TASK_PRIORITY 2
+
+SoundCache::SoundCache(size_t budget_bytes) : budget_bytes_(budget_bytes) {
+}
+
+SoundCache::~SoundCache() {
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    if (decode_task_ != nullptr) {
+        /* Delete it from here while it waits for a request, so its buffers are released at once */
+        while (eTaskGetState(decode_task_) != eBlocked) {
+            vTaskDelay(1);
+        }
+        vTaskDelete(decode_task_);
+    }
+    if (decode_task_stack_ != nullptr) {
+        heap_caps_free(decode_task_stack_);
+    }
+    if (decode_task_buffer_ != nullptr) {
+        heap_caps_free(decode_task_buffer_);
+    }
+}
+
+std::shared_ptr<const PcmClip> SoundCache::Get(const std::string_view& sound, int sample_rate) {
+    if (sound.empty() || sample_rate <= 0) {
+        return nullptr;
+    }
+    auto clip = Find(sound.data(), sample_rate);
+    if (clip != nullptr) {
+        return clip;
+    }
+
+    std::lock_guard<std::mutex> lock(decode_mutex_);
+    /* Decoded by another caller while we waited */
+    clip = Find(sound.data(), sample_rate);
+    if (clip == nullptr) {
+        clip = Decode(sound, sample_rate);
+        if (clip != nullptr) {
+            Insert(sound.data(), clip);
+        }
+    }
+    return clip;
+}
+
+void SoundCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    bytes_ = 0;
+}
+
+std::shared_ptr<const PcmClip> SoundCache::Find(const char* data, int sample_rate) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : entries_) {
+        if (entry.data == data && entry.clip->sample_rate == sample_rate) {
+            entry.last_used = ++use_count_;
+            return entry.clip;
+        }
+    }
+    return nullptr;
+}
+
+void SoundCache::Insert(const char* data, std::shared_ptr<const PcmClip> clip) {
+    size_t size = clip->pcm.size() * sizeof(int16_t);
+    if (size > budget_bytes_) {
+        ESP_LOGW(TAG, "Sound of %u bytes exceeds the cache budget, playing it uncached", size);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    /* Drop an entry decoded at another rate, then the least recently played ones until it fits */
+    auto it = std::find_if(entries_.begin(), entries_.end(), [data](const Entry& entry) { return entry.data == data; });
+    if (it != entries_.end()) {
+        bytes_ -= it->clip->pcm.size() * sizeof(int16_t);
+        entries_.erase(it);
+    }
+    while (bytes_ + size > budget_bytes_) {
+        auto lru = std::min_element(entries_.begin(), entries_.end(),
+            [](const Entry& a, const Entry& b) { return a.last_used < b.last_used; });
+        bytes_ -= lru->clip->pcm.size() * sizeof(int16_t);
+        entries_.erase(lru);
+    }
+    entries_.push_back({data, std::move(clip), ++use_count_});
+    bytes_ += size;
+    ESP_LOGI(TAG, "Cached %u sounds, %u of %u bytes", entries_.size(), bytes_, budget_bytes_);
+}
+
+/*
+ * Hands the decode to the decode task and waits for it, so the caller's stack does not need to
+ * fit libopus. The task is created on the first decode and kept: a task that deletes itself
+ * stays on the kernel's termination list until the idle task runs, so its static buffers could
+ * not be reused for the next sound right away.
+ */
+std::shared_ptr<const PcmClip> SoundCache::Decode(const std::string_view& sound, int sample_rate) {
+    if (decode_task_ == nullptr) {
+        if (decode_task_stack_ == nullptr) {
+            decode_task_stack_ = (StackType_t*)heap_caps_malloc(SOUND_DECODE_TASK_STACK_SIZE, MALLOC_CAP_SPIRAM);
+        }
+        if (decode_task_buffer_ == nullptr) {
+            decode_task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        }
+        if (decode_task_stack_ == nullptr || decode_task_buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate the decode task");
+            return nullptr;
+        }
+        decode_task_ = xTaskCreateStatic([](void* arg) {
+            auto this_ = (SoundCache*)arg;
+            this_->DecodeTask();
+        }, "sound_decode", SOUND_DECODE_TASK_STACK_SIZE, this, SOUND_DECODE_TASK_PRIORITY, decode_task_stack_, decode_task_buffer_);
+        if (decode_task_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create the decode task");
+            return nullptr;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    decode_sound_ = sound;
+    decode_sample_rate_ = sample_rate;
+    decode_result_.reset();
+    decode_done_ = false;
+    xTaskNotifyGive(decode_task_);
+    decode_cv_.wait(lock, [this]() { return decode_done_; });
+    return std::move(decode_result_);
+}
+
+void SoundCache::DecodeTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        std::string_view sound;
+        int sample_rate;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sound = decode_sound_;
+            sample_rate = decode_sample_rate_;
+        }
+        auto clip = DecodeClip(sound, sample_rate);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        decode_result_ = std::move(clip);
+        decode_done_ = true;
+        decode_cv_.notify_all();
+    }
+}
+
+std::shared_ptr<PcmClip> SoundCache::DecodeClip(const std::string_view& sound, int sample_rate) {
+    auto start_time = esp_timer_get_time();
+    auto clip = std::make_shared<PcmClip>();
+    clip->sample_rate = sample_rate;
+    {
+        OpusStreamDecoder decoder(SOUND_SAMPLE_RATE, 1, SOUND_FRAME_DURATION_MS);
+        OpusResampler resampler;
+        if (sample_rate != SOUND_SAMPLE_RATE) {
+            resampler.Configure(SOUND_SAMPLE_RATE, sample_rate);
+        }
+
+        std::vector<uint8_t> opus;
+        std::vector<int16_t> pcm;
+        std::vector<int16_t> resampled;
+        const char* data = sound.data();
+        const char* end = data + sound.size();
+        for (const char* p = data; p + sizeof(BinaryProtocol3) <= end; ) {
+            auto p3 = (const BinaryProtocol3*)p;
+            p += sizeof(BinaryProtocol3);
+            auto payload_size = ntohs(p3->payload_size);
+            if (p + payload_size > end) {
+                break;
+            }
+            opus.assign(p3->payload, p3->payload + payload_size);
+            p += payload_size;
+
+            if (!decoder.Decode(opus, pcm)) {
+                ESP_LOGE(TAG, "Failed to decode sound frame");
+                continue;
+            }
+            if (sample_rate != SOUND_SAMPLE_RATE) {
+                resampled.resize(resampler.GetOutputSamples(pcm.size()));
+                resampler.Process(pcm.data(), pcm.size(), resampled.data());
+                pcm.swap(resampled);
+            }
+            clip->pcm.insert(clip->pcm.end(), pcm.begin(), pcm.end());
+        }
+    }
+    clip->pcm.shrink_to_fit();
+    ESP_LOGI(TAG, "Decoded sound of %u samples at %d Hz in %ld ms", clip->pcm.size(), clip->sample_rate,
+        (long)((esp_timer_get_time() - start_time) / 1000));
+
+    return clip->pcm.empty() ? nullptr : clip;
+}
@@ -0,0 +1,67 @@
+#ifndef SOUND_CACHE_H
+#define SOUND_CACHE_H
+
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <string_view>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "audio_mixer.h"
+
+/*
+ * Decoded PCM of the embedded p3 sounds.
+ *
+ * A sound is decoded the first time it is played, with a decoder of its own (so the
+ * conversation decoder's state is left alone) and resampled to the codec rate. The clips are
+ * kept in PSRAM up to a byte budget and the least recently played ones are evicted. Later plays
+ * hand the same clip to the mixer, with no decoding and no copy. A clip that is playing when it
+ * is evicted stays alive until the mixer is done with it.
+ */
+class SoundCache {
+public:
+    explicit SoundCache(size_t budget_bytes);
+    ~SoundCache();
+    SoundCache(const SoundCache&) = delete;
+    SoundCache& operator=(const SoundCache&) = delete;
+
+    /* Returns the clip at sample_rate, decoding it if needed; nullptr if it could not be decoded */
+    std::shared_ptr<const PcmClip> Get(const std::string_view& sound, int sample_rate);
+    void Clear();
+    size_t size_bytes() const { return bytes_; }
+
+private:
+    struct Entry {
+        const char* data;     // Embedded sounds never move, so their address is the key
+        std::shared_ptr<const PcmClip> clip;
+        uint32_t last_used;
+    };
+
+    std::shared_ptr<const PcmClip> Find(const char* data, int sample_rate);
+    void Insert(const char* data, std::shared_ptr<const PcmClip> clip);
+    std::shared_ptr<const PcmClip> Decode(const std::string_view& sound, int sample_rate);
+    void DecodeTask();
+    std::shared_ptr<PcmClip> DecodeClip(const std::string_view& sound, int sample_rate);
+
+    size_t budget_bytes_;
+    size_t bytes_ = 0;
+    uint32_t use_count_ = 0;
+    std::mutex mutex_;
+    std::vector<Entry> entries_;
+
+    // One decode at a time, on a persistent task with a stack big enough for libopus
+    std::mutex decode_mutex_;
+    std::condition_variable decode_cv_;
+    bool decode_done_ = false;
+    std::string_view decode_sound_;
+    int decode_sample_rate_ = 0;
+    std::shared_ptr<PcmClip> decode_result_;
+    StackType_t* decode_task_stack_ = nullptr;
+    StaticTask_t* decode_task_buffer_ = nullptr;
+    TaskHandle_t decode_task_ = nullptr;
+};
+
+#endif // SOUND_CACHE_H
@@ -5,6 +5,7 @@
 #include "application.h"
 #include "protocols/protocol.h"
 #include "display/display.h"
+#include "display/cover_art_decoder.h"
 // Include board-specific display implementation for runtime casting
 #include "boards/jkst-spaceman-s/otto_emoji_display.h"
 
@@ -166,8 +167,19 @@ static std::string buildUrlWithParams(const std::string& base_url, const std::st
 }
 
 Esp32Music::Esp32Music() : last_downloaded_data_(), current_music_url_(), current_song_name_(),
-                         song_name_displayed_(false), current_lyric_url_(), lyrics_(), 
-                         current_lyric_index_(-1), lyric_thread_(), is_lyric_running_(false),
+                         song_name_displayed_(false), current_lyric_url_(),
+                         lyric_scheduler_([](const char* previous, const char* current, const char* next) {
+                             auto display = Board::GetInstance().GetDisplay();
+                             if (display) {
+                                 display->SetLyrics(previous, current, next);
+                             }
+                         }, [](int highlighted_chars) {
+                             auto display = Board::GetInstance().GetDisplay();
+                             if (display) {
+                                 display->SetLyricProgress(highlighted_chars);
+                             }
+                         }),
+                         lyric_thread_(), is_lyric_running_(false),
                          display_mode_(DISPLAY_MODE_LYRICS), is_playing_(false), is_downloading_(false), 
                          play_thread_(), download_thread_(), audio_buffer_(), buffer_mutex_(), 
                          buffer_cv_(), buffer_size_(0), mp3_decoder_(nullptr), mp3_frame_info_(), 
@@ -389,6 +401,16 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                     // 异步下载封面，避免阻塞主流程
                     std::thread([cover](){
                         auto& board = Board::GetInstance();
+                        // 缓存键包含目标尺寸，查询前先设定预览缩放比例
+                        auto display = board.GetDisplay();
+                        if (display) {
+                            // Request larger preview scaling for testing (Display::SetPreviewScaling is a no-op by default)
+                            display->SetPreviewScaling(85, 70, 95);
+                            if (display->SetPreviewImageFromCache(cover)) {
+                                ESP_LOGI(TAG, "Cover art cache hit, skip download");
+                                return;
+                            }
+                        }
                         auto network = board.GetNetwork();
                         auto http = network->CreateHttp(0);
                         if (!http) {
@@ -408,25 +430,40 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                             return;
                         }
 
-                        // 读取到 SPIRAM 缓冲
-                        size_t max_size = 64 * 1024; // 限制 64KB
-                        uint8_t* buf = (uint8_t*)heap_caps_malloc(max_size, MALLOC_CAP_SPIRAM);
+                        // 直接下载到解码管线的缓冲区，交给显示后不再复制。
+                        // Content-Length 已知时一次分配到位，否则按需扩容，上限由封面图 PSRAM 预算决定
+                        size_t content_length = http->GetBodyLength();
+                        size_t capacity = content_length > 0 ? content_length : 32 * 1024;
+                        uint8_t* buf = CoverArtDecoder::AllocEncodedBuffer(capacity);
                         if (!buf) {
-                            ESP_LOGE(TAG, "Cover download: failed to allocate SPIRAM buffer");
+                            ESP_LOGE(TAG, "Cover download: failed to allocate %d bytes", (int)capacity);
                             http->Close();
                             return;
                         }
 
                         size_t total = 0;
                         while (true) {
-                            int r = http->Read((char*)(buf + total), (int)(max_size - total));
+                            if (total == capacity) {
+                                if (content_length > 0) {
+                                    break;
+                                }
+                                uint8_t* grown = CoverArtDecoder::ResizeEncodedBuffer(buf, capacity, capacity * 2);
+                                if (!grown) {
+                                    ESP_LOGW(TAG, "Cover download: image exceeds budget, dropped");
+                                    total = 0;
+                                    break;
+                                }
+                                buf = grown;
+                                capacity *= 2;
+                            }
+                            int r = http->Read((char*)(buf + total), (int)(capacity - total));
                             if (r > 0) {
                                 total += (size_t)r;
-                                if (total >= max_size) break;
                             } else if (r == 0) {
                                 break;
                             } else {
                                 ESP_LOGW(TAG, "Cover download: read error %d", r);
+                                total = 0;
                                 break;
                             }
                         }
@@ -434,27 +471,31 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
 
                         if (total == 0) {
                             ESP_LOGW(TAG, "Cover download: no data received");
-                            heap_caps_free(buf);
+                            CoverArtDecoder::FreeEncodedBuffer(buf, capacity);
                             return;
                         }
+                        if (total < capacity) {
+                            uint8_t* shrunk = CoverArtDecoder::ResizeEncodedBuffer(buf, capacity, total);
+                            if (shrunk) {
+                                buf = shrunk;
+                                capacity = total;
+                            }
+                        }
 
-                        // 通过 Display API 设置预览图（调用方负责释放 buf）
-                        auto& board2 = Board::GetInstance();
-                        auto display = board2.GetDisplay();
+                        // 通过 Display API 设置预览图，缓冲区所有权转交给显示（失败时由显示释放）
                         if (display) {
-                            // Request larger preview scaling for testing (Display::SetPreviewScaling is a no-op by default)
-                            display->SetPreviewScaling(85, 70, 95);
-                            if (display->SetPreviewImageFromMemory(buf, total)) {
-                                ESP_LOGI(TAG, "Cover download: preview image set, size=%d bytes", (int)total);
-                                // display made an internal copy; we can free our downloaded buffer
-                                heap_caps_free(buf);
+                            if (capacity != total) {
+                                // 收缩失败时按实际分配大小交接，保证预算记账一致
+                                ESP_LOGW(TAG, "Cover download: failed to shrink buffer");
+                            }
+                            if (display->SetPreviewImageFromBuffer(buf, capacity, cover)) {
+                                ESP_LOGI(TAG, "Cover download: preview image queued, size=%d bytes", (int)total);
                             } else {
                                 ESP_LOGW(TAG, "Cover download: display rejected image buffer");
-                                heap_caps_free(buf);
                             }
                         } else {
                             ESP_LOGW(TAG, "Cover download: no display available");
-                            heap_caps_free(buf);
+                            CoverArtDecoder::FreeEncodedBuffer(buf, capacity);
                         }
                     }).detach();
                 }
@@ -493,8 +534,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                         }
                         
                         is_lyric_running_ = true;
-                        current_lyric_index_ = -1;
-                        lyrics_.clear();
+                        lyric_scheduler_.Stop();
 
                         // 创建歌词线程时捕获异常（可能由于内存不足导致pthread创建失败）
                         // 在创建前记录堆使用情况，尝试一次使用较小的 pthread 栈作为回退
@@ -504,7 +544,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
 
                         bool lyric_thread_created = false;
                         try {
-                            lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
+                            lyric_thread_ = std::thread(&Esp32Music::LyricDownloadThread, this);
                             lyric_thread_created = true;
                         } catch (const std::system_error& e) {
                             ESP_LOGW(TAG, "Initial lyric thread creation failed: %s", e.what());
@@ -528,7 +568,7 @@ bool Esp32Music::Download(const std::string& song_name, const std::string& artis
                             ESP_LOGI(TAG, "Retrying lyric thread creation with safe stack=%u - free_heap=%u", (unsigned)safe_stack, (unsigned)free_mid);
 
                             try {
-                                lyric_thread_ = std::thread(&Esp32Music::LyricDisplayThread, this);
+                                lyric_thread_ = std::thread(&Esp32Music::LyricDownloadThread, this);
                                 lyric_thread_created = true;
                                 ESP_LOGI(TAG, "Lyric thread created with safe stack");
                             } catch (const std::system_error& e) {
@@ -702,6 +742,9 @@ bool Esp32Music::StopStreaming() {
 
     // 重置采样率到原始值
     ResetSampleRate();
+
+    // 丢弃混音器中尚未播放的音乐
+    Application::GetInstance().GetAudioService().ClearMusic();
     
     // 检查是否有流式播放正在进行
     if (!is_playing_ && !is_downloading_) {
@@ -801,11 +844,11 @@ bool Esp32Music::StopStreaming() {
             ESP_LOGI(TAG, "Lyric thread joined in StopStreaming");
         }
     }
+    lyric_scheduler_.Stop();
 
     // Explicitly clear/hide lyric display and any preview image to avoid leftovers
     if (display) {
-        // Use nullptr to indicate hiding lyrics in SetChatMessage
-        display->SetChatMessage("lyric", nullptr);
+        display->SetLyrics(nullptr, nullptr, nullptr);
         display->ClearPreviewImage();
         ESP_LOGI(TAG, "Cleared lyric and preview in StopStreaming cleanup");
     }
@@ -966,6 +1009,7 @@ void Esp32Music::PlayAudioStream() {
     current_play_time_ms_ = 0;
     last_frame_time_ms_ = 0;
     total_frames_decoded_ = 0;
+    int64_t next_lyric_sync_ms = 0;  // 下一次校准歌词时钟的播放位置
     
     auto codec = Board::GetInstance().GetAudioCodec();
     if (!codec || !codec->output_enabled()) {
@@ -1045,6 +1089,13 @@ void Esp32Music::PlayAudioStream() {
         // {
         //     ESP_LOGI(TAG, "Device is in listening state, switching to idle state for music playback");
 
+#if CONFIG_MUSIC_DUCK_IN_CONVERSATION
+        // 对话时由混音器压低音乐后与语音混合播放，不需要切换到待机状态
+        if (current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking) {
+            current_state = kDeviceStateIdle;
+        }
+#endif
+
             // 状态转换：说话中-》聆听中-》待机状态-》播放音乐
             if (current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking) {
                 if (current_state == kDeviceStateSpeaking) {
@@ -1102,8 +1153,10 @@ void Esp32Music::PlayAudioStream() {
                         ESP_LOGI(TAG, "Playback finished, total played: %d bytes", total_played);
                         break;
                     }
-                    // 等待新数据
+                    // 等待新数据，恢复后立即校准歌词时钟；断流也计为一次解码超时
+                    deadline_misses_++;
                     buffer_cv_.wait(lock, [this] { return !audio_buffer_.empty() || !is_downloading_; });
+                    next_lyric_sync_ms = 0;
                     if (audio_buffer_.empty()) {
                         continue;
                     }
@@ -1177,6 +1230,7 @@ void Esp32Music::PlayAudioStream() {
         
         // 解码MP3帧
         int16_t pcm_buffer[2304];
+        int64_t decode_start_us = esp_timer_get_time();
         int decode_result = MP3Decode(mp3_decoder_, &read_ptr, &bytes_left, pcm_buffer, 0);
         
     if (decode_result == 0) {
@@ -1202,9 +1256,11 @@ void Esp32Music::PlayAudioStream() {
                     total_frames_decoded_, current_play_time_ms_, frame_duration_ms,
                     mp3_frame_info_.samprate, mp3_frame_info_.nChans);
             
-            // 更新歌词显示
-            int buffer_latency_ms = 600; // 实测调整值
-            UpdateLyricDisplay(current_play_time_ms_ + buffer_latency_ms);
+            // 歌词由 LyricScheduler 定时切换，这里只周期性校准其播放时钟
+            if (current_play_time_ms_ >= next_lyric_sync_ms) {
+                lyric_scheduler_.Sync(current_play_time_ms_ + LYRIC_BUFFER_LATENCY_MS);
+                next_lyric_sync_ms = current_play_time_ms_ + LYRIC_SYNC_INTERVAL_MS;
+            }
             
             // 将PCM数据发送到Application的音频解码队列
             if (mp3_frame_info_.outputSamps > 0) {
@@ -1239,6 +1295,11 @@ void Esp32Music::PlayAudioStream() {
                     ESP_LOGW(TAG, "Unsupported channel count: %d, treating as mono", 
                             mp3_frame_info_.nChans);
                 }
+
+                // 解码和声道转换超过帧时长的一半，说明 CPU 已跟不上实时播放
+                if (esp_timer_get_time() - decode_start_us > frame_duration_ms * 1000 / 2) {
+                    deadline_misses_++;
+                }
                 
                 // 创建AudioStreamPacket
                 AudioStreamPacket packet;
@@ -1263,6 +1324,12 @@ void Esp32Music::PlayAudioStream() {
                     final_pcm_data,
                     final_sample_count * sizeof(int16_t)
                 );
+                if (display_mode_ == DISPLAY_MODE_SPECTRUM) {
+                    auto display = Board::GetInstance().GetDisplay();
+                    if (display) {
+                        display->NotifyAudioData();
+                    }
+                }
                 
                 ESP_LOGD(TAG, "Sending %d PCM samples (%d bytes, rate=%d, channels=%d->1) to Application", 
                         final_sample_count, pcm_size_bytes, mp3_frame_info_.samprate, mp3_frame_info_.nChans);
@@ -1272,31 +1339,7 @@ void Esp32Music::PlayAudioStream() {
                 if (packet.payload.size() == 0 || (packet.payload.size() % sizeof(int16_t)) != 0) {
                     ESP_LOGW(TAG, "Invalid PCM payload size: %d, skipping frame", (int)packet.payload.size());
                 } else {
-                    // 检查并确保AudioCodec的输出采样率与帧采样率一致
-                    auto& board = Board::GetInstance();
-                    auto codec = board.GetAudioCodec();
-                    if (codec) {
-                        if (codec->output_sample_rate() != mp3_frame_info_.samprate) {
-                            ESP_LOGI(TAG, "Attempting to set codec output sample rate to %d Hz", mp3_frame_info_.samprate);
-                            if (!codec->SetOutputSampleRate(mp3_frame_info_.samprate)) {
-                                ESP_LOGE(TAG, "Failed to set codec sample rate to %d Hz, stopping playback to avoid driver errors", mp3_frame_info_.samprate);
-                                is_playing_ = false;
-                                // Ensure animations are resumed before breaking out
-                                {
-                                    auto& board = Board::GetInstance();
-                                    auto display = board.GetDisplay();
-                                    if (display) {
-                                        display->ResumeAnimations();
-                                        ESP_LOGI(TAG, "Resumed display animations (codec sample rate set failed)");
-                                    }
-                                }
-                                // chunk.data 已在上游复制到 mp3_input_buffer 后被释放，
-                                // 此处不能再次访问或释放它（会导致编译错误/双重释放）。
-                                break;
-                            }
-                        }
-                    }
-
+                    // 采样率由混音器转换到编解码器的输出采样率，不再切换编解码器采样率
                     app.AddAudioData(std::move(packet));
                 }
                 total_played += pcm_size_bytes;
@@ -1379,6 +1422,7 @@ void Esp32Music::PlayAudioStream() {
             ESP_LOGI(TAG, "Lyric thread joined in play cleanup");
         }
     }
+    lyric_scheduler_.Stop();
 
     // 清理封面预览（如果有的话）并隐藏歌词标签
     {
@@ -1487,7 +1531,6 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
 
     // 简化的重试逻辑（最多3次）
     const int max_retries = 3;
-    std::string lyric_content;
     bool success = false;
 
     for (int attempt = 0; attempt < max_retries && !success; ++attempt) {
@@ -1520,21 +1563,13 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
             continue;
         }
 
-        // 读取内容到堆缓冲
-        const size_t chunk_sz = 1024;
-        char* buf = (char*)heap_caps_malloc(chunk_sz, MALLOC_CAP_SPIRAM);
-        if (!buf) {
-            ESP_LOGE(TAG, "Failed to allocate SPIRAM buffer for lyrics");
-            http->Close();
-            break;
-        }
-
-        lyric_content.clear();
-        while (true) {
-            int r = http->Read(buf, (int)chunk_sz - 1);
+        // 边下载边解析，已解析的歌词无需等待下载完成即可显示
+        char buf[512];
+        lyric_scheduler_.BeginLyrics(http->GetBodyLength());
+        while (is_lyric_running_) {
+            int r = http->Read(buf, sizeof(buf));
             if (r > 0) {
-                buf[r] = '\0';
-                lyric_content.append(buf, (size_t)r);
+                lyric_scheduler_.AppendLyrics(buf, (size_t)r);
             } else if (r == 0) {
                 success = true;
                 break;
@@ -1544,128 +1579,34 @@ bool Esp32Music::DownloadLyrics(const std::string& lyric_url) {
             }
         }
 
-        heap_caps_free(buf);
         http->Close();
+        if (!is_lyric_running_) {
+            return false;
+        }
     }
 
     if (!success) {
         ESP_LOGW(TAG, "Failed to download lyrics after %d attempts", max_retries);
+        lyric_scheduler_.Stop();
         return false;
     }
 
-    // 逐行解析 LRC 时间标签 [mm:ss.xx]text
-    lyrics_.clear();
-    size_t pos = 0;
-    while (pos < lyric_content.size()) {
-        size_t nl = lyric_content.find('\n', pos);
-        std::string line = (nl == std::string::npos) ? lyric_content.substr(pos) : lyric_content.substr(pos, nl - pos);
-        pos = (nl == std::string::npos) ? lyric_content.size() : nl + 1;
-
-        if (!line.empty() && line.back() == '\r') line.pop_back();
-        if (line.empty()) continue;
-
-        if (line.size() > 4 && line[0] == '[') {
-            size_t rb = line.find(']');
-            if (rb == std::string::npos) continue;
-            std::string tag = line.substr(1, rb - 1);
-            std::string text = (rb + 1 < line.size()) ? line.substr(rb + 1) : std::string();
-            size_t colon = tag.find(':');
-            if (colon == std::string::npos) continue;
-            bool digits = true;
-            for (size_t i = 0; i < colon; ++i) if (!isdigit((unsigned char)tag[i])) { digits = false; break; }
-            if (!digits) continue;
-            try {
-                int mm = std::stoi(tag.substr(0, colon));
-                float ss = std::stof(tag.substr(colon + 1));
-                int ts = mm * 60000 + (int)(ss * 1000);
-                lyrics_.push_back(std::make_pair(ts, text));
-            } catch (...) {
-                continue;
-            }
-        }
-    }
-
-    std::sort(lyrics_.begin(), lyrics_.end());
-    ESP_LOGI(TAG, "Parsed %d lyric lines", lyrics_.size());
-    return !lyrics_.empty();
+    size_t count = lyric_scheduler_.EndLyrics();
+    ESP_LOGI(TAG, "Parsed %u lyric lines", (unsigned)count);
+    return count > 0;
 }
 
-// 歌词显示线程
-void Esp32Music::LyricDisplayThread() {
-    ESP_LOGI(TAG, "Lyric display thread started");
+// 歌词下载线程：解析完成后把歌词交给 LyricScheduler 即退出
+void Esp32Music::LyricDownloadThread() {
+    ESP_LOGI(TAG, "Lyric download thread started");
     
     if (!DownloadLyrics(current_lyric_url_)) {
         ESP_LOGE(TAG, "Failed to download or parse lyrics");
         is_lyric_running_ = false;
         return;
     }
-    // 下载成功后，立即尝试一次更新显示，避免出现播放第一首歌时歌词未及时显示的竞态
-    {
-        int buffer_latency_ms = 600; // 与播放线程保持一致的延迟补偿
-        int64_t snap_time = current_play_time_ms_ + buffer_latency_ms;
-        ESP_LOGI(TAG, "Lyrics downloaded, forcing initial lyric update at %lldms", snap_time);
-        UpdateLyricDisplay(snap_time);
-        // 小等待后再尝试一次，覆盖极端竞态情况
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-        UpdateLyricDisplay(snap_time);
-    }
-    
-    // 定期检查是否需要更新显示(频率可以降低)
-    while (is_lyric_running_ && is_playing_) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-    }
-    
-    ESP_LOGI(TAG, "Lyric display thread finished");
-}
-
-void Esp32Music::UpdateLyricDisplay(int64_t current_time_ms) {
-    std::lock_guard<std::mutex> lock(lyrics_mutex_);
-    
-    if (lyrics_.empty()) {
-        return;
-    }
-    
-    // 查找当前应该显示的歌词
-    int new_lyric_index = -1;
-    
-    // 从当前歌词索引开始查找，提高效率
-    int start_index = (current_lyric_index_.load() >= 0) ? current_lyric_index_.load() : 0;
     
-    // 正向查找：找到最后一个时间戳小于等于当前时间的歌词
-    for (int i = start_index; i < (int)lyrics_.size(); i++) {
-        if (lyrics_[i].first <= current_time_ms) {
-            new_lyric_index = i;
-        } else {
-            break;  // 时间戳已超过当前时间
-        }
-    }
-    
-    // 如果没有找到(可能当前时间比第一句歌词还早)，显示空
-    if (new_lyric_index == -1) {
-        new_lyric_index = -1;
-    }
-    
-    // 如果歌词索引发生变化，更新显示
-    if (new_lyric_index != current_lyric_index_) {
-        current_lyric_index_ = new_lyric_index;
-        
-        auto& board = Board::GetInstance();
-        auto display = board.GetDisplay();
-        if (display) {
-            std::string lyric_text;
-            
-            if (current_lyric_index_ >= 0 && current_lyric_index_ < (int)lyrics_.size()) {
-                lyric_text = lyrics_[current_lyric_index_].second;
-            }
-            
-            // 显示歌词
-            display->SetChatMessage("lyric", lyric_text.c_str());
-            
-            ESP_LOGD(TAG, "Lyric update at %lldms: %s", 
-                    current_time_ms, 
-                    lyric_text.empty() ? "(no lyric)" : lyric_text.c_str());
-        }
-    }
+    ESP_LOGI(TAG, "Lyric download thread finished");
 }
 
 // 删除复杂的认证初始化方法，使用简单的静态函数
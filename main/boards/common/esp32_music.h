@@ -10,6 +10,7 @@
 #include <vector>
 
 #include "music.h"
+#include "lyric_scheduler.h"
 
 // MP3解码器支持
 extern "C" {
@@ -41,10 +42,8 @@ private:
     
     // 歌词相关
     std::string current_lyric_url_;
-    std::vector<std::pair<int, std::string>> lyrics_;  // 时间戳和歌词文本
-    std::mutex lyrics_mutex_;  // 保护lyrics_数组的互斥锁
-    std::atomic<int> current_lyric_index_;
-    std::thread lyric_thread_;
+    LyricScheduler lyric_scheduler_;  // 按播放时钟定时切换歌词
+    std::thread lyric_thread_;  // 仅用于下载歌词，下载完成后即退出
     std::atomic<bool> is_lyric_running_;
     
     std::atomic<DisplayMode> display_mode_;
@@ -55,6 +54,7 @@ private:
     int64_t current_play_time_ms_;  // 当前播放时间(毫秒)
     int64_t last_frame_time_ms_;    // 上一帧的时间戳
     int total_frames_decoded_;      // 已解码的帧数
+    std::atomic<uint32_t> deadline_misses_{0};  // 解码超时与断流次数
 
     // 音频缓冲区
     std::queue<AudioChunk> audio_buffer_;
@@ -63,6 +63,8 @@ private:
     size_t buffer_size_;
     static constexpr size_t MAX_BUFFER_SIZE = 256 * 1024;  // 256KB缓冲区（降低以减少brownout风险）
     static constexpr size_t MIN_BUFFER_SIZE = 32 * 1024;   // 32KB最小播放缓冲（降低以减少brownout风险）
+    static constexpr int LYRIC_BUFFER_LATENCY_MS = 600;    // 解码到实际出声的延迟补偿（实测调整值）
+    static constexpr int LYRIC_SYNC_INTERVAL_MS = 1000;    // 解码线程校准歌词时钟的间隔
     
     // MP3解码器相关
     HMP3Decoder mp3_decoder_;
@@ -79,9 +81,7 @@ private:
     
     // 歌词相关私有方法
     bool DownloadLyrics(const std::string& lyric_url);
-    bool ParseLyrics(const std::string& lyric_content);
-    void LyricDisplayThread();
-    void UpdateLyricDisplay(int64_t current_time_ms);
+    void LyricDownloadThread();
     
     // ID3标签处理
     size_t SkipId3Tag(uint8_t* data, size_t size);
@@ -102,6 +102,7 @@ public:
     virtual size_t GetBufferSize() const override { return buffer_size_; }
     virtual bool IsDownloading() const override { return is_downloading_; }
     virtual int16_t* GetAudioData() override { return final_pcm_data_fft; }
+    virtual uint32_t GetDeadlineMisses() const override { return deadline_misses_; }
     
     // 显示模式控制方法
     void SetDisplayMode(DisplayMode mode);
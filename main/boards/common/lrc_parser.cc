@@ -0,0 +1,215 @@
+#include "lrc_parser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+
+// 一行中最多识别的时间标签数量
+#define LRC_MAX_TAGS_PER_LINE 16
+
+void LrcParser::Reset() {
+    arena_.clear();
+    lines_.clear();
+    words_.clear();
+    offset_ms_ = 0;
+    line_len_ = 0;
+    at_start_ = true;
+}
+
+void LrcParser::Reserve(size_t content_length) {
+    // 文本最多与文件一样长；按每行约 32 字节估算行数
+    arena_.reserve(content_length);
+    lines_.reserve(content_length / 32 + 16);
+}
+
+void LrcParser::Feed(const char* data, size_t len) {
+    const char* end = data + len;
+    while (data < end) {
+        auto newline = (const char*)memchr(data, '\n', end - data);
+        const char* segment_end = newline ? newline : end;
+        size_t copy = std::min((size_t)(segment_end - data), MAX_LINE_LENGTH - line_len_);
+        memcpy(line_ + line_len_, data, copy);
+        line_len_ += copy;
+        if (newline == nullptr) {
+            break;
+        }
+        ParseLine();
+        line_len_ = 0;
+        data = newline + 1;
+    }
+}
+
+void LrcParser::Finish() {
+    if (line_len_ > 0) {
+        ParseLine();
+        line_len_ = 0;
+    }
+}
+
+std::string_view LrcParser::LineText(size_t index) const {
+    auto& line = lines_[index];
+    return std::string_view(arena_.data() + line.text_offset, line.text_len);
+}
+
+const LrcParser::Word* LrcParser::LineWords(size_t index) const {
+    auto& line = lines_[index];
+    return line.word_count > 0 ? &words_[line.word_index] : nullptr;
+}
+
+int LrcParser::FindLine(int64_t position_ms) const {
+    int64_t raw = position_ms + offset_ms_;
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), raw, [](int64_t time, const Line& line) {
+        return time < line.time_ms;
+    });
+    return (int)(it - lines_.begin()) - 1;
+}
+
+void LrcParser::ParseLine() {
+    const char* p = line_;
+    const char* end = line_ + line_len_;
+    if (at_start_) {
+        at_start_ = false;
+        if (line_len_ >= 3 && memcmp(p, "\xEF\xBB\xBF", 3) == 0) {
+            p += 3;
+        }
+    }
+    if (p < end && end[-1] == '\r') {
+        end--;
+    }
+
+    // 行首连续的 [..] 标签：时间标签、offset 或其他元数据
+    int32_t times[LRC_MAX_TAGS_PER_LINE];
+    int time_count = 0;
+    while (p < end && *p == '[') {
+        auto close = (const char*)memchr(p, ']', end - p);
+        if (close == nullptr) {
+            return;
+        }
+        int32_t time_ms;
+        if (ParseTime(p + 1, close, time_ms)) {
+            if (time_count < LRC_MAX_TAGS_PER_LINE) {
+                times[time_count++] = time_ms;
+            }
+        } else if (!ParseOffset(p + 1, close)) {
+            // [ar:] [ti:] 等元数据
+            if (time_count == 0) {
+                return;
+            }
+            break;
+        }
+        p = close + 1;
+    }
+    if (time_count == 0) {
+        return;
+    }
+
+    // 复制文本到 arena，同时提取 <mm:ss.xx> 逐字时间
+    uint32_t text_offset = arena_.size();
+    uint32_t word_index = words_.size();
+    while (p < end) {
+        if (*p == '<') {
+            auto close = (const char*)memchr(p, '>', end - p);
+            int32_t time_ms;
+            if (close != nullptr && ParseTime(p + 1, close, time_ms)) {
+                words_.push_back({time_ms - times[0], (uint16_t)(arena_.size() - text_offset), 0});
+                p = close + 1;
+                continue;
+            }
+        }
+        arena_.push_back(*p++);
+    }
+    while (arena_.size() > text_offset && (arena_.back() == ' ' || arena_.back() == '\t')) {
+        arena_.pop_back();
+    }
+    uint16_t text_len = arena_.size() - text_offset;
+
+    // 增强 LRC 行尾通常还有一个结束时间标签，丢弃不含文字的字记录
+    while (words_.size() > word_index && words_.back().text_offset >= text_len) {
+        words_.pop_back();
+    }
+    for (size_t i = word_index; i < words_.size(); i++) {
+        uint16_t next = (i + 1 < words_.size()) ? words_[i + 1].text_offset : text_len;
+        words_[i].text_len = next - words_[i].text_offset;
+    }
+    uint16_t word_count = words_.size() - word_index;
+
+    for (int i = 0; i < time_count; i++) {
+        InsertLine({times[i], text_offset, text_len, word_count, word_index});
+    }
+}
+
+// 解析 mm:ss、mm:ss.x、mm:ss.xx、mm:ss.xxx 以及 mm:ss:xx
+bool LrcParser::ParseTime(const char* begin, const char* end, int32_t& time_ms) const {
+    const char* p = begin;
+    int minutes = 0;
+    int digits = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits < 4) {
+        minutes = minutes * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (digits == 0 || p >= end || *p++ != ':') {
+        return false;
+    }
+    int seconds = 0;
+    digits = 0;
+    while (p < end && *p >= '0' && *p <= '9' && digits < 2) {
+        seconds = seconds * 10 + (*p++ - '0');
+        digits++;
+    }
+    if (digits == 0) {
+        return false;
+    }
+    int millis = 0;
+    if (p < end && (*p == '.' || *p == ':')) {
+        p++;
+        int scale = 100;
+        digits = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (digits < 3) {
+                millis += (*p - '0') * scale;
+                scale /= 10;
+            }
+            p++;
+            digits++;
+        }
+        if (digits == 0) {
+            return false;
+        }
+    }
+    if (p != end) {
+        return false;
+    }
+    time_ms = minutes * 60000 + seconds * 1000 + millis;
+    return true;
+}
+
+// [offset:+500]：正值表示歌词提前显示
+bool LrcParser::ParseOffset(const char* begin, const char* end) {
+    static const char kOffsetTag[] = "offset:";
+    size_t tag_len = sizeof(kOffsetTag) - 1;
+    if ((size_t)(end - begin) <= tag_len || strncasecmp(begin, kOffsetTag, tag_len) != 0) {
+        return false;
+    }
+    const char* p = begin + tag_len;
+    while (p < end && *p == ' ') {
+        p++;
+    }
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-')) {
+        negative = *p++ == '-';
+    }
+    int32_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+    }
+    offset_ms_ = negative ? -value : value;
+    return true;
+}
+
+void LrcParser::InsertLine(const Line& line) {
+    // 大多数行按时间顺序出现，upper_bound 后通常直接追加到末尾
+    auto it = std::upper_bound(lines_.begin(), lines_.end(), line.time_ms, [](int32_t time, const Line& other) {
+        return time < other.time_ms;
+    });
+    lines_.insert(it, line);
+}
@@ -0,0 +1,63 @@
+#ifndef LRC_PARSER_H
+#define LRC_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+// 流式 LRC 解析器：按 HTTP 分块逐段喂入，每解析完一行即可查询。
+// 支持一行多个时间标签 [00:12.00][01:30.00]、[offset:±ms] 以及增强 LRC 的逐字时间 <mm:ss.xx>。
+// 所有歌词文本存放在同一块 arena 中，行和字只保存紧凑的偏移记录。
+class LrcParser {
+public:
+    struct Line {
+        int32_t time_ms;        // 未应用 offset 的原始时间
+        uint32_t text_offset;   // 在 arena 中的位置
+        uint16_t text_len;
+        uint16_t word_count;    // 0 表示没有逐字时间
+        uint32_t word_index;    // 在 words_ 中的起始位置
+    };
+
+    struct Word {
+        int32_t delay_ms;       // 相对于所在行时间
+        uint16_t text_offset;   // 相对于所在行文本
+        uint16_t text_len;
+    };
+
+    // 单行最大长度，超出部分被截断
+    static constexpr size_t MAX_LINE_LENGTH = 512;
+
+    void Reset();
+    // 按文件大小预留空间，避免下载过程中反复扩容
+    void Reserve(size_t content_length);
+    void Feed(const char* data, size_t len);
+    // 处理最后一行没有换行符的情况
+    void Finish();
+
+    size_t LineCount() const { return lines_.size(); }
+    // 已应用 offset 的时间
+    int64_t LineTime(size_t index) const { return (int64_t)lines_[index].time_ms - offset_ms_; }
+    std::string_view LineText(size_t index) const;
+    const Line& GetLine(size_t index) const { return lines_[index]; }
+    const Word* LineWords(size_t index) const;
+    // 返回最后一个时间小于等于 position_ms 的行，没有则返回 -1
+    int FindLine(int64_t position_ms) const;
+
+private:
+    void ParseLine();
+    bool ParseTime(const char* begin, const char* end, int32_t& time_ms) const;
+    bool ParseOffset(const char* begin, const char* end);
+    void InsertLine(const Line& line);
+
+    std::vector<char> arena_;
+    std::vector<Line> lines_;   // 按 time_ms 排序
+    std::vector<Word> words_;
+    int32_t offset_ms_ = 0;
+
+    char line_[MAX_LINE_LENGTH];
+    size_t line_len_ = 0;
+    bool at_start_ = true;      // 用于跳过 UTF-8 BOM
+};
+
+#endif // LRC_PARSER_H
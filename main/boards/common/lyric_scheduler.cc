@@ -0,0 +1,245 @@
+#include "lyric_scheduler.h"
+#include "application.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <climits>
+
+#define TAG "LyricScheduler"
+
+// 行内最后一个字没有结束时间，最多按这个时长高亮
+#define LYRIC_LAST_WORD_MS 1000
+
+static int Utf8Length(std::string_view text) {
+    int count = 0;
+    for (unsigned char c : text) {
+        if ((c & 0xC0) != 0x80) {
+            count++;
+        }
+    }
+    return count;
+}
+
+LyricScheduler::LyricScheduler(LineCallback on_line, ProgressCallback on_progress)
+    : on_line_(on_line), on_progress_(on_progress) {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            auto self = static_cast<LyricScheduler*>(arg);
+            self->OnTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "lyric_timer",
+        .skip_unhandled_events = true,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &timer_));
+}
+
+LyricScheduler::~LyricScheduler() {
+    esp_timer_stop(timer_);
+    esp_timer_delete(timer_);
+}
+
+void LyricScheduler::BeginLyrics(size_t content_length) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    esp_timer_stop(timer_);
+    (*generation_)++;
+    lyrics_.Reset();
+    lyrics_.Reserve(content_length);
+    current_index_ = -1;
+    current_progress_ = -1;
+}
+
+void LyricScheduler::AppendLyrics(const char* data, size_t len) {
+    Update update;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t count = lyrics_.LineCount();
+        lyrics_.Feed(data, len);
+        if (synced_ && lyrics_.LineCount() != count) {
+            // 插入新行后原来的下标可能失效，强制重新查找
+            current_index_ = INT_MIN;
+            UpdateLocked(PositionLocked(), update);
+        }
+    }
+    Dispatch(update);
+}
+
+size_t LyricScheduler::EndLyrics() {
+    Update update;
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        size_t before = lyrics_.LineCount();
+        lyrics_.Finish();
+        count = lyrics_.LineCount();
+        if (synced_ && count != before) {
+            current_index_ = INT_MIN;
+            UpdateLocked(PositionLocked(), update);
+        }
+    }
+    Dispatch(update);
+    return count;
+}
+
+void LyricScheduler::Sync(int64_t position_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    anchor_time_us_ = esp_timer_get_time();
+    anchor_position_ms_ = position_ms;
+    synced_ = true;
+    // 立即触发定时器重新查找，解码线程不做任何歌词更新
+    esp_timer_stop(timer_);
+    esp_timer_start_once(timer_, 0);
+}
+
+void LyricScheduler::Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    esp_timer_stop(timer_);
+    (*generation_)++;
+    lyrics_.Reset();
+    current_index_ = -1;
+    current_progress_ = -1;
+    synced_ = false;
+}
+
+bool LyricScheduler::HasLyrics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return lyrics_.LineCount() > 0;
+}
+
+void LyricScheduler::OnTimer() {
+    Update update;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!synced_) {
+            return;
+        }
+        UpdateLocked(PositionLocked(), update);
+    }
+    Dispatch(update);
+}
+
+// 复制更新投递到主任务，显示可能持有锁很久，不能阻塞共享的 esp_timer 任务或调用者。
+// 上一次投递还未执行时只合并到待处理的更新里，主任务一次取走最新的歌词和进度。
+void LyricScheduler::Dispatch(const Update& update) {
+    if (!update.line_changed && !update.progress_changed) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pending_->mutex);
+        auto& pending = pending_->update;
+        if (pending.generation != update.generation) {
+            pending = Update();
+            pending.generation = update.generation;
+        }
+        if (update.line_changed) {
+            pending.line_changed = true;
+            pending.previous = update.previous;
+            pending.current = update.current;
+            pending.next = update.next;
+        }
+        if (update.progress_changed) {
+            pending.progress_changed = true;
+            pending.progress = update.progress;
+        }
+        if (pending_->posted) {
+            return;
+        }
+        pending_->posted = true;
+    }
+    Application::GetInstance().Schedule([pending = pending_, generation = generation_,
+                                         on_line = on_line_, on_progress = on_progress_]() {
+        Update update;
+        {
+            std::lock_guard<std::mutex> lock(pending->mutex);
+            update = std::move(pending->update);
+            pending->update = Update();
+            pending->posted = false;
+        }
+        if (generation->load() != update.generation) {
+            return;
+        }
+        if (update.line_changed && on_line) {
+            on_line(update.previous.c_str(), update.current.c_str(), update.next.c_str());
+        }
+        if (update.progress_changed && on_progress) {
+            on_progress(update.progress);
+        }
+    });
+}
+
+int64_t LyricScheduler::PositionLocked() const {
+    return anchor_position_ms_ + (esp_timer_get_time() - anchor_time_us_) / 1000;
+}
+
+void LyricScheduler::UpdateLocked(int64_t position_ms, Update& update) {
+    esp_timer_stop(timer_);
+    update.generation = generation_->load();
+    int count = lyrics_.LineCount();
+    if (count == 0) {
+        return;
+    }
+
+    int index = lyrics_.FindLine(position_ms);
+    int64_t next_event_ms = index + 1 < count ? lyrics_.LineTime(index + 1) : INT64_MAX;
+    int progress = index >= 0 ? KaraokeProgressLocked(index, position_ms, next_event_ms) : -1;
+    if (next_event_ms != INT64_MAX) {
+        int64_t delay_ms = std::max<int64_t>(next_event_ms - position_ms, 1);
+        esp_timer_start_once(timer_, delay_ms * 1000);
+    }
+
+    if (index != current_index_) {
+        current_index_ = index;
+        update.line_changed = true;
+        if (index > 0) {
+            update.previous = lyrics_.LineText(index - 1);
+        }
+        if (index >= 0) {
+            update.current = lyrics_.LineText(index);
+        }
+        if (index + 1 < count) {
+            update.next = lyrics_.LineText(index + 1);
+        }
+        ESP_LOGD(TAG, "Lyric update at %lldms: %s", position_ms,
+                 update.current.empty() ? "(no lyric)" : update.current.c_str());
+    }
+    if (progress != current_progress_ || update.line_changed) {
+        current_progress_ = progress;
+        update.progress_changed = true;
+        update.progress = progress;
+    }
+}
+
+// 返回已高亮的字符数，并把下一个字符的高亮时间合并到 next_event_ms
+int LyricScheduler::KaraokeProgressLocked(int index, int64_t position_ms, int64_t& next_event_ms) const {
+    auto& line = lyrics_.GetLine(index);
+    if (line.word_count == 0) {
+        return -1;
+    }
+    auto words = lyrics_.LineWords(index);
+    auto text = lyrics_.LineText(index);
+    int64_t line_time = lyrics_.LineTime(index);
+    int64_t line_end = next_event_ms;
+
+    // 第一个逐字时间之前的文字随第一个字一起高亮
+    int chars = Utf8Length(text.substr(0, words[0].text_offset));
+    for (int i = 0; i < line.word_count; i++) {
+        int64_t start = line_time + words[i].delay_ms;
+        int64_t end = i + 1 < line.word_count ? line_time + words[i + 1].delay_ms
+                                              : std::min(line_end, start + LYRIC_LAST_WORD_MS);
+        int length = Utf8Length(text.substr(words[i].text_offset, words[i].text_len));
+        if (position_ms < start) {
+            next_event_ms = std::min(next_event_ms, start);
+            return i == 0 ? 0 : chars;
+        }
+        if (position_ms >= end || end <= start || length == 0) {
+            chars += length;
+            continue;
+        }
+        int done = (int)((position_ms - start) * length / (end - start));
+        next_event_ms = std::min(next_event_ms, start + ((done + 1) * (end - start) + length - 1) / length);
+        return chars + done;
+    }
+    return chars;
+}
@@ -0,0 +1,81 @@
+#ifndef LYRIC_SCHEDULER_H
+#define LYRIC_SCHEDULER_H
+
+#include "lrc_parser.h"
+
+#include <esp_timer.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// 歌词时间轴调度器：以播放位置为锚点推算播放时钟，用一次性 esp_timer 在下一句歌词的时间点触发，
+// 解码线程只需偶尔调用 Sync 校准时钟，不再逐帧加锁查找歌词。
+// 更新通过 Application::Schedule 投递到主任务显示，定时器任务和解码线程都不会持有显示锁；
+// 主任务来不及处理时多次更新合并为一次，卡拉OK进度只显示最新值。
+// 歌词带逐字时间时，定时器还会在每个字符的高亮时间点触发，按字内时间线性插值。
+class LyricScheduler {
+public:
+    // 回调在主任务中执行，可以直接加显示锁
+    // 当前句切换：current 为空字符串表示第一句之前或间奏
+    using LineCallback = std::function<void(const char* previous, const char* current, const char* next)>;
+    // 卡拉OK进度：当前句已唱到的字符数（UTF-8 字符），-1 表示该句没有逐字时间
+    using ProgressCallback = std::function<void(int highlighted_chars)>;
+
+    LyricScheduler(LineCallback on_line, ProgressCallback on_progress);
+    ~LyricScheduler();
+
+    // 边下载边解析歌词：BeginLyrics 清空旧歌词，AppendLyrics 喂入 HTTP 分块，
+    // 每块解析完成后若时钟已校准就立即刷新当前歌词；EndLyrics 返回解析出的行数
+    void BeginLyrics(size_t content_length);
+    void AppendLyrics(const char* data, size_t len);
+    size_t EndLyrics();
+    // 用当前播放位置校准时钟（开始播放、跳转、卡顿恢复或周期性校准时调用），只重新定时，歌词在定时器中查找
+    void Sync(int64_t position_ms);
+    // 停止定时并清空歌词
+    void Stop();
+    bool HasLyrics();
+
+private:
+    struct Update {
+        bool line_changed = false;
+        std::string previous;
+        std::string current;
+        std::string next;
+        bool progress_changed = false;
+        int progress = -1;
+        uint32_t generation = 0;
+    };
+
+    // 已投递、还未被主任务取走的更新
+    struct Pending {
+        std::mutex mutex;
+        Update update;
+        bool posted = false;
+    };
+
+    void OnTimer();
+    // 计算 position_ms 处的歌词和进度并设定下一次定时，结果在释放锁后通过 Dispatch 回调
+    void UpdateLocked(int64_t position_ms, Update& update);
+    int KaraokeProgressLocked(int index, int64_t position_ms, int64_t& next_event_ms) const;
+    void Dispatch(const Update& update);
+    int64_t PositionLocked() const;
+
+    LineCallback on_line_;
+    ProgressCallback on_progress_;
+    esp_timer_handle_t timer_ = nullptr;
+    std::mutex mutex_;
+    LrcParser lyrics_;
+    int current_index_ = -1;
+    int current_progress_ = -1;
+    bool synced_ = false;
+    int64_t anchor_time_us_ = 0;       // 校准时的 esp_timer_get_time()
+    int64_t anchor_position_ms_ = 0;   // 校准时的播放位置
+    // Stop/BeginLyrics 时加一，丢弃之前投递但还未执行的更新
+    std::shared_ptr<std::atomic<uint32_t>> generation_ = std::make_shared<std::atomic<uint32_t>>(0);
+    std::shared_ptr<Pending> pending_ = std::make_shared<Pending>();
+};
+
+#endif // LYRIC_SCHEDULER_H
@@ -155,6 +155,9 @@ std::string Ml307Board::GetDeviceStatusJson() {
     if (display && display->height() > 64) { // For LCD display only
         cJSON_AddStringToObject(screen, "theme", display->GetTheme().c_str());
     }
+    if (display && display->render_stats().enabled()) {
+        cJSON_AddItemToObject(screen, "render_stats", display->render_stats().ToJson());
+    }
     cJSON_AddItemToObject(root, "screen", screen);
 
     // Battery
@@ -186,6 +189,14 @@ std::string Ml307Board::GetDeviceStatusJson() {
     }
     cJSON_AddItemToObject(root, "network", network);
 
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+    // 音频延迟（仅总延迟，分阶段数据见 self.audio.get_latency）
+    cJSON_AddItemToObject(root, "audio_latency", Application::GetInstance().GetAudioService().latency_tracer().ToJson(false));
+#endif
+
+    // 下行音频：抖动缓冲的抖动、目标延迟、迟到丢弃，以及丢帧与补偿帧计数
+    cJSON_AddItemToObject(root, "audio_downlink", Application::GetInstance().GetAudioService().DownlinkStatisticsJson());
+
     auto json_str = cJSON_PrintUnformatted(root);
     std::string json(json_str);
     cJSON_free(json_str);
@@ -2,6 +2,7 @@
 #define MUSIC_H
 
 #include <string>
+#include <cstdint>
 
 class Music {
 public:
@@ -16,6 +17,8 @@ public:
     virtual size_t GetBufferSize() const = 0;
     virtual bool IsDownloading() const = 0;
     virtual int16_t* GetAudioData() = 0;
+    // 累计的解码超时次数（单帧解码超过帧时长一半或缓冲断流），供显示侧降低负载
+    virtual uint32_t GetDeadlineMisses() const { return 0; }
 };
 
 #endif // MUSIC_H 
\ No newline at end of file
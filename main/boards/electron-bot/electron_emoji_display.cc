@@ -69,6 +69,7 @@ void ElectronEmojiDisplay::SetupGifContainer() {
     }
     if (content_) {
         lv_obj_del(content_);
+        preview_image_ = nullptr;
     }
 
     content_ = lv_obj_create(container_);
@@ -33,24 +33,15 @@ public:
     virtual void SetMusicInfo(const char *song_name) override;
     void ResumeAnimations();
     void PauseAnimations();
-    bool SetPreviewImageFromMemory(const uint8_t *data, size_t len);
-    void ClearPreviewImage();
-    /**
-     * @brief Configure preview image scaling percentages.
-     * @param decoded_width_pct Width percentage of screen for decoded images (1-100)
-     * @param decoded_height_pct Height percentage of screen for decoded images (1-100)
-     * @param fallback_width_pct Width percentage of screen for fallback raw-JPEG square (1-100)
-     */
-    void SetPreviewScaling(int decoded_width_pct, int decoded_height_pct, int fallback_width_pct);
+    virtual void ClearPreviewImage() override;
+
+protected:
+    virtual void ShowCoverArt(lv_image_dsc_t* image) override;
 
 private:
     void SetupGifContainer();
 
     lv_obj_t* emotion_gif_;  ///< GIF表情组件
-    // Owned preview image data and object
-    uint8_t* owned_preview_buf_ = nullptr;
-    size_t owned_preview_len_ = 0;
-    lv_obj_t* preview_img_obj_ = nullptr;
 
     // 表情映射
     struct EmotionMap {
@@ -59,8 +50,4 @@ private:
     };
 
     static const EmotionMap emotion_maps_[];
-    // Preview scaling percentages (defaults: decoded 70% x 50%, fallback 90% width)
-    int preview_decoded_width_pct_ = 70;
-    int preview_decoded_height_pct_ = 50;
-    int preview_fallback_width_pct_ = 90;
 };
\ No newline at end of file
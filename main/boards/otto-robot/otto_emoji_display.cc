@@ -70,6 +70,7 @@ void OttoEmojiDisplay::SetupGifContainer() {
     }
     if (content_) {
         lv_obj_del(content_);
+        preview_image_ = nullptr;
     }
 
     content_ = lv_obj_create(container_);
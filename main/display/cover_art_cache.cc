@@ -0,0 +1,330 @@
+#include "cover_art_cache.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+#include <vector>
+
+#if CONFIG_COVER_ART_CACHE_FLASH_SPILL
+#include <esp_partition.h>
+#endif
+
+#define TAG "CoverArtCache"
+
+#define COVER_ART_CACHE_BYTES ((size_t)CONFIG_COVER_ART_CACHE_SIZE_KB * 1024)
+
+#if CONFIG_COVER_ART_CACHE_FLASH_SPILL
+#define COVER_FLASH_PARTITION_LABEL "covers"
+#define COVER_FLASH_MAGIC 0x52564f43  // "COVR"
+#define COVER_FLASH_SECTOR_SIZE 4096
+
+// 以环形日志的方式把淘汰的图像写入 flash 分区：每条记录从扇区边界开始，
+// 先写像素数据再写头部，掉电时未写完头部的记录在启动扫描时会被忽略。
+class CoverArtFlashStore {
+public:
+    struct Record {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t url_hash;
+        uint16_t max_width;
+        uint16_t max_height;
+        uint8_t format;
+        uint8_t cf;
+        uint16_t width;
+        uint16_t height;
+        uint16_t stride;
+        uint32_t data_size;
+    };
+
+    bool Init() {
+        partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY,
+                                              COVER_FLASH_PARTITION_LABEL);
+        if (partition_ == nullptr) {
+            ESP_LOGW(TAG, "Partition \"%s\" not found, flash spill disabled", COVER_FLASH_PARTITION_LABEL);
+            return false;
+        }
+
+        uint32_t newest_sequence = 0;
+        for (size_t offset = 0; offset + sizeof(Record) <= partition_->size;) {
+            Record record;
+            if (esp_partition_read(partition_, offset, &record, sizeof(record)) != ESP_OK) {
+                break;
+            }
+            size_t length = RecordLength(record.data_size);
+            if (record.magic != COVER_FLASH_MAGIC || offset + length > partition_->size) {
+                offset += COVER_FLASH_SECTOR_SIZE;
+                continue;
+            }
+            index_.push_back({record, offset});
+            if (record.sequence >= newest_sequence) {
+                newest_sequence = record.sequence;
+                head_ = offset + length;
+                next_sequence_ = record.sequence + 1;
+            }
+            offset += length;
+        }
+        ESP_LOGI(TAG, "Flash store: %u records in %u KB", (unsigned)index_.size(),
+                 (unsigned)(partition_->size / 1024));
+        return true;
+    }
+
+    const Record* Find(uint32_t url_hash, uint16_t max_width, uint16_t max_height, uint8_t format, size_t* offset) {
+        const IndexEntry* found = nullptr;
+        for (auto& entry : index_) {
+            auto& r = entry.record;
+            if (r.url_hash == url_hash && r.max_width == max_width && r.max_height == max_height &&
+                r.format == format && (found == nullptr || r.sequence > found->record.sequence)) {
+                found = &entry;
+            }
+        }
+        if (found == nullptr) {
+            return nullptr;
+        }
+        *offset = found->offset;
+        return &found->record;
+    }
+
+    bool Read(size_t offset, const Record& record, lv_image_dsc_t* image) {
+        return esp_partition_read(partition_, offset + sizeof(Record), (void*)image->data, record.data_size) == ESP_OK;
+    }
+
+    void Write(Record record, const lv_image_dsc_t* image) {
+        size_t length = RecordLength(record.data_size);
+        if (length > partition_->size) {
+            return;
+        }
+        if (head_ + length > partition_->size) {
+            head_ = 0;
+        }
+
+        // 擦除即将覆盖的扇区，并移除落在其中的旧记录
+        size_t start = head_;
+        size_t end = head_ + length;
+        for (auto it = index_.begin(); it != index_.end();) {
+            size_t record_end = it->offset + RecordLength(it->record.data_size);
+            if (it->offset < end && record_end > start) {
+                it = index_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (esp_partition_erase_range(partition_, start, length) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to erase flash at 0x%x", (unsigned)start);
+            return;
+        }
+
+        record.magic = COVER_FLASH_MAGIC;
+        record.sequence = next_sequence_++;
+        if (esp_partition_write(partition_, start + sizeof(Record), image->data, record.data_size) != ESP_OK ||
+            esp_partition_write(partition_, start, &record, sizeof(record)) != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to write cover art to flash");
+            return;
+        }
+        index_.push_back({record, start});
+        head_ = end;
+    }
+
+private:
+    struct IndexEntry {
+        Record record;
+        size_t offset;
+    };
+
+    static size_t RecordLength(uint32_t data_size) {
+        return (sizeof(Record) + data_size + COVER_FLASH_SECTOR_SIZE - 1) & ~(size_t)(COVER_FLASH_SECTOR_SIZE - 1);
+    }
+
+    const esp_partition_t* partition_ = nullptr;
+    std::vector<IndexEntry> index_;
+    size_t head_ = 0;
+    uint32_t next_sequence_ = 1;
+};
+#else
+class CoverArtFlashStore {};
+#endif
+
+CoverArtCache::CoverArtCache() {
+#if CONFIG_COVER_ART_CACHE_FLASH_SPILL
+    flash_store_ = std::make_unique<CoverArtFlashStore>();
+    if (!flash_store_->Init()) {
+        flash_store_.reset();
+    }
+#endif
+}
+
+CoverArtCache::~CoverArtCache() {
+    for (auto& entry : entries_) {
+        CoverArtDecoder::FreeImage(entry.image);
+    }
+}
+
+CoverArtCache::Key CoverArtCache::MakeKey(const std::string& url, int max_width, int max_height,
+                                          CoverArtDecoder::PixelFormat format) {
+    // FNV-1a
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : url) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return Key{hash, (uint16_t)max_width, (uint16_t)max_height, (uint8_t)format};
+}
+
+lv_image_dsc_t* CoverArtCache::Lookup(const std::string& url, int max_width, int max_height,
+                                      CoverArtDecoder::PixelFormat format) {
+    Key key = MakeKey(url, max_width, max_height, format);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+            if (it->key == key) {
+                entries_.splice(entries_.begin(), entries_, it);
+                ESP_LOGI(TAG, "Hit %08lx (%dx%d)", (unsigned long)key.url_hash,
+                         (int)it->image->header.w, (int)it->image->header.h);
+                return CoverArtDecoder::RetainImage(it->image);
+            }
+        }
+    }
+
+#if CONFIG_COVER_ART_CACHE_FLASH_SPILL
+    if (flash_store_) {
+        CoverArtFlashStore::Record record;
+        size_t offset = 0;
+        {
+            std::lock_guard<std::mutex> lock(flash_mutex_);
+            auto found = flash_store_->Find(key.url_hash, key.max_width, key.max_height, key.format, &offset);
+            if (found == nullptr) {
+                return nullptr;
+            }
+            record = *found;
+        }
+        // 分配时可能触发 Evict，因此不能持有锁
+        auto image = CoverArtDecoder::CreateImage(record.width, record.height, (lv_color_format_t)record.cf,
+                                                  record.stride, record.data_size);
+        if (image == nullptr) {
+            return nullptr;
+        }
+        {
+            std::lock_guard<std::mutex> lock(flash_mutex_);
+            // 解锁期间记录可能已被新的写入覆盖
+            size_t current_offset = 0;
+            auto current = flash_store_->Find(key.url_hash, key.max_width, key.max_height, key.format, &current_offset);
+            if (current == nullptr || current->sequence != record.sequence ||
+                !flash_store_->Read(offset, record, image)) {
+                CoverArtDecoder::FreeImage(image);
+                return nullptr;
+            }
+        }
+        ESP_LOGI(TAG, "Flash hit %08lx (%dx%d)", (unsigned long)key.url_hash, record.width, record.height);
+        std::lock_guard<std::mutex> lock(mutex_);
+        InsertLocked(key, CoverArtDecoder::RetainImage(image), true);
+        return image;
+    }
+#endif
+    return nullptr;
+}
+
+void CoverArtCache::Insert(const std::string& url, int max_width, int max_height,
+                           CoverArtDecoder::PixelFormat format, lv_image_dsc_t* image) {
+    if (image == nullptr || COVER_ART_CACHE_BYTES == 0) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    InsertLocked(MakeKey(url, max_width, max_height, format), CoverArtDecoder::RetainImage(image), false);
+}
+
+// 接管 image 的一份引用
+void CoverArtCache::InsertLocked(const Key& key, lv_image_dsc_t* image, bool in_flash) {
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->key == key) {
+            bytes_ -= CoverArtDecoder::ImageSize(it->image);
+            CoverArtDecoder::FreeImage(it->image);
+            entries_.erase(it);
+            break;
+        }
+    }
+    size_t size = CoverArtDecoder::ImageSize(image);
+    if (size > COVER_ART_CACHE_BYTES) {
+        CoverArtDecoder::FreeImage(image);
+        return;
+    }
+    entries_.push_front({key, image, in_flash});
+    bytes_ += size;
+    while (bytes_ > COVER_ART_CACHE_BYTES) {
+        EvictBackLocked();
+    }
+}
+
+// 淘汰最久未使用的一项，返回其占用的字节数
+size_t CoverArtCache::EvictBackLocked() {
+    Entry entry = entries_.back();
+    entries_.pop_back();
+    size_t size = CoverArtDecoder::ImageSize(entry.image);
+    bytes_ -= size;
+    CoverArtDecoder::FreeImage(entry.image);
+    return size;
+}
+
+void CoverArtCache::Evict(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t freed = 0;
+    while (freed < bytes && !entries_.empty()) {
+        freed += EvictBackLocked();
+    }
+}
+
+// 取出一项尚未写入 flash 的图像（增加一份引用），没有则返回 false
+bool CoverArtCache::NextSpillLocked(Key* key, lv_image_dsc_t** image) {
+    for (auto& entry : entries_) {
+        if (!entry.in_flash) {
+            *key = entry.key;
+            *image = CoverArtDecoder::RetainImage(entry.image);
+            return true;
+        }
+    }
+    return false;
+}
+
+void CoverArtCache::SpillToFlash() {
+#if CONFIG_COVER_ART_CACHE_FLASH_SPILL
+    if (!flash_store_) {
+        return;
+    }
+    while (true) {
+        Key key;
+        lv_image_dsc_t* image = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!NextSpillLocked(&key, &image)) {
+                return;
+            }
+        }
+
+        // 只持有 flash_mutex_ 擦写，期间内存命中和淘汰照常进行；写入期间图像由这份引用保持
+        {
+            std::lock_guard<std::mutex> lock(flash_mutex_);
+            size_t offset = 0;
+            if (flash_store_->Find(key.url_hash, key.max_width, key.max_height, key.format, &offset) == nullptr) {
+                CoverArtFlashStore::Record record = {};
+                record.url_hash = key.url_hash;
+                record.max_width = key.max_width;
+                record.max_height = key.max_height;
+                record.format = key.format;
+                record.cf = image->header.cf;
+                record.width = image->header.w;
+                record.height = image->header.h;
+                record.stride = image->header.stride;
+                record.data_size = image->data_size;
+                flash_store_->Write(record, image);
+            }
+        }
+
+        // 写入失败也标记，避免反复重试同一张图
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : entries_) {
+            if (entry.key == key && entry.image == image) {
+                entry.in_flash = true;
+                break;
+            }
+        }
+        CoverArtDecoder::FreeImage(image);
+    }
+#endif
+}
@@ -0,0 +1,72 @@
+#ifndef COVER_ART_CACHE_H
+#define COVER_ART_CACHE_H
+
+#include "cover_art_decoder.h"
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class CoverArtFlashStore;
+
+// 已解码封面图的 LRU 缓存，键为封面 URL 哈希 + 目标尺寸 + 像素格式。
+// 缓存与显示共享同一张图像（引用计数），占用计入 CONFIG_COVER_ART_CACHE_SIZE_KB；
+// 启用 CONFIG_COVER_ART_CACHE_FLASH_SPILL 时，新缓存的图像由解码任务在锁外写入 "covers" 分区，
+// 被淘汰后仍可从 flash 取回；淘汰本身只释放内存，不会在分配预算的路径上擦写 flash。
+class CoverArtCache {
+public:
+    static CoverArtCache& GetInstance() {
+        static CoverArtCache instance;
+        return instance;
+    }
+
+    CoverArtCache(const CoverArtCache&) = delete;
+    CoverArtCache& operator=(const CoverArtCache&) = delete;
+
+    // 命中时返回一份新的引用，调用方负责通过 SwapImage/FreeImage 释放
+    lv_image_dsc_t* Lookup(const std::string& url, int max_width, int max_height, CoverArtDecoder::PixelFormat format);
+    // 缓存增加一份对 image 的引用，调用方仍持有自己的引用
+    void Insert(const std::string& url, int max_width, int max_height, CoverArtDecoder::PixelFormat format,
+                lv_image_dsc_t* image);
+    // PSRAM 预算不足时调用，按 LRU 顺序淘汰，直到释放至少 bytes 字节或缓存为空
+    void Evict(size_t bytes);
+    // 把尚未写入 flash 的缓存图像写入 flash，只在低优先级的解码任务中调用
+    void SpillToFlash();
+
+private:
+    CoverArtCache();
+    ~CoverArtCache();
+
+    struct Key {
+        uint32_t url_hash;
+        uint16_t max_width;
+        uint16_t max_height;
+        uint8_t format;
+
+        bool operator==(const Key& other) const {
+            return url_hash == other.url_hash && max_width == other.max_width &&
+                   max_height == other.max_height && format == other.format;
+        }
+    };
+
+    struct Entry {
+        Key key;
+        lv_image_dsc_t* image;
+        bool in_flash;
+    };
+
+    static Key MakeKey(const std::string& url, int max_width, int max_height, CoverArtDecoder::PixelFormat format);
+    void InsertLocked(const Key& key, lv_image_dsc_t* image, bool in_flash);
+    size_t EvictBackLocked();
+    bool NextSpillLocked(Key* key, lv_image_dsc_t** image);
+
+    std::mutex mutex_;
+    std::list<Entry> entries_;  // 最近使用的在前
+    size_t bytes_ = 0;
+    // 保护 flash_store_，擦写期间只阻塞 flash 查找，不阻塞内存命中
+    std::mutex flash_mutex_;
+    std::unique_ptr<CoverArtFlashStore> flash_store_;
+};
+
+#endif // COVER_ART_CACHE_H
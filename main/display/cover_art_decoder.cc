@@ -0,0 +1,663 @@
+#include "cover_art_decoder.h"
+#include "cover_art_cache.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_jpeg_dec.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#if CONFIG_LV_USE_LODEPNG
+#include <libs/lodepng/lodepng.h>
+#endif
+
+#define TAG "CoverArtDecoder"
+
+#define COVER_ART_TASK_STACK_SIZE (8 * 1024)
+#define COVER_ART_BUDGET_BYTES    ((size_t)CONFIG_COVER_ART_PSRAM_BUDGET_KB * 1024)
+
+// 管线内所有 PSRAM 分配（编码数据、解码中间结果、显示中的图像）共用一个预算
+static std::atomic<size_t> budget_used_bytes{0};
+
+static bool TryReserveBudget(size_t size) {
+    size_t used = budget_used_bytes.fetch_add(size) + size;
+    if (used > COVER_ART_BUDGET_BYTES) {
+        budget_used_bytes.fetch_sub(size);
+        return false;
+    }
+    return true;
+}
+
+static bool ReserveBudget(size_t size) {
+    if (TryReserveBudget(size)) {
+        return true;
+    }
+    // 预算不足时先淘汰缓存中的图像再重试
+    CoverArtCache::GetInstance().Evict(size);
+    if (TryReserveBudget(size)) {
+        return true;
+    }
+    ESP_LOGW(TAG, "PSRAM budget exceeded: need %u, used %u of %u bytes",
+             (unsigned)size, (unsigned)budget_used_bytes.load(), (unsigned)COVER_ART_BUDGET_BYTES);
+    return false;
+}
+
+static void ReleaseBudget(size_t size) {
+    budget_used_bytes.fetch_sub(size);
+}
+
+static void* BudgetAlloc(size_t size) {
+    if (!ReserveBudget(size)) {
+        return nullptr;
+    }
+    void* ptr = heap_caps_aligned_alloc(16, size, MALLOC_CAP_SPIRAM);
+    if (ptr == nullptr) {
+        ESP_LOGW(TAG, "Failed to allocate %u bytes in PSRAM", (unsigned)size);
+        ReleaseBudget(size);
+    }
+    return ptr;
+}
+
+static void BudgetFree(void* ptr, size_t size) {
+    if (ptr != nullptr) {
+        heap_caps_free(ptr);
+        ReleaseBudget(size);
+    }
+}
+
+// 描述符、引用计数和像素数据放在同一块内存中，释放时只需要一次 free
+struct CoverImageBlock {
+    lv_image_dsc_t dsc;
+    std::atomic<int> refs;
+};
+#define COVER_IMAGE_HEADER_SIZE ((sizeof(CoverImageBlock) + 15) & ~(size_t)15)
+
+lv_image_dsc_t* CoverArtDecoder::CreateImage(int width, int height, lv_color_format_t cf, uint32_t stride, uint32_t data_size) {
+    void* ptr = BudgetAlloc(COVER_IMAGE_HEADER_SIZE + data_size);
+    if (ptr == nullptr) {
+        return nullptr;
+    }
+    auto block = new (ptr) CoverImageBlock();
+    block->refs = 1;
+    lv_image_dsc_t* image = &block->dsc;
+    memset(image, 0, sizeof(lv_image_dsc_t));
+    image->header.magic = LV_IMAGE_HEADER_MAGIC;
+    image->header.cf = cf;
+    image->header.w = width;
+    image->header.h = height;
+    image->header.stride = stride;
+    image->data_size = data_size;
+    image->data = (const uint8_t*)image + COVER_IMAGE_HEADER_SIZE;
+    return image;
+}
+
+// 等比缩放到框内，不放大
+static void FitSize(int src_w, int src_h, int max_w, int max_h, int* dst_w, int* dst_h) {
+    *dst_w = src_w;
+    *dst_h = src_h;
+    if (src_w <= max_w && src_h <= max_h) {
+        return;
+    }
+    if ((int64_t)max_w * src_h <= (int64_t)max_h * src_w) {
+        *dst_w = max_w;
+        *dst_h = std::max(1, (int)((int64_t)src_h * max_w / src_w));
+    } else {
+        *dst_h = max_h;
+        *dst_w = std::max(1, (int)((int64_t)src_w * max_h / src_h));
+    }
+}
+
+// 选择 esp_new_jpeg 的块缩放因子（1/2、1/4、1/8），使解码结果尽量接近目标框但不小于目标框，
+// 这样最终只需一次缩小即可得到精确尺寸。解码器要求缩放后的宽高为 8 的整数倍。
+static int ChooseJpegScaleDivisor(int src_w, int src_h, int dst_w, int dst_h) {
+    for (int d = 8; d > 1; d >>= 1) {
+        if (src_w % d != 0 || src_h % d != 0) {
+            continue;
+        }
+        int w = src_w / d;
+        int h = src_h / d;
+        if (w >= dst_w && h >= dst_h && w % 8 == 0 && h % 8 == 0) {
+            return d;
+        }
+    }
+    return 1;
+}
+
+// 区域平均（box filter）缩小 RGB565，只在解码时执行一次，替代 LVGL 每帧的软件缩放。
+// 源图像按块（JPEG 的 MCU 行）逐步输入，累加结果直接写入目标缓冲区，不需要整幅的中间图像。
+class Rgb565RowScaler {
+public:
+    Rgb565RowScaler(int src_w, int src_h, uint16_t* dst, int dst_w, int dst_h)
+        : src_w_(src_w), src_h_(src_h), dst_(dst), dst_w_(dst_w), dst_h_(dst_h) {
+        if (src_w_ == dst_w_ && src_h_ == dst_h_) {
+            return;
+        }
+        // 目标尺寸不大于源尺寸，每个目标像素对应一段连续的源行/列
+        column_map_.resize(src_w_);
+        column_count_.resize(dst_w_);
+        for (int dx = 0; dx < dst_w_; dx++) {
+            int sx0 = (int)((int64_t)dx * src_w_ / dst_w_);
+            int sx1 = (int)((int64_t)(dx + 1) * src_w_ / dst_w_);
+            for (int sx = sx0; sx < sx1; sx++) {
+                column_map_[sx] = dx;
+            }
+            column_count_[dx] = sx1 - sx0;
+        }
+        sums_.assign(dst_w_ * 3, 0);
+        next_boundary_ = (int)((int64_t)src_h_ / dst_h_);
+    }
+
+    void PushRows(const uint16_t* rows, int count) {
+        if (column_map_.empty()) {
+            count = std::min(count, src_h_ - src_y_);
+            memcpy(dst_ + (size_t)src_y_ * dst_w_, rows, (size_t)count * src_w_ * 2);
+            src_y_ += count;
+            return;
+        }
+        for (int i = 0; i < count && src_y_ < src_h_; i++) {
+            const uint16_t* row = rows + (size_t)i * src_w_;
+            for (int sx = 0; sx < src_w_; sx++) {
+                uint16_t p = row[sx];
+                uint32_t* sum = &sums_[column_map_[sx] * 3];
+                sum[0] += p >> 11;
+                sum[1] += (p >> 5) & 0x3F;
+                sum[2] += p & 0x1F;
+            }
+            src_y_++;
+            rows_accumulated_++;
+            if (src_y_ == next_boundary_) {
+                EmitRow();
+            }
+        }
+    }
+
+private:
+    void EmitRow() {
+        uint16_t* out = dst_ + (size_t)dst_y_ * dst_w_;
+        for (int dx = 0; dx < dst_w_; dx++) {
+            uint32_t n = column_count_[dx] * rows_accumulated_;
+            uint32_t* sum = &sums_[dx * 3];
+            out[dx] = (uint16_t)(((sum[0] / n) << 11) | ((sum[1] / n) << 5) | (sum[2] / n));
+        }
+        std::fill(sums_.begin(), sums_.end(), 0);
+        rows_accumulated_ = 0;
+        dst_y_++;
+        next_boundary_ = (int)((int64_t)(dst_y_ + 1) * src_h_ / dst_h_);
+    }
+
+    int src_w_;
+    int src_h_;
+    uint16_t* dst_;
+    int dst_w_;
+    int dst_h_;
+    int src_y_ = 0;
+    int dst_y_ = 0;
+    int next_boundary_ = 0;
+    uint32_t rows_accumulated_ = 0;
+    std::vector<uint16_t> column_map_;
+    std::vector<uint16_t> column_count_;
+    std::vector<uint32_t> sums_;
+};
+
+// 解码输出：RGB565 直接写入最终图像；单色先缩放到一个目标尺寸的 RGB565 缓冲区，再抖动写入最终图像
+struct DecodeTarget {
+    lv_image_dsc_t* image = nullptr;
+    uint16_t* pixels = nullptr;
+    size_t scratch_size = 0;
+};
+
+// Floyd-Steinberg 抖动到 1bpp，bit 为 1 表示亮像素（调色板索引 1）
+static void DitherToMono(const uint16_t* src, int width, int height, uint8_t* dst, int stride) {
+    std::vector<int16_t> errors(2 * (width + 2), 0);
+    int16_t* cur = errors.data();
+    int16_t* next = errors.data() + width + 2;
+    memset(dst, 0, (size_t)stride * height);
+
+    for (int y = 0; y < height; y++) {
+        const uint16_t* row = src + y * width;
+        uint8_t* out = dst + y * stride;
+        for (int x = 0; x < width; x++) {
+            uint16_t p = row[x];
+            int r = (p >> 11) << 3;
+            int g = ((p >> 5) & 0x3F) << 2;
+            int b = (p & 0x1F) << 3;
+            int value = ((r * 77 + g * 150 + b * 29) >> 8) + cur[x + 1];
+            int error = value;
+            if (value >= 128) {
+                out[x >> 3] |= 0x80 >> (x & 7);
+                error = value - 255;
+            }
+            cur[x + 2] += error * 7 / 16;
+            next[x] += error * 3 / 16;
+            next[x + 1] += error * 5 / 16;
+            next[x + 2] += error / 16;
+        }
+        std::swap(cur, next);
+        std::fill(next, next + width + 2, 0);
+    }
+}
+
+static bool AllocTarget(int width, int height, CoverArtDecoder::PixelFormat format, DecodeTarget* target) {
+    if (format == CoverArtDecoder::PixelFormat::kRgb565) {
+        target->image = CoverArtDecoder::CreateImage(width, height, LV_COLOR_FORMAT_RGB565, width * 2, (uint32_t)width * height * 2);
+        target->pixels = target->image != nullptr ? (uint16_t*)target->image->data : nullptr;
+        return target->image != nullptr;
+    }
+
+    uint32_t stride = (width + 7) / 8;
+    // I1 格式的数据以 2 色调色板开头
+    uint32_t palette_size = 2 * sizeof(lv_color32_t);
+    target->image = CoverArtDecoder::CreateImage(width, height, LV_COLOR_FORMAT_I1, stride, palette_size + stride * height);
+    if (target->image == nullptr) {
+        return false;
+    }
+    target->scratch_size = (size_t)width * height * 2;
+    target->pixels = (uint16_t*)BudgetAlloc(target->scratch_size);
+    if (target->pixels == nullptr) {
+        CoverArtDecoder::FreeImage(target->image);
+        target->image = nullptr;
+        return false;
+    }
+    return true;
+}
+
+// 成功时返回最终图像；失败时释放所有缓冲区并返回 nullptr
+static lv_image_dsc_t* FinishTarget(DecodeTarget* target, bool ok) {
+    lv_image_dsc_t* image = target->image;
+    if (target->scratch_size > 0) {
+        if (ok) {
+            uint32_t palette_size = 2 * sizeof(lv_color32_t);
+            lv_color32_t* palette = (lv_color32_t*)image->data;
+            palette[0] = lv_color32_make(0x00, 0x00, 0x00, 0xFF);
+            palette[1] = lv_color32_make(0xFF, 0xFF, 0xFF, 0xFF);
+            DitherToMono(target->pixels, image->header.w, image->header.h,
+                         (uint8_t*)image->data + palette_size, image->header.stride);
+        }
+        BudgetFree(target->pixels, target->scratch_size);
+    }
+    if (!ok) {
+        CoverArtDecoder::FreeImage(image);
+        return nullptr;
+    }
+    return image;
+}
+
+// 解码 JPEG：先按块缩放使解码尺寸不小于目标框，再以 MCU 行为单位输出并流式缩小到最终图像。
+// 整个过程只有最终图像一个整幅像素缓冲区，另外只需要一个 MCU 行高的条带缓冲区。
+static lv_image_dsc_t* DecodeJpeg(const uint8_t* data, size_t len, int max_w, int max_h,
+                                  CoverArtDecoder::PixelFormat format) {
+    jpeg_dec_handle_t jpeg_dec = NULL;
+    jpeg_dec_config_t config = DEFAULT_JPEG_DEC_CONFIG();
+    config.output_type = JPEG_PIXEL_FORMAT_RGB565_LE;
+    config.rotate = JPEG_ROTATE_0D;
+
+    // 先解析一次头部获取原始尺寸，用于选择缩放因子
+    jpeg_dec_io_t jpeg_io = {};
+    jpeg_dec_header_info_t header = {};
+    if (jpeg_dec_open(&config, &jpeg_dec) != JPEG_ERR_OK || jpeg_dec == NULL) {
+        return nullptr;
+    }
+    jpeg_io.inbuf = (uint8_t*)data;
+    jpeg_io.inbuf_len = (int)len;
+    jpeg_error_t ret = jpeg_dec_parse_header(jpeg_dec, &jpeg_io, &header);
+    jpeg_dec_close(jpeg_dec);
+    jpeg_dec = NULL;
+    if (ret < 0 || header.width == 0 || header.height == 0) {
+        ESP_LOGW(TAG, "jpeg_dec_parse_header failed: %d", ret);
+        return nullptr;
+    }
+
+    int src_w = header.width;
+    int src_h = header.height;
+    int dst_w = 0, dst_h = 0;
+    FitSize(src_w, src_h, max_w, max_h, &dst_w, &dst_h);
+
+    int divisor = ChooseJpegScaleDivisor(src_w, src_h, dst_w, dst_h);
+    int dec_w = src_w / divisor;
+    int dec_h = src_h / divisor;
+    if (divisor > 1) {
+        config.scale.width = dec_w;
+        config.scale.height = dec_h;
+    }
+    config.block_enable = true;
+
+    DecodeTarget target;
+    if (!AllocTarget(dst_w, dst_h, format, &target)) {
+        return nullptr;
+    }
+
+    if (jpeg_dec_open(&config, &jpeg_dec) != JPEG_ERR_OK || jpeg_dec == NULL) {
+        return FinishTarget(&target, false);
+    }
+
+    uint8_t* block_buf = nullptr;
+    int block_len = 0;
+    int block_count = 0;
+    jpeg_io = {};
+    header = {};
+    jpeg_io.inbuf = (uint8_t*)data;
+    jpeg_io.inbuf_len = (int)len;
+    ret = jpeg_dec_parse_header(jpeg_dec, &jpeg_io, &header);
+    if (ret >= 0) {
+        ret = jpeg_dec_get_outbuf_len(jpeg_dec, &block_len);
+    }
+    if (ret >= 0) {
+        ret = jpeg_dec_get_process_count(jpeg_dec, &block_count);
+    }
+    if (ret >= 0 && (block_len <= 0 || block_count <= 0 || block_len % (dec_w * 2) != 0)) {
+        ret = JPEG_ERR_FAIL;
+    }
+    if (ret >= 0) {
+        block_buf = (uint8_t*)BudgetAlloc(block_len);
+        if (block_buf == nullptr) {
+            ret = JPEG_ERR_NO_MEM;
+        }
+    }
+
+    if (ret >= 0) {
+        int block_rows = block_len / (dec_w * 2);
+        Rgb565RowScaler scaler(dec_w, dec_h, target.pixels, dst_w, dst_h);
+        int consumed = jpeg_io.inbuf_len - jpeg_io.inbuf_remain;
+        jpeg_io.inbuf = (uint8_t*)data + consumed;
+        jpeg_io.inbuf_len = jpeg_io.inbuf_remain;
+        jpeg_io.outbuf = block_buf;
+        for (int i = 0; i < block_count; i++) {
+            ret = jpeg_dec_process(jpeg_dec, &jpeg_io);
+            if (ret != JPEG_ERR_OK) {
+                break;
+            }
+            scaler.PushRows((const uint16_t*)block_buf, block_rows);
+        }
+    }
+    jpeg_dec_close(jpeg_dec);
+    BudgetFree(block_buf, block_len);
+
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGW(TAG, "JPEG block decode failed: %d", ret);
+        return FinishTarget(&target, false);
+    }
+
+    ESP_LOGI(TAG, "Decoded JPEG %dx%d at 1/%d -> %dx%d in %d blocks of %d bytes",
+             src_w, src_h, divisor, dst_w, dst_h, block_count, block_len);
+    return FinishTarget(&target, true);
+}
+
+#if CONFIG_LV_USE_LODEPNG
+// lodepng 使用 LVGL 的内存分配器，这里只做预算占位；RGBA8888 原地转换为 RGB565 后再缩小
+static lv_image_dsc_t* DecodePng(const uint8_t* data, size_t len, int max_w, int max_h,
+                                 CoverArtDecoder::PixelFormat format) {
+    if (len < 24) {
+        return nullptr;
+    }
+    // IHDR 紧跟在 8 字节签名之后，宽高为大端 32 位
+    uint32_t w = ((uint32_t)data[16] << 24) | ((uint32_t)data[17] << 16) | ((uint32_t)data[18] << 8) | data[19];
+    uint32_t h = ((uint32_t)data[20] << 24) | ((uint32_t)data[21] << 16) | ((uint32_t)data[22] << 8) | data[23];
+    if (w == 0 || h == 0 || w > 4096 || h > 4096) {
+        ESP_LOGW(TAG, "Unsupported PNG size %ux%u", (unsigned)w, (unsigned)h);
+        return nullptr;
+    }
+    size_t rgba_len = (size_t)w * h * 4;
+    if (!ReserveBudget(rgba_len)) {
+        return nullptr;
+    }
+
+    unsigned char* rgba = nullptr;
+    unsigned out_w = 0, out_h = 0;
+    unsigned error = lodepng_decode32(&rgba, &out_w, &out_h, data, len);
+    if (error != 0 || rgba == nullptr) {
+        ESP_LOGW(TAG, "lodepng_decode32 failed: %u", error);
+        if (rgba != nullptr) {
+            lv_free(rgba);
+        }
+        ReleaseBudget(rgba_len);
+        return nullptr;
+    }
+
+    uint16_t* pixels = (uint16_t*)rgba;
+    for (size_t i = 0; i < (size_t)out_w * out_h; i++) {
+        const unsigned char* p = rgba + i * 4;
+        pixels[i] = (uint16_t)(((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3));
+    }
+
+    int dst_w = 0, dst_h = 0;
+    FitSize((int)out_w, (int)out_h, max_w, max_h, &dst_w, &dst_h);
+    DecodeTarget target;
+    lv_image_dsc_t* image = nullptr;
+    if (AllocTarget(dst_w, dst_h, format, &target)) {
+        Rgb565RowScaler scaler((int)out_w, (int)out_h, target.pixels, dst_w, dst_h);
+        scaler.PushRows(pixels, (int)out_h);
+        image = FinishTarget(&target, true);
+    }
+    lv_free(rgba);
+    ReleaseBudget(rgba_len);
+    return image;
+}
+#endif
+
+CoverImageFormat CoverArtDecoder::SniffFormat(const uint8_t* data, size_t len) {
+    static const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+    if (data == nullptr) {
+        return CoverImageFormat::kUnknown;
+    }
+    if (len >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) {
+        return CoverImageFormat::kJpeg;
+    }
+    if (len >= sizeof(kPngSignature) && memcmp(data, kPngSignature, sizeof(kPngSignature)) == 0) {
+        return CoverImageFormat::kPng;
+    }
+    return CoverImageFormat::kUnknown;
+}
+
+lv_image_dsc_t* CoverArtDecoder::Decode(const uint8_t* data, size_t len, int max_width, int max_height,
+                                        PixelFormat format) {
+    if (data == nullptr || len == 0 || max_width <= 0 || max_height <= 0) {
+        return nullptr;
+    }
+
+    switch (SniffFormat(data, len)) {
+        case CoverImageFormat::kJpeg:
+            return DecodeJpeg(data, len, max_width, max_height, format);
+        case CoverImageFormat::kPng:
+#if CONFIG_LV_USE_LODEPNG
+            return DecodePng(data, len, max_width, max_height, format);
+#else
+            ESP_LOGW(TAG, "PNG cover art requires CONFIG_LV_USE_LODEPNG");
+            return nullptr;
+#endif
+        default:
+            ESP_LOGW(TAG, "Unknown cover art format");
+            return nullptr;
+    }
+}
+
+uint8_t* CoverArtDecoder::AllocEncodedBuffer(size_t size) {
+    return (uint8_t*)BudgetAlloc(size);
+}
+
+uint8_t* CoverArtDecoder::ResizeEncodedBuffer(uint8_t* buffer, size_t old_size, size_t new_size) {
+    if (new_size > old_size && !ReserveBudget(new_size - old_size)) {
+        return nullptr;
+    }
+    uint8_t* resized = (uint8_t*)heap_caps_realloc(buffer, new_size, MALLOC_CAP_SPIRAM);
+    if (resized == nullptr) {
+        if (new_size > old_size) {
+            ReleaseBudget(new_size - old_size);
+        }
+        return nullptr;
+    }
+    if (new_size < old_size) {
+        ReleaseBudget(old_size - new_size);
+    }
+    return resized;
+}
+
+void CoverArtDecoder::FreeEncodedBuffer(uint8_t* buffer, size_t size) {
+    BudgetFree(buffer, size);
+}
+
+lv_image_dsc_t* CoverArtDecoder::RetainImage(lv_image_dsc_t* image) {
+    if (image != nullptr) {
+        ((CoverImageBlock*)image)->refs.fetch_add(1);
+    }
+    return image;
+}
+
+void CoverArtDecoder::FreeImage(lv_image_dsc_t* image) {
+    if (image != nullptr && ((CoverImageBlock*)image)->refs.fetch_sub(1) == 1) {
+        BudgetFree(image, ImageSize(image));
+    }
+}
+
+size_t CoverArtDecoder::ImageSize(const lv_image_dsc_t* image) {
+    return COVER_IMAGE_HEADER_SIZE + image->data_size;
+}
+
+void CoverArtDecoder::SwapImage(lv_obj_t* obj, lv_image_dsc_t*& current, lv_image_dsc_t* image) {
+    if (obj != nullptr) {
+        lv_image_set_src(obj, image);
+    }
+    if (current != nullptr) {
+        // 索引色图像会被 LVGL 解码后缓存，释放前需要先丢弃缓存项
+        lv_image_cache_drop(current);
+        FreeImage(current);
+    }
+    current = image;
+}
+
+void CoverArtDecoder::ReleaseRequest(Request& request) {
+    BudgetFree(request.data, request.len);
+    request.data = nullptr;
+    request.len = 0;
+}
+
+bool CoverArtDecoder::Submit(const uint8_t* data, size_t len, int max_width, int max_height,
+                             PixelFormat format, Callback callback) {
+    if (SniffFormat(data, len) == CoverImageFormat::kUnknown) {
+        ESP_LOGW(TAG, "Rejecting cover art: unknown format (%u bytes)", (unsigned)len);
+        return false;
+    }
+
+    // 先丢弃尚未处理的旧请求，把预算让给新图片
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (has_pending_) {
+            ReleaseRequest(pending_);
+            pending_ = Request();
+            has_pending_ = false;
+        }
+    }
+
+    uint8_t* copy = AllocEncodedBuffer(len);
+    if (copy == nullptr) {
+        return false;
+    }
+    memcpy(copy, data, len);
+    return SubmitOwned(copy, len, max_width, max_height, format, std::string(), std::move(callback));
+}
+
+bool CoverArtDecoder::SubmitOwned(uint8_t* data, size_t len, int max_width, int max_height,
+                                  PixelFormat format, const std::string& cache_key, Callback callback) {
+    if (SniffFormat(data, len) == CoverImageFormat::kUnknown) {
+        ESP_LOGW(TAG, "Rejecting cover art: unknown format (%u bytes)", (unsigned)len);
+        FreeEncodedBuffer(data, len);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (task_handle_ == nullptr) {
+        if (task_stack_ == nullptr) {
+#if CONFIG_COVER_ART_CACHE_FLASH_SPILL
+            // 写 flash 时 cache 被关闭，任务栈不能放在 PSRAM
+            task_stack_ = (StackType_t*)heap_caps_malloc(COVER_ART_TASK_STACK_SIZE, MALLOC_CAP_INTERNAL);
+#else
+            task_stack_ = (StackType_t*)heap_caps_malloc(COVER_ART_TASK_STACK_SIZE, MALLOC_CAP_SPIRAM);
+#endif
+        }
+        if (task_buffer_ == nullptr) {
+            task_buffer_ = (StaticTask_t*)heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL);
+        }
+        if (task_stack_ == nullptr || task_buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate cover art task");
+            FreeEncodedBuffer(data, len);
+            return false;
+        }
+        task_handle_ = xTaskCreateStatic([](void* arg) {
+            auto this_ = (CoverArtDecoder*)arg;
+            this_->DecodeTask();
+            vTaskDelete(NULL);
+        }, "cover_art", COVER_ART_TASK_STACK_SIZE, this, 1, task_stack_, task_buffer_);
+    }
+
+    if (has_pending_) {
+        ReleaseRequest(pending_);
+    }
+    pending_.data = data;
+    pending_.len = len;
+    pending_.max_width = max_width;
+    pending_.max_height = max_height;
+    pending_.format = format;
+    pending_.cache_key = cache_key;
+    pending_.callback = std::move(callback);
+    has_pending_ = true;
+    generation_++;
+    xTaskNotifyGive(task_handle_);
+    return true;
+}
+
+void CoverArtDecoder::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (has_pending_) {
+        ReleaseRequest(pending_);
+        pending_ = Request();
+        has_pending_ = false;
+    }
+    generation_++;
+}
+
+void CoverArtDecoder::DecodeTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        Request request;
+        uint32_t generation;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!has_pending_) {
+                continue;
+            }
+            request = std::move(pending_);
+            pending_ = Request();
+            has_pending_ = false;
+            generation = generation_;
+        }
+
+        int64_t start_time = esp_timer_get_time();
+        lv_image_dsc_t* image = Decode(request.data, request.len, request.max_width, request.max_height, request.format);
+        ReleaseRequest(request);
+
+        {
+            // 回调期间持有 mutex_，保证 Cancel() 返回后不会再有旧图片被显示
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (generation != generation_) {
+                ESP_LOGI(TAG, "Dropping stale cover art");
+                FreeImage(image);
+                continue;
+            }
+            ESP_LOGI(TAG, "Cover art decoded in %ld ms, budget used %u bytes",
+                     (long)((esp_timer_get_time() - start_time) / 1000), (unsigned)budget_used_bytes.load());
+            if (image != nullptr && !request.cache_key.empty()) {
+                CoverArtCache::GetInstance().Insert(request.cache_key, request.max_width, request.max_height,
+                                                    request.format, image);
+            }
+            request.callback(image);
+        }
+
+        // 写 flash 放在图片显示之后、所有锁之外，由这个低优先级任务承担
+        CoverArtCache::GetInstance().SpillToFlash();
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef COVER_ART_DECODER_H
+#define COVER_ART_DECODER_H
+
+#include <lvgl.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+
+enum class CoverImageFormat {
+    kUnknown,
+    kJpeg,
+    kPng,
+};
+
+// 封面图解码管线：格式识别、后台任务解码到目标尺寸、在显示锁内替换 LVGL 图像。
+// 所有像素缓冲区都分配在 PSRAM，并受 CONFIG_COVER_ART_PSRAM_BUDGET_KB 限制。
+class CoverArtDecoder {
+public:
+    enum class PixelFormat {
+        kRgb565,    // LCD
+        kMono,      // OLED，Floyd-Steinberg 抖动后的 1bpp 图像
+    };
+
+    // image 为 nullptr 表示解码失败；回调在解码任务中执行并获得 image 的所有权
+    using Callback = std::function<void(lv_image_dsc_t* image)>;
+
+    static CoverArtDecoder& GetInstance() {
+        static CoverArtDecoder instance;
+        return instance;
+    }
+
+    CoverArtDecoder(const CoverArtDecoder&) = delete;
+    CoverArtDecoder& operator=(const CoverArtDecoder&) = delete;
+
+    // 复制编码数据并交给后台任务解码，调用方返回后即可释放 data。
+    // 只保留最新的请求，尚未开始的旧请求会被丢弃。
+    bool Submit(const uint8_t* data, size_t len, int max_width, int max_height,
+                PixelFormat format, Callback callback);
+    // 与 Submit 相同，但直接接管由 AllocEncodedBuffer 分配的 data，省去一次复制（失败时也会释放）。
+    // cache_key 非空时解码结果会放入 CoverArtCache。
+    bool SubmitOwned(uint8_t* data, size_t len, int max_width, int max_height,
+                     PixelFormat format, const std::string& cache_key, Callback callback);
+    // 丢弃排队或正在解码的请求，其结果不会再回调
+    void Cancel();
+
+    // 下载时直接写入的编码数据缓冲区，计入 PSRAM 预算
+    static uint8_t* AllocEncodedBuffer(size_t size);
+    // 扩容或收缩缓冲区；失败时返回 nullptr，原缓冲区保持不变
+    static uint8_t* ResizeEncodedBuffer(uint8_t* buffer, size_t old_size, size_t new_size);
+    static void FreeEncodedBuffer(uint8_t* buffer, size_t size);
+
+    static CoverImageFormat SniffFormat(const uint8_t* data, size_t len);
+    // 同步解码，结果等比缩放到 max_width x max_height 以内（不放大）
+    static lv_image_dsc_t* Decode(const uint8_t* data, size_t len, int max_width, int max_height,
+                                  PixelFormat format);
+    // 图像带引用计数，创建时为 1；FreeImage 减少一次引用，归零时释放内存。
+    // 已显示的图像请使用 SwapImage 释放
+    static lv_image_dsc_t* CreateImage(int width, int height, lv_color_format_t cf, uint32_t stride, uint32_t data_size);
+    static lv_image_dsc_t* RetainImage(lv_image_dsc_t* image);
+    static void FreeImage(lv_image_dsc_t* image);
+    // 图像占用的 PSRAM 字节数（含描述符）
+    static size_t ImageSize(const lv_image_dsc_t* image);
+    // 必须在显示锁内调用：把 image 设置到 obj 上，并释放之前的 current
+    static void SwapImage(lv_obj_t* obj, lv_image_dsc_t*& current, lv_image_dsc_t* image);
+
+private:
+    CoverArtDecoder() = default;
+    ~CoverArtDecoder() = default;
+
+    struct Request {
+        uint8_t* data = nullptr;
+        size_t len = 0;
+        int max_width = 0;
+        int max_height = 0;
+        PixelFormat format = PixelFormat::kRgb565;
+        std::string cache_key;
+        Callback callback;
+    };
+
+    void DecodeTask();
+    void ReleaseRequest(Request& request);
+
+    std::mutex mutex_;
+    Request pending_;
+    bool has_pending_ = false;
+    uint32_t generation_ = 0;
+    TaskHandle_t task_handle_ = nullptr;
+    StaticTask_t* task_buffer_ = nullptr;
+    StackType_t* task_stack_ = nullptr;
+};
+
+#endif // COVER_ART_DECODER_H
@@ -5,6 +5,7 @@
 #include <cstring>
 
 #include "display.h"
+#include "cover_art_decoder.h"
 #include "board.h"
 #include "application.h"
 #include "font_awesome_symbols.h"
@@ -255,6 +256,20 @@ void Display::SetPreviewImage(const lv_img_dsc_t* image) {
     // Do nothing
 }
 
+bool Display::SetPreviewImageFromBuffer(uint8_t* data, size_t len, const std::string& cache_key) {
+    CoverArtDecoder::FreeEncodedBuffer(data, len);
+    return false;
+}
+
+void Display::SetRenderStatsEnabled(bool enabled) {
+    DisplayLockGuard lock(this);
+    render_stats_.SetEnabled(display_, enabled);
+}
+
+void Display::SetLyrics(const char* previous, const char* current, const char* next) {
+    SetChatMessage("lyric", current != nullptr ? current : "");
+}
+
 void Display::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (chat_message_label_ == nullptr) {
@@ -9,6 +9,8 @@
 #include <string>
 #include <chrono>
 
+#include "render_stats.h"
+
 struct DisplayFonts {
     const lv_font_t* text_font = nullptr;
     const lv_font_t* icon_font = nullptr;
@@ -25,6 +27,12 @@ public:
     virtual void ShowNotification(const std::string &notification, int duration_ms = 3000);
     virtual void SetEmotion(const char* emotion);
     virtual void SetChatMessage(const char* role, const char* content);
+    // Show music lyrics: previous/current/next line. current == nullptr hides the lyrics.
+    // Default implementation shows the current line as a chat message.
+    virtual void SetLyrics(const char* previous, const char* current, const char* next);
+    // Karaoke highlight for the current lyric line, counted in UTF-8 characters; -1 disables it.
+    // Default no-op.
+    virtual void SetLyricProgress(int highlighted_chars) {}
     virtual void SetMusicInfo(const char* song_name);
     virtual void SetIcon(const char* icon);
     virtual void SetPreviewImage(const lv_img_dsc_t* image);
@@ -32,6 +40,14 @@ public:
     // Returns true if the display implementation accepted the buffer (may still fail to render
     // if LVGL lacks the decoder). Default implementation returns false.
     virtual bool SetPreviewImageFromMemory(const uint8_t* data, size_t len) { return false; }
+    // Same as SetPreviewImageFromMemory, but takes ownership of a buffer allocated with
+    // CoverArtDecoder::AllocEncodedBuffer so downloaded bytes are not copied again.
+    // The buffer is released even if the display rejects it. A non-empty cache_key (usually the
+    // cover URL) stores the decoded image in CoverArtCache.
+    virtual bool SetPreviewImageFromBuffer(uint8_t* data, size_t len, const std::string& cache_key);
+    // Show a previously decoded image for cache_key without downloading it again.
+    // Returns false on a cache miss. Default implementation returns false.
+    virtual bool SetPreviewImageFromCache(const std::string& cache_key) { return false; }
     // Clear any preview image previously set via SetPreviewImageFromMemory.
     // Default no-op.
     virtual void ClearPreviewImage() {}
@@ -45,6 +61,7 @@ public:
     virtual void start() {}
     virtual void clearScreen() {}  // 清除FFT显示，默认为空实现
     virtual void stopFft() {}      // 停止FFT显示，默认为空实现
+    virtual void NotifyAudioData() {}  // 音乐解码线程写入新的 PCM 帧后调用，用于唤醒频谱任务
     // 动画控制（可用于在音频播放时暂停 GIF/动画以避免卡顿）
     virtual void PauseAnimations() {}
     virtual void ResumeAnimations() {}
@@ -52,6 +69,10 @@ public:
     inline int width() const { return width_; }
     inline int height() const { return height_; }
 
+    // Render/flush/lock-wait instrumentation for tuning draw buffers, off by default.
+    void SetRenderStatsEnabled(bool enabled);
+    RenderStats& render_stats() { return render_stats_; }
+
 protected:
     int width_ = 0;
     int height_ = 0;
@@ -76,6 +97,7 @@ protected:
 
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
+    RenderStats render_stats_;
 
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
@@ -86,9 +108,14 @@ protected:
 class DisplayLockGuard {
 public:
     DisplayLockGuard(Display *display) : display_(display) {
+        bool stats = display_->render_stats_.enabled();
+        int64_t start_us = stats ? esp_timer_get_time() : 0;
         if (!display_->Lock(30000)) {
             ESP_LOGE("Display", "Failed to lock display");
         }
+        if (stats) {
+            display_->render_stats_.RecordLockWait(esp_timer_get_time() - start_us);
+        }
     }
     ~DisplayLockGuard() {
         display_->Unlock();
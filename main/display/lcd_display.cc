@@ -1,4 +1,6 @@
 #include "lcd_display.h"
+#include "cover_art_cache.h"
+#include "visualizer_governor.h"
 
 #include <vector>
 #include <algorithm>
@@ -331,6 +333,7 @@ LcdDisplay::~LcdDisplay() {
     }
     
     // 然后再清理 LVGL 对象
+    lyric_view_.reset();
     if (content_ != nullptr) {
         lv_obj_del(content_);
     }
@@ -343,6 +346,7 @@ LcdDisplay::~LcdDisplay() {
     if (container_ != nullptr) {
         lv_obj_del(container_);
     }
+    CoverArtDecoder::SwapImage(nullptr, cover_image_, nullptr);
     if (display_ != nullptr) {
         lv_display_delete(display_);
     }
@@ -661,6 +665,30 @@ void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     chat_message_label_ = msg_text;
 }
 
+// 每条聊天消息都会创建一个气泡，歌词改用固定的 LyricView，换行时只替换文字
+void LcdDisplay::SetLyrics(const char* previous, const char* current, const char* next) {
+    DisplayLockGuard lock(this);
+    if (container_ == nullptr) {
+        return;
+    }
+    if (lyric_view_ == nullptr) {
+        if (current == nullptr) {
+            return;
+        }
+        lyric_view_ = std::make_unique<LyricView>(container_, fonts_.text_font);
+        lyric_view_->SetColors(current_theme_.chat_background, current_theme_.text,
+                               current_theme_.system_text, current_theme_.user_bubble);
+    }
+    lyric_view_->SetLines(previous, current, next);
+}
+
+void LcdDisplay::SetLyricProgress(int highlighted_chars) {
+    DisplayLockGuard lock(this);
+    if (lyric_view_ != nullptr) {
+        lyric_view_->SetProgress(highlighted_chars);
+    }
+}
+
 void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
@@ -875,9 +903,12 @@ void LcdDisplay::SetPreviewImage(const lv_img_dsc_t* img_dsc) {
     
     if (img_dsc != nullptr) {
         // zoom factor 0.5
+        lv_obj_set_size(preview_image_, width_ * 0.5, height_ * 0.5);
         lv_image_set_scale(preview_image_, 128 * width_ / img_dsc->header.w);
         // 设置图片源并显示预览图片
         lv_image_set_src(preview_image_, img_dsc);
+        // 替换掉之前解码的封面图
+        CoverArtDecoder::SwapImage(nullptr, cover_image_, nullptr);
         lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
         // 隐藏emotion_label_
         if (emotion_label_ != nullptr) {
@@ -983,12 +1014,14 @@ void LcdDisplay::SetMusicInfo(const char* song_name) {
         music_text += song_name;
         lv_label_set_text(chat_message_label_, music_text.c_str());
         
-        // 确保显示 emotion_label_ 和 chat_message_label_，隐藏 preview_image_
-        if (emotion_label_ != nullptr) {
-            lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
-        }
-        if (preview_image_ != nullptr) {
-            lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+        // 确保显示 emotion_label_ 和 chat_message_label_，隐藏 preview_image_（已有封面图时保留封面）
+        if (cover_image_ == nullptr) {
+            if (emotion_label_ != nullptr) {
+                lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+            }
+            if (preview_image_ != nullptr) {
+                lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+            }
         }
     } else {
         // 清空歌名显示
@@ -997,6 +1030,88 @@ void LcdDisplay::SetMusicInfo(const char* song_name) {
 #endif
 }
 
+void LcdDisplay::SetPreviewScaling(int decoded_width_pct, int decoded_height_pct, int fallback_width_pct) {
+    preview_width_pct_ = std::clamp(decoded_width_pct, 1, 100);
+    preview_height_pct_ = std::clamp(decoded_height_pct, 1, 100);
+}
+
+bool LcdDisplay::SetPreviewImageFromMemory(const uint8_t* data, size_t len) {
+    // 解码在 CoverArtDecoder 的后台任务中完成，这里只在替换图像时持有显示锁
+    return CoverArtDecoder::GetInstance().Submit(data, len,
+        width_ * preview_width_pct_ / 100, height_ * preview_height_pct_ / 100,
+        CoverArtDecoder::PixelFormat::kRgb565, [this](lv_image_dsc_t* image) {
+        ShowCoverArt(image);
+    });
+}
+
+bool LcdDisplay::SetPreviewImageFromBuffer(uint8_t* data, size_t len, const std::string& cache_key) {
+    return CoverArtDecoder::GetInstance().SubmitOwned(data, len,
+        width_ * preview_width_pct_ / 100, height_ * preview_height_pct_ / 100,
+        CoverArtDecoder::PixelFormat::kRgb565, cache_key, [this](lv_image_dsc_t* image) {
+        ShowCoverArt(image);
+    });
+}
+
+bool LcdDisplay::SetPreviewImageFromCache(const std::string& cache_key) {
+    auto image = CoverArtCache::GetInstance().Lookup(cache_key,
+        width_ * preview_width_pct_ / 100, height_ * preview_height_pct_ / 100,
+        CoverArtDecoder::PixelFormat::kRgb565);
+    if (image == nullptr) {
+        return false;
+    }
+    // 避免仍在解码的上一首封面覆盖缓存命中的图像
+    CoverArtDecoder::GetInstance().Cancel();
+    ShowCoverArt(image);
+    return true;
+}
+
+void LcdDisplay::ShowCoverArt(lv_image_dsc_t* image) {
+    if (image == nullptr) {
+        return;
+    }
+    DisplayLockGuard lock(this);
+    if (content_ == nullptr) {
+        CoverArtDecoder::FreeImage(image);
+        return;
+    }
+    if (preview_image_ == nullptr) {
+        // 微信风格界面或自定义界面没有预留预览图对象，创建一个浮动在内容区中央的图像
+        preview_image_ = lv_image_create(content_);
+        lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_FLOATING);
+        lv_obj_align(preview_image_, LV_ALIGN_CENTER, 0, 0);
+    }
+    // 图像已解码为目标尺寸，不再需要 LVGL 缩放
+    lv_image_set_scale(preview_image_, LV_SCALE_NONE);
+    lv_obj_set_size(preview_image_, image->header.w, image->header.h);
+    CoverArtDecoder::SwapImage(preview_image_, cover_image_, image);
+    lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_foreground(preview_image_);
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    if (emotion_label_ != nullptr) {
+        lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+#endif
+}
+
+void LcdDisplay::ClearPreviewImage() {
+    // 先取消后台解码，避免清除之后旧封面又被显示出来
+    CoverArtDecoder::GetInstance().Cancel();
+
+    DisplayLockGuard lock(this);
+    if (cover_image_ == nullptr) {
+        return;
+    }
+    CoverArtDecoder::SwapImage(preview_image_, cover_image_, nullptr);
+    if (preview_image_ != nullptr) {
+        lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+    }
+#if !CONFIG_USE_WECHAT_MESSAGE_STYLE
+    if (emotion_label_ != nullptr) {
+        lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+#endif
+}
+
 void LcdDisplay::SetTheme(const std::string& theme_name) {
     DisplayLockGuard lock(this);
     
@@ -1049,6 +1164,11 @@ void LcdDisplay::SetTheme(const std::string& theme_name) {
         }
     }
     
+    if (lyric_view_ != nullptr) {
+        lyric_view_->SetColors(current_theme_.chat_background, current_theme_.text,
+                               current_theme_.system_text, current_theme_.user_bubble);
+    }
+
     // Update content area colors
     if (content_ != nullptr) {
         lv_obj_set_style_bg_color(content_, current_theme_.chat_background, 0);
@@ -1249,6 +1369,13 @@ void LcdDisplay::start(){
   
 }
 
+void LcdDisplay::NotifyAudioData() {
+    TaskHandle_t task = fft_task_handle;
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
+}
+
 void LcdDisplay::drawSpectrumIfReady() {
     if (fft_data_ready) {
         draw_spectrum(avg_power_spectrum, FFT_SIZE/2);
@@ -1273,53 +1400,51 @@ void LcdDisplay::periodicUpdateTask() {
   
 
     auto music = Board::GetInstance().GetMusic();
-        
-    const TickType_t displayInterval = pdMS_TO_TICKS(40);  
-    const TickType_t audioProcessInterval = pdMS_TO_TICKS(15); 
-    
+
+    // FFT 与重绘频率由调节器根据音频负载决定，音频有风险时降频或暂停
+    VisualizerGovernor governor;
     TickType_t lastDisplayTime = xTaskGetTickCount();
     TickType_t lastAudioTime = xTaskGetTickCount();
     
     while (!fft_task_should_stop) {
-        
+        // 阻塞等待解码线程的新 PCM 通知；只有频谱待绘制或暂停中需要按时重新评估时才设超时，
+        // 断流或缓冲期间任务不会被唤醒
+        TickType_t timeout = portMAX_DELAY;
+        if (governor.paused()) {
+            timeout = governor.TicksUntilUpdate();
+        } else if (fft_data_ready) {
+            TickType_t displayElapsed = xTaskGetTickCount() - lastDisplayTime;
+            timeout = displayElapsed >= governor.draw_interval() ? 0 : governor.draw_interval() - displayElapsed;
+        }
+        bool new_audio = ulTaskNotifyTake(pdTRUE, timeout) > 0;
+        if (fft_task_should_stop) {
+            break;
+        }
+
+        governor.Update(music);
+        if (governor.paused()) {
+            continue;
+        }
+
         TickType_t currentTime = xTaskGetTickCount();
-        
-        
-        if (currentTime - lastAudioTime >= audioProcessInterval) {
-            if(music->GetAudioData() != nullptr) {
-                readAudioData();  // 快速处理，不阻塞
-            } else {
-                vTaskDelay(pdMS_TO_TICKS(100));
-            }
+        if (new_audio && currentTime - lastAudioTime >= governor.fft_interval()) {
+            readAudioData();  // 快速处理，不阻塞
             lastAudioTime = currentTime;
         }
         
-        // 显示刷新（30Hz）
-        if (currentTime - lastDisplayTime >= displayInterval) {
-            if (fft_data_ready) {
-                DisplayLockGuard lock(this);
-                drawSpectrumIfReady();
-                lv_area_t refresh_area;
-                refresh_area.x1 = 0;
-                refresh_area.y1 = height_-100;
-                refresh_area.x2 = canvas_width_ -1;
-                refresh_area.y2 = height_ -1; // 只刷新频谱区域
-                lv_obj_invalidate_area(canvas_, &refresh_area);
-                //lv_obj_invalidate(canvas_);
-                fft_data_ready = false;
-                lastDisplayTime = currentTime;
-            }   // 绘制操作
-           
-            
-            // 更新FPS计数
-            //FPS();
+        if (fft_data_ready && currentTime - lastDisplayTime >= governor.draw_interval()) {
+            DisplayLockGuard lock(this);
+            drawSpectrumIfReady();
+            lv_area_t refresh_area;
+            refresh_area.x1 = 0;
+            refresh_area.y1 = height_-100;
+            refresh_area.x2 = canvas_width_ -1;
+            refresh_area.y2 = height_ -1; // 只刷新频谱区域
+            lv_obj_invalidate_area(canvas_, &refresh_area);
+            //lv_obj_invalidate(canvas_);
+            fft_data_ready = false;
+            lastDisplayTime = currentTime;
         }
-        
-        
-        
-        vTaskDelay(pdMS_TO_TICKS(10));
-        // 短暂延迟
-        
     }
     
     ESP_LOGI(TAG, "FFT display task stopped");
@@ -1383,8 +1508,7 @@ void LcdDisplay::readAudioData(){
 
         }
     }else{
-            ESP_LOGI(TAG, "audio_data is nullptr");
-            vTaskDelay(pdMS_TO_TICKS(500));
+            ESP_LOGW(TAG, "audio_data is nullptr");
         }   
 }
 
@@ -1561,6 +1685,7 @@ void LcdDisplay::stopFft() {
     if (fft_task_handle != nullptr) {
         ESP_LOGI(TAG, "Stopping FFT display task");
         fft_task_should_stop = true;  // 设置停止标志
+        xTaskNotifyGive(fft_task_handle);  // 唤醒阻塞等待 PCM 的任务
         
         // 等待任务停止（最多等待1秒）
         int wait_count = 0;
@@ -2,12 +2,14 @@
 #define LCD_DISPLAY_H
 
 #include "display.h"
+#include "lyric_view.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
 #include <font_emoji.h>
 
 #include <atomic>
+#include <memory>
 #include <vector>
 #include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
@@ -39,11 +41,19 @@ protected:
     lv_obj_t* container_ = nullptr;
     lv_obj_t* side_bar_ = nullptr;
     lv_obj_t* preview_image_ = nullptr;
+    // 通过 SetPreviewImageFromMemory 解码的封面图，由 CoverArtDecoder 分配和释放
+    lv_image_dsc_t* cover_image_ = nullptr;
+    int preview_width_pct_ = 50;
+    int preview_height_pct_ = 50;
+    // 歌词视图在第一次显示歌词时创建
+    std::unique_ptr<LyricView> lyric_view_;
 
     DisplayFonts fonts_;
     ThemeColors current_theme_;
 
     void SetupUI();
+    // 在解码任务中调用，接管 image 并显示；image 为 nullptr 表示解码失败
+    virtual void ShowCoverArt(lv_image_dsc_t* image);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -54,6 +64,7 @@ protected:
   
     virtual void clearScreen() override;
     virtual void stopFft() override;  // 停止FFT显示
+    virtual void NotifyAudioData() override;
     
     // 定时任务方法
     void periodicUpdateTask();
@@ -104,8 +115,15 @@ public:
     virtual void SetIcon(const char* icon) override;
     virtual void SetMusicInfo(const char* song_name) override;
     virtual void SetPreviewImage(const lv_img_dsc_t* img_dsc) override;
+    virtual bool SetPreviewImageFromMemory(const uint8_t* data, size_t len) override;
+    virtual bool SetPreviewImageFromBuffer(uint8_t* data, size_t len, const std::string& cache_key) override;
+    virtual bool SetPreviewImageFromCache(const std::string& cache_key) override;
+    virtual void ClearPreviewImage() override;
+    virtual void SetPreviewScaling(int decoded_width_pct, int decoded_height_pct, int fallback_width_pct) override;
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
     virtual void SetChatMessage(const char* role, const char* content) override; 
+    virtual void SetLyrics(const char* previous, const char* current, const char* next) override;
+    virtual void SetLyricProgress(int highlighted_chars) override;
 #endif  
 
     // Add theme switching function
@@ -0,0 +1,96 @@
+#include "lyric_view.h"
+
+#include <cstring>
+
+#define LYRIC_VIEW_PADDING 6
+
+LyricView::LyricView(lv_obj_t* parent, const lv_font_t* font) {
+    int line_height = lv_font_get_line_height(font);
+    // 当前句最多两行，上一句和下一句各一行
+    int heights[kLineCount] = { line_height, line_height * 2, line_height };
+
+    container_ = lv_obj_create(parent);
+    // 浮动对象不参与父容器的 flex 布局，显示和隐藏不会引起其他对象重新布局
+    lv_obj_add_flag(container_, LV_OBJ_FLAG_FLOATING);
+    lv_obj_remove_flag(container_, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_size(container_, LV_PCT(100), line_height * 4 + LYRIC_VIEW_PADDING * 4);
+    lv_obj_align(container_, LV_ALIGN_BOTTOM_MID, 0, 0);
+    lv_obj_set_style_radius(container_, 0, 0);
+    lv_obj_set_style_border_width(container_, 0, 0);
+    lv_obj_set_style_pad_all(container_, LYRIC_VIEW_PADDING, 0);
+    lv_obj_set_style_text_font(container_, font, 0);
+
+    int y = 0;
+    for (int i = 0; i < kLineCount; i++) {
+        lines_[i] = lv_label_create(container_);
+        lv_obj_set_pos(lines_[i], 0, y);
+        lv_obj_set_size(lines_[i], LV_PCT(100), heights[i]);
+        lv_label_set_long_mode(lines_[i], LV_LABEL_LONG_DOT);
+        lv_obj_set_style_text_align(lines_[i], LV_TEXT_ALIGN_CENTER, 0);
+        lv_label_set_text_static(lines_[i], "");
+        y += heights[i] + LYRIC_VIEW_PADDING;
+    }
+    lv_obj_set_style_bg_opa(lines_[kCurrent], LV_OPA_TRANSP, LV_PART_SELECTED);
+
+    lv_obj_add_flag(container_, LV_OBJ_FLAG_HIDDEN);
+}
+
+LyricView::~LyricView() {
+    if (container_ != nullptr) {
+        lv_obj_del(container_);
+    }
+}
+
+void LyricView::SetColors(lv_color_t background, lv_color_t text, lv_color_t dim_text, lv_color_t highlight) {
+    lv_obj_set_style_bg_color(container_, background, 0);
+    lv_obj_set_style_text_color(lines_[kPrevious], dim_text, 0);
+    lv_obj_set_style_text_color(lines_[kCurrent], text, 0);
+    lv_obj_set_style_text_color(lines_[kCurrent], highlight, LV_PART_SELECTED);
+    lv_obj_set_style_text_color(lines_[kNext], dim_text, 0);
+}
+
+void LyricView::SetLines(const char* previous, const char* current, const char* next) {
+    if (current == nullptr) {
+        lv_obj_add_flag(container_, LV_OBJ_FLAG_HIDDEN);
+        return;
+    }
+    SetLineText(kPrevious, previous);
+    SetLineText(kCurrent, current);
+    SetLineText(kNext, next);
+    lv_obj_remove_flag(container_, LV_OBJ_FLAG_HIDDEN);
+}
+
+void LyricView::SetProgress(int highlighted_chars) {
+    if (highlighted_chars == progress_) {
+        return;
+    }
+    progress_ = highlighted_chars;
+#if LV_LABEL_TEXT_SELECTION
+    if (highlighted_chars > 0) {
+        lv_label_set_text_selection_start(lines_[kCurrent], 0);
+        lv_label_set_text_selection_end(lines_[kCurrent], highlighted_chars);
+    } else {
+        lv_label_set_text_selection_start(lines_[kCurrent], LV_LABEL_TEXT_SELECTION_OFF);
+        lv_label_set_text_selection_end(lines_[kCurrent], LV_LABEL_TEXT_SELECTION_OFF);
+    }
+#endif
+}
+
+bool LyricView::IsVisible() const {
+    return !lv_obj_has_flag(container_, LV_OBJ_FLAG_HIDDEN);
+}
+
+void LyricView::SetLineText(int slot, const char* text) {
+    if (text == nullptr) {
+        text = "";
+    }
+    // 文字未变化时不触发重绘
+    if (strcmp(lv_label_get_text(lines_[slot]), text) == 0) {
+        return;
+    }
+    lv_label_set_text(lines_[slot], text);
+    if (slot == kCurrent) {
+        progress_ = -2;
+        SetProgress(-1);
+    }
+}
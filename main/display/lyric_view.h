@@ -0,0 +1,39 @@
+#ifndef LYRIC_VIEW_H
+#define LYRIC_VIEW_H
+
+#include <lvgl.h>
+
+// 歌词视图：预先创建上一句/当前句/下一句三个标签，换行时只替换文字，不创建或删除 LVGL 对象。
+// 标签位置和尺寸固定，文字变化只会重绘对应标签的区域；当前句通过文本选区实现卡拉OK高亮。
+// 所有方法都必须在显示锁内调用。
+class LyricView {
+public:
+    LyricView(lv_obj_t* parent, const lv_font_t* font);
+    ~LyricView();
+
+    LyricView(const LyricView&) = delete;
+    LyricView& operator=(const LyricView&) = delete;
+
+    void SetColors(lv_color_t background, lv_color_t text, lv_color_t dim_text, lv_color_t highlight);
+    // current 为 nullptr 时隐藏视图
+    void SetLines(const char* previous, const char* current, const char* next);
+    // 高亮当前句的前 highlighted_chars 个字符（按 UTF-8 字符计），-1 表示不高亮
+    void SetProgress(int highlighted_chars);
+    bool IsVisible() const;
+
+private:
+    enum {
+        kPrevious,
+        kCurrent,
+        kNext,
+        kLineCount,
+    };
+
+    void SetLineText(int slot, const char* text);
+
+    lv_obj_t* container_ = nullptr;
+    lv_obj_t* lines_[kLineCount] = {};
+    int progress_ = -1;
+};
+
+#endif // LYRIC_VIEW_H
@@ -1,4 +1,7 @@
 #include "oled_display.h"
+#include "cover_art_cache.h"
+#include "visualizer_governor.h"
+#include "board.h"
 #include "font_awesome_symbols.h"
 #include "assets/lang_config.h"
 
@@ -11,6 +14,9 @@
 
 #define TAG "OledDisplay"
 
+// 频谱分析使用的 PCM 样本数（MPEG-2 单声道帧为 576 个样本，取二者都能满足的长度）
+#define OLED_SPECTRUM_SAMPLES 512
+
 LV_FONT_DECLARE(font_awesome_30_1);
 
 OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
@@ -65,6 +71,7 @@ OledDisplay::OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handl
 }
 
 OledDisplay::~OledDisplay() {
+    stopFft();
     if (content_ != nullptr) {
         lv_obj_del(content_);
     }
@@ -77,6 +84,7 @@ OledDisplay::~OledDisplay() {
     if (container_ != nullptr) {
         lv_obj_del(container_);
     }
+    CoverArtDecoder::SwapImage(nullptr, cover_image_, nullptr);
 
     if (panel_ != nullptr) {
         esp_lcd_panel_del(panel_);
@@ -109,14 +117,79 @@ void OledDisplay::SetChatMessage(const char* role, const char* content) {
         lv_label_set_text(chat_message_label_, content_str.c_str());
     } else {
         if (content == nullptr || content[0] == '\0') {
+            lv_label_set_text(chat_message_label_, "");
             lv_obj_add_flag(content_right_, LV_OBJ_FLAG_HIDDEN);
         } else {
             lv_label_set_text(chat_message_label_, content_str.c_str());
-            lv_obj_clear_flag(content_right_, LV_OBJ_FLAG_HIDDEN);
+            // 频谱占用右侧区域时只更新文字，停止后再显示
+            if (spectrum_ == nullptr) {
+                lv_obj_clear_flag(content_right_, LV_OBJ_FLAG_HIDDEN);
+            }
         }
     }
 }
 
+// 两种布局中表情图标都位于左侧 32 像素宽的区域，封面图抖动成单色后替换表情图标
+bool OledDisplay::SetPreviewImageFromMemory(const uint8_t* data, size_t len) {
+    int size = std::min(32, height_);
+    return CoverArtDecoder::GetInstance().Submit(data, len, size, size,
+        CoverArtDecoder::PixelFormat::kMono, [this](lv_image_dsc_t* image) {
+        ShowCoverArt(image);
+    });
+}
+
+bool OledDisplay::SetPreviewImageFromBuffer(uint8_t* data, size_t len, const std::string& cache_key) {
+    int size = std::min(32, height_);
+    return CoverArtDecoder::GetInstance().SubmitOwned(data, len, size, size,
+        CoverArtDecoder::PixelFormat::kMono, cache_key, [this](lv_image_dsc_t* image) {
+        ShowCoverArt(image);
+    });
+}
+
+bool OledDisplay::SetPreviewImageFromCache(const std::string& cache_key) {
+    int size = std::min(32, height_);
+    auto image = CoverArtCache::GetInstance().Lookup(cache_key, size, size, CoverArtDecoder::PixelFormat::kMono);
+    if (image == nullptr) {
+        return false;
+    }
+    CoverArtDecoder::GetInstance().Cancel();
+    ShowCoverArt(image);
+    return true;
+}
+
+void OledDisplay::ShowCoverArt(lv_image_dsc_t* image) {
+    if (image == nullptr) {
+        return;
+    }
+    DisplayLockGuard lock(this);
+    if (emotion_label_ == nullptr) {
+        CoverArtDecoder::FreeImage(image);
+        return;
+    }
+    if (preview_image_ == nullptr) {
+        preview_image_ = lv_image_create(lv_obj_get_parent(emotion_label_));
+        lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_FLOATING);
+        lv_obj_center(preview_image_);
+    }
+    CoverArtDecoder::SwapImage(preview_image_, cover_image_, image);
+    lv_obj_clear_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_add_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+}
+
+void OledDisplay::ClearPreviewImage() {
+    CoverArtDecoder::GetInstance().Cancel();
+
+    DisplayLockGuard lock(this);
+    if (cover_image_ == nullptr) {
+        return;
+    }
+    CoverArtDecoder::SwapImage(preview_image_, cover_image_, nullptr);
+    lv_obj_add_flag(preview_image_, LV_OBJ_FLAG_HIDDEN);
+    if (emotion_label_ != nullptr) {
+        lv_obj_clear_flag(emotion_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+}
+
 void OledDisplay::SetupUI_128x64() {
     DisplayLockGuard lock(this);
 
@@ -308,3 +381,129 @@ void OledDisplay::SetupUI_128x32() {
     lv_obj_set_style_anim_duration(chat_message_label_, lv_anim_speed_clamped(60, 300, 60000), LV_PART_MAIN);
 }
 
+void OledDisplay::start() {
+    if (spectrum_task_ != nullptr || display_ == nullptr) {
+        return;
+    }
+
+    {
+        DisplayLockGuard lock(this);
+        // 隐藏频谱区域内的 LVGL 对象，LVGL 只会把该区域刷成背景一次
+        if (height_ == 64) {
+            // 左侧 32 像素保留给表情或封面，频谱占用右侧区域；右侧隐藏后左列靠左而不是居中
+            spectrum_ = std::make_unique<OledSpectrum>(panel_, 32, 16, width_ - 32, height_ - 16);
+            lv_obj_add_flag(content_right_, LV_OBJ_FLAG_HIDDEN);
+            lv_obj_set_style_flex_main_place(content_, LV_FLEX_ALIGN_START, 0);
+        } else {
+            spectrum_ = std::make_unique<OledSpectrum>(panel_, 32, 16, width_ - 32, 16);
+            lv_obj_add_flag(chat_message_label_, LV_OBJ_FLAG_HIDDEN);
+        }
+        // LVGL 之后再刷到该区域时，下一帧需要整块重发
+        lv_display_add_event_cb(display_, SpectrumFlushCallback, LV_EVENT_FLUSH_START, this);
+    }
+
+    spectrum_task_should_stop_ = false;
+    xTaskCreate([](void* arg) {
+        static_cast<OledDisplay*>(arg)->SpectrumTask();
+    }, "oled_spectrum", 3072, this, 1, &spectrum_task_);
+}
+
+void OledDisplay::stopFft() {
+    if (spectrum_task_ != nullptr) {
+        spectrum_task_should_stop_ = true;
+        xTaskNotifyGive(spectrum_task_);
+        int wait_count = 0;
+        while (spectrum_task_ != nullptr && wait_count < 100) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+            wait_count++;
+        }
+        if (spectrum_task_ != nullptr) {
+            ESP_LOGW(TAG, "Spectrum task did not stop gracefully, force deleting");
+            vTaskDelete(spectrum_task_);
+            spectrum_task_ = nullptr;
+        }
+    }
+
+    DisplayLockGuard lock(this);
+    if (spectrum_ == nullptr) {
+        return;
+    }
+    lv_display_remove_event_cb_with_user_data(display_, SpectrumFlushCallback, this);
+    spectrum_.reset();
+    if (height_ == 64) {
+        lv_obj_set_style_flex_main_place(content_, LV_FLEX_ALIGN_CENTER, 0);
+        const char* text = lv_label_get_text(chat_message_label_);
+        if (text != nullptr && text[0] != '\0') {
+            lv_obj_remove_flag(content_right_, LV_OBJ_FLAG_HIDDEN);
+        }
+    } else {
+        lv_obj_remove_flag(chat_message_label_, LV_OBJ_FLAG_HIDDEN);
+    }
+    // 让 LVGL 覆盖面板上残留的频谱
+    lv_obj_invalidate(lv_screen_active());
+}
+
+void OledDisplay::NotifyAudioData() {
+    TaskHandle_t task = spectrum_task_;
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
+    }
+}
+
+// 在 LVGL 任务中调用，此时已持有显示锁
+void OledDisplay::SpectrumFlushCallback(lv_event_t* e) {
+    auto self = static_cast<OledDisplay*>(lv_event_get_user_data(e));
+    auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+    if (self->spectrum_ != nullptr && area != nullptr && self->spectrum_->Overlaps(area)) {
+        self->spectrum_->Invalidate();
+    }
+}
+
+void OledDisplay::SpectrumTask() {
+    auto music = Board::GetInstance().GetMusic();
+    VisualizerGovernor governor;
+    TickType_t last_analyze_time = xTaskGetTickCount();
+    TickType_t last_draw_time = xTaskGetTickCount();
+    bool dirty = false;
+
+    while (!spectrum_task_should_stop_) {
+        // 由解码线程的 PCM 通知唤醒；只有待绘制或暂停中需要重新评估时才设超时
+        TickType_t timeout = portMAX_DELAY;
+        if (governor.paused()) {
+            timeout = governor.TicksUntilUpdate();
+        } else if (dirty) {
+            TickType_t elapsed = xTaskGetTickCount() - last_draw_time;
+            timeout = elapsed >= governor.draw_interval() ? 0 : governor.draw_interval() - elapsed;
+        }
+        bool new_audio = ulTaskNotifyTake(pdTRUE, timeout) > 0;
+        if (spectrum_task_should_stop_) {
+            break;
+        }
+
+        governor.Update(music);
+        if (governor.paused()) {
+            continue;
+        }
+
+        TickType_t now = xTaskGetTickCount();
+        if (new_audio && now - last_analyze_time >= governor.fft_interval()) {
+            int16_t* samples = music->GetAudioData();
+            if (samples != nullptr) {
+                spectrum_->Analyze(samples, OLED_SPECTRUM_SAMPLES);
+                dirty = true;
+            }
+            last_analyze_time = now;
+        }
+
+        if (dirty && now - last_draw_time >= governor.draw_interval()) {
+            DisplayLockGuard lock(this);
+            spectrum_->Render();
+            dirty = false;
+            last_draw_time = now;
+        }
+    }
+
+    ESP_LOGI(TAG, "Spectrum task stopped");
+    spectrum_task_ = nullptr;
+    vTaskDelete(NULL);
+}
@@ -2,9 +2,15 @@
 #define OLED_DISPLAY_H
 
 #include "display.h"
+#include "oled_spectrum.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <memory>
 
 class OledDisplay : public Display {
 private:
@@ -17,14 +23,24 @@ private:
     lv_obj_t* content_right_ = nullptr;
     lv_obj_t* container_ = nullptr;
     lv_obj_t* side_bar_ = nullptr;
+    lv_obj_t* preview_image_ = nullptr;
+    lv_image_dsc_t* cover_image_ = nullptr;
 
     DisplayFonts fonts_;
 
+    // 音乐频谱：占用状态栏下方的区域，绕过 LVGL 直接按页写入面板
+    std::unique_ptr<OledSpectrum> spectrum_;
+    TaskHandle_t spectrum_task_ = nullptr;
+    std::atomic<bool> spectrum_task_should_stop_ = false;
+
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
     void SetupUI_128x64();
     void SetupUI_128x32();
+    void ShowCoverArt(lv_image_dsc_t* image);
+    void SpectrumTask();
+    static void SpectrumFlushCallback(lv_event_t* e);
 
 public:
     OledDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel, int width, int height, bool mirror_x, bool mirror_y,
@@ -32,6 +48,13 @@ public:
     ~OledDisplay();
 
     virtual void SetChatMessage(const char* role, const char* content) override;
+    virtual bool SetPreviewImageFromMemory(const uint8_t* data, size_t len) override;
+    virtual bool SetPreviewImageFromBuffer(uint8_t* data, size_t len, const std::string& cache_key) override;
+    virtual bool SetPreviewImageFromCache(const std::string& cache_key) override;
+    virtual void ClearPreviewImage() override;
+    virtual void start() override;
+    virtual void stopFft() override;
+    virtual void NotifyAudioData() override;
 };
 
 #endif // OLED_DISPLAY_H
@@ -0,0 +1,171 @@
+#include "oled_spectrum.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define TAG "OledSpectrum"
+
+// 两两平均降采样后参与分析的点数（按 44.1 kHz 音源计约 11.6 ms）
+#define OLED_SPECTRUM_POINTS 256
+#define OLED_SPECTRUM_SAMPLE_RATE 22050
+#define OLED_SPECTRUM_MIN_FREQ 80.0f
+#define OLED_SPECTRUM_MAX_FREQ 10000.0f
+// 顶部两行为电平表，空一行后为频谱条
+#define OLED_SPECTRUM_METER_ROWS 2
+#define OLED_SPECTRUM_BAR_TOP 3
+// 对数刻度（单位 1.5 dB）：频带功率和均方电平映射到条高度的下限与范围
+#define OLED_SPECTRUM_BAND_FLOOR 40
+#define OLED_SPECTRUM_LEVEL_FLOOR 24
+#define OLED_SPECTRUM_RANGE 36
+#define OLED_SPECTRUM_PEAK_HOLD_FRAMES 20
+
+// 以 2 为底的对数乘 2（保留半个二进制位的精度），相当于 1.5 dB 一档
+static int Log2x2(uint64_t value) {
+    if (value <= 1) {
+        return 0;
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    return exponent * 2 + (int)((value >> (exponent - 1)) & 1);
+}
+
+OledSpectrum::OledSpectrum(esp_lcd_panel_handle_t panel, int x, int y, int width, int height)
+    : panel_(panel), x_(x), y_(y), width_(width), height_(height), pages_(height / 8),
+      buffer_(width * (height / 8)), shadow_(width * (height / 8)) {
+    // 频带中心频率按对数均匀分布，系数只在构造时计算一次。
+    // 单点 Goertzel 的带宽约为 采样率/长度，按频带宽度选择长度，高频带才不会漏掉落在两点之间的音
+    float ratio = powf(OLED_SPECTRUM_MAX_FREQ / OLED_SPECTRUM_MIN_FREQ, 1.0f / (kBands - 1));
+    for (int i = 0; i < kBands; i++) {
+        float freq = OLED_SPECTRUM_MIN_FREQ * powf(ratio, (float)i);
+        float w = 2.0f * (float)M_PI * freq / OLED_SPECTRUM_SAMPLE_RATE;
+        coeffs_[i] = (int32_t)lroundf(2.0f * cosf(w) * (1 << 14));
+        float length = OLED_SPECTRUM_SAMPLE_RATE / (freq * (ratio - 1.0f));
+        int length_log2 = (int)floorf(log2f(length));
+        length_log2_[i] = (uint8_t)std::clamp(length_log2, kMinLengthLog2, kMaxLengthLog2);
+    }
+    for (int i = 0; i < kWindowCount; i++) {
+        int length = 1 << (kMinLengthLog2 + i);
+        windows_[i].resize(length);
+        for (int j = 0; j < length; j++) {
+            windows_[i][j] = (int16_t)lroundf(32767.0f * 0.5f * (1.0f - cosf(2.0f * (float)M_PI * j / (length - 1))));
+        }
+    }
+}
+
+bool OledSpectrum::Overlaps(const lv_area_t* area) const {
+    return area->x1 < x_ + width_ && area->x2 >= x_ && area->y1 < y_ + height_ && area->y2 >= y_;
+}
+
+void OledSpectrum::Analyze(const int16_t* samples, int count) {
+    int n = std::min(count / 2, OLED_SPECTRUM_POINTS);
+    if (n < (1 << kMaxLengthLog2)) {
+        return;
+    }
+
+    // 降采样并缩到 12 位，保证 Goertzel 状态在 int32 范围内
+    int16_t input[OLED_SPECTRUM_POINTS];
+    int64_t sum_squares = 0;
+    for (int i = 0; i < n; i++) {
+        int32_t a = samples[i * 2];
+        int32_t b = samples[i * 2 + 1];
+        input[i] = (int16_t)((a + b) >> 4);
+        sum_squares += (int64_t)a * a + (int64_t)b * b;
+    }
+
+    int bar_height = height_ - OLED_SPECTRUM_BAR_TOP;
+    for (int band = 0; band < kBands; band++) {
+        int32_t coeff = coeffs_[band];
+        int length_log2 = length_log2_[band];
+        const int16_t* window = windows_[length_log2 - kMinLengthLog2].data();
+        int32_t s1 = 0;
+        int32_t s2 = 0;
+        for (int i = 0; i < (1 << length_log2); i++) {
+            int32_t x = (input[i] * window[i]) >> 15;
+            int32_t s = x + (int32_t)(((int64_t)coeff * s1) >> 14) - s2;
+            s2 = s1;
+            s1 = s;
+        }
+        int64_t power = (int64_t)s1 * s1 + (int64_t)s2 * s2 - (((int64_t)coeff * s1) >> 14) * s2;
+        // 功率与长度的平方成正比，折算到最大长度（每倍长度为 4 档）
+        int db = Log2x2(std::max<int64_t>(power, 0)) + (kMaxLengthLog2 - length_log2) * 4;
+        int h = (db - OLED_SPECTRUM_BAND_FLOOR) * bar_height / OLED_SPECTRUM_RANGE;
+        h = std::clamp(h, 0, bar_height);
+        // 上升立即跟随，下降每帧一个像素
+        bars_[band] = h >= bars_[band] ? h : bars_[band] - 1;
+    }
+
+    int level = (Log2x2(sum_squares / (n * 2)) - OLED_SPECTRUM_LEVEL_FLOOR) * width_ / OLED_SPECTRUM_RANGE;
+    level_ = std::clamp(level, 0, width_);
+    if (level_ >= peak_) {
+        peak_ = level_;
+        peak_hold_ = OLED_SPECTRUM_PEAK_HOLD_FRAMES;
+    } else if (peak_hold_ > 0) {
+        peak_hold_--;
+    } else {
+        peak_--;
+    }
+}
+
+// 点亮 [x1, x2] 列中 [top, bottom] 行（含端点）
+void OledSpectrum::FillColumns(int x1, int x2, int top, int bottom) {
+    for (int page = top / 8; page <= bottom / 8; page++) {
+        int first = std::max(top, page * 8) - page * 8;
+        int last = std::min(bottom, page * 8 + 7) - page * 8;
+        uint8_t mask = (uint8_t)((0xFF >> (7 - last)) & (0xFF << first));
+        uint8_t* row = &buffer_[page * width_];
+        for (int x = x1; x <= x2; x++) {
+            row[x] |= mask;
+        }
+    }
+}
+
+void OledSpectrum::Render() {
+    std::fill(buffer_.begin(), buffer_.end(), 0);
+
+    if (level_ > 0) {
+        FillColumns(0, level_ - 1, 0, OLED_SPECTRUM_METER_ROWS - 1);
+    }
+    if (peak_ > 0) {
+        FillColumns(peak_ - 1, peak_ - 1, 0, OLED_SPECTRUM_METER_ROWS - 1);
+    }
+
+    int band_width = width_ / kBands;
+    for (int band = 0; band < kBands; band++) {
+        if (bars_[band] == 0) {
+            continue;
+        }
+        int x1 = band * band_width;
+        int x2 = std::max(x1, x1 + band_width - 2);  // 条之间留一列空隙
+        FillColumns(x1, x2, height_ - bars_[band], height_ - 1);
+    }
+
+    // 逐页比较，只发送变化的列范围
+    for (int page = 0; page < pages_; page++) {
+        const uint8_t* row = &buffer_[page * width_];
+        uint8_t* sent = &shadow_[page * width_];
+        int first = 0;
+        int last = width_ - 1;
+        if (shadow_valid_) {
+            while (first < width_ && row[first] == sent[first]) {
+                first++;
+            }
+            if (first == width_) {
+                continue;
+            }
+            while (row[last] == sent[last]) {
+                last--;
+            }
+        }
+        int y = y_ + page * 8;
+        esp_err_t ret = esp_lcd_panel_draw_bitmap(panel_, x_ + first, y, x_ + last + 1, y + 8, row + first);
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "Failed to flush page %d: %s", page, esp_err_to_name(ret));
+            shadow_valid_ = false;
+            return;
+        }
+        memcpy(sent + first, row + first, last - first + 1);
+    }
+    shadow_valid_ = true;
+}
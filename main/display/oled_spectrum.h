@@ -0,0 +1,58 @@
+#ifndef OLED_SPECTRUM_H
+#define OLED_SPECTRUM_H
+
+#include <esp_lcd_panel_ops.h>
+#include <lvgl.h>
+
+#include <cstdint>
+#include <vector>
+
+// 单色 OLED 的频谱与电平表：用定点 Goertzel 滤波器组分析 PCM（适合没有 FPU 加速的 ESP32-C3），
+// 直接绘制到按页打包的 1bpp 缓冲区（每字节为一列中纵向 8 个像素，与 SSD1306/SH1106 显存格式一致），
+// 与上次发送的内容逐页比较，只通过 I2C 发送发生变化的页中变化的列范围。
+// 区域的 y 与高度必须是 8 的整数倍。
+class OledSpectrum {
+public:
+    OledSpectrum(esp_lcd_panel_handle_t panel, int x, int y, int width, int height);
+
+    OledSpectrum(const OledSpectrum&) = delete;
+    OledSpectrum& operator=(const OledSpectrum&) = delete;
+
+    // 分析一帧单声道 PCM，更新频带高度和电平
+    void Analyze(const int16_t* samples, int count);
+    // 绘制并发送变化的页，必须在显示锁内调用
+    void Render();
+    // 区域被 LVGL 覆盖后调用，下一次 Render 发送整个区域
+    void Invalidate() { shadow_valid_ = false; }
+    bool Overlaps(const lv_area_t* area) const;
+
+private:
+    static constexpr int kBands = 16;
+    // 分析长度为 16~256 的 2 的幂，对应 5 组 Hann 窗
+    static constexpr int kMinLengthLog2 = 4;
+    static constexpr int kMaxLengthLog2 = 8;
+    static constexpr int kWindowCount = kMaxLengthLog2 - kMinLengthLog2 + 1;
+
+    void FillColumns(int x1, int x2, int top, int bottom);
+
+    esp_lcd_panel_handle_t panel_;
+    int x_;
+    int y_;
+    int width_;
+    int height_;
+    int pages_;
+
+    int32_t coeffs_[kBands];    // 2cos(w)，Q14
+    uint8_t length_log2_[kBands];  // 频带越高越宽，分析长度越短
+    std::vector<int16_t> windows_[kWindowCount];  // Q15
+    uint8_t bars_[kBands] = {};
+    int level_ = 0;
+    int peak_ = 0;
+    int peak_hold_ = 0;
+
+    std::vector<uint8_t> buffer_;
+    std::vector<uint8_t> shadow_;  // 面板上当前的内容
+    bool shadow_valid_ = false;
+};
+
+#endif // OLED_SPECTRUM_H
@@ -0,0 +1,105 @@
+#include "render_stats.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "RenderStats"
+
+void RenderStats::Counter::Add(uint32_t us) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    total_us.fetch_add(us, std::memory_order_relaxed);
+    uint32_t max = max_us.load(std::memory_order_relaxed);
+    while (us > max && !max_us.compare_exchange_weak(max, us, std::memory_order_relaxed)) {
+    }
+}
+
+void RenderStats::Counter::Reset() {
+    count.store(0, std::memory_order_relaxed);
+    total_us.store(0, std::memory_order_relaxed);
+    max_us.store(0, std::memory_order_relaxed);
+}
+
+cJSON* RenderStats::Counter::ToJson() const {
+    uint32_t n = count.load(std::memory_order_relaxed);
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "count", n);
+    cJSON_AddNumberToObject(json, "avg_ms", n > 0 ? total_us.load(std::memory_order_relaxed) / 1000.0 / n : 0);
+    cJSON_AddNumberToObject(json, "max_ms", max_us.load(std::memory_order_relaxed) / 1000.0);
+    return json;
+}
+
+// 必须在显示锁内调用
+void RenderStats::SetEnabled(lv_display_t* display, bool enabled) {
+    if (display == nullptr || enabled == this->enabled()) {
+        return;
+    }
+    if (enabled) {
+        display_ = display;
+        ResetWindow();
+        lv_display_add_event_cb(display_, EventCallback, LV_EVENT_RENDER_START, this);
+        lv_display_add_event_cb(display_, EventCallback, LV_EVENT_RENDER_READY, this);
+        lv_display_add_event_cb(display_, EventCallback, LV_EVENT_FLUSH_START, this);
+        lv_display_add_event_cb(display_, EventCallback, LV_EVENT_FLUSH_WAIT_FINISH, this);
+    } else {
+        lv_display_remove_event_cb_with_user_data(display_, EventCallback, this);
+    }
+    enabled_.store(enabled, std::memory_order_relaxed);
+    ESP_LOGI(TAG, "Render stats %s", enabled ? "enabled" : "disabled");
+}
+
+void RenderStats::RecordLockWait(int64_t wait_us) {
+    lock_wait_.Add((uint32_t)wait_us);
+}
+
+// 在 LVGL 任务中调用
+void RenderStats::EventCallback(lv_event_t* e) {
+    auto self = static_cast<RenderStats*>(lv_event_get_user_data(e));
+    int64_t now = esp_timer_get_time();
+    switch (lv_event_get_code(e)) {
+        case LV_EVENT_RENDER_START:
+            self->render_start_us_ = now;
+            break;
+        case LV_EVENT_RENDER_READY:
+            self->render_.Add((uint32_t)(now - self->render_start_us_));
+            break;
+        case LV_EVENT_FLUSH_START: {
+            self->flush_start_us_ = now;
+            auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+            if (area != nullptr) {
+                uint32_t bpp = lv_color_format_get_bpp(lv_display_get_color_format(self->display_));
+                self->flush_bytes_.fetch_add((uint64_t)lv_area_get_size(area) * bpp / 8, std::memory_order_relaxed);
+            }
+            break;
+        }
+        case LV_EVENT_FLUSH_WAIT_FINISH:
+            self->flush_.Add((uint32_t)(now - self->flush_start_us_));
+            break;
+        default:
+            break;
+    }
+}
+
+void RenderStats::ResetWindow() {
+    render_.Reset();
+    flush_.Reset();
+    lock_wait_.Reset();
+    flush_bytes_.store(0, std::memory_order_relaxed);
+    window_start_us_ = esp_timer_get_time();
+}
+
+cJSON* RenderStats::ToJson() {
+    double seconds = (esp_timer_get_time() - window_start_us_) / 1000000.0;
+    auto json = cJSON_CreateObject();
+    cJSON_AddBoolToObject(json, "enabled", enabled());
+    if (enabled() && seconds > 0) {
+        cJSON_AddNumberToObject(json, "window_s", seconds);
+        cJSON_AddNumberToObject(json, "fps", render_.count.load(std::memory_order_relaxed) / seconds);
+        cJSON_AddItemToObject(json, "render", render_.ToJson());
+        auto flush = flush_.ToJson();
+        cJSON_AddNumberToObject(flush, "kb_per_s", flush_bytes_.load(std::memory_order_relaxed) / 1024.0 / seconds);
+        cJSON_AddItemToObject(json, "flush", flush);
+        cJSON_AddItemToObject(json, "lock_wait", lock_wait_.ToJson());
+        ResetWindow();
+    }
+    return json;
+}
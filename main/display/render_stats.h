@@ -0,0 +1,47 @@
+#ifndef RENDER_STATS_H
+#define RENDER_STATS_H
+
+#include <lvgl.h>
+#include <cJSON.h>
+
+#include <atomic>
+#include <cstdint>
+
+// LVGL 渲染统计：通过显示事件记录每帧渲染耗时、刷屏字节数与耗时（含等待 DMA 完成），
+// 以及 DisplayLockGuard 等待显示锁的时间。默认关闭，关闭时不注册事件回调。
+class RenderStats {
+public:
+    void SetEnabled(lv_display_t* display, bool enabled);
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    void RecordLockWait(int64_t wait_us);
+    // 返回自上次调用以来的统计窗口并开始新窗口
+    cJSON* ToJson();
+
+private:
+    struct Counter {
+        std::atomic<uint32_t> count{0};
+        std::atomic<uint64_t> total_us{0};
+        std::atomic<uint32_t> max_us{0};
+
+        void Add(uint32_t us);
+        void Reset();
+        cJSON* ToJson() const;
+    };
+
+    static void EventCallback(lv_event_t* e);
+    void ResetWindow();
+
+    std::atomic<bool> enabled_{false};
+    lv_display_t* display_ = nullptr;
+
+    Counter render_;
+    Counter flush_;
+    Counter lock_wait_;
+    std::atomic<uint64_t> flush_bytes_{0};
+    int64_t render_start_us_ = 0;
+    int64_t flush_start_us_ = 0;
+    int64_t window_start_us_ = 0;
+};
+
+#endif // RENDER_STATS_H
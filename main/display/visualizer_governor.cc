@@ -0,0 +1,105 @@
+#include "visualizer_governor.h"
+#include "boards/common/music.h"
+
+#include <esp_log.h>
+#include <freertos/task.h>
+
+#include <algorithm>
+
+#define TAG "VisualizerGovernor"
+
+#define GOVERNOR_UPDATE_INTERVAL_MS 500
+// 连续多少次评估无风险才升一档
+#define GOVERNOR_STABLE_UPDATES_TO_RAISE 4
+// 下载未完成时流缓冲低于此值视为有断流风险（与 Esp32Music 的最小播放缓冲一致）
+#define GOVERNOR_LOW_BUFFER_BYTES (32 * 1024)
+#define GOVERNOR_IDLE_CRITICAL_PERCENT 5
+#define GOVERNOR_IDLE_LOW_PERCENT 15
+#define GOVERNOR_IDLE_HEADROOM_PERCENT 35
+
+// 各档位的 FFT 与重绘间隔（毫秒），按 Level 顺序排列
+static const struct {
+    int fft_ms;
+    int draw_ms;
+} kLevelIntervals[] = {
+    {0, 0},     // kLevelPaused
+    {60, 125},  // kLevelLow
+    {30, 66},   // kLevelMedium
+    {15, 40},   // kLevelFull
+};
+
+VisualizerGovernor::VisualizerGovernor() : last_update_(xTaskGetTickCount()) {
+    SampleIdlePercent();
+}
+
+TickType_t VisualizerGovernor::fft_interval() const {
+    return pdMS_TO_TICKS(kLevelIntervals[level_].fft_ms);
+}
+
+TickType_t VisualizerGovernor::draw_interval() const {
+    return pdMS_TO_TICKS(kLevelIntervals[level_].draw_ms);
+}
+
+TickType_t VisualizerGovernor::TicksUntilUpdate() const {
+    TickType_t elapsed = xTaskGetTickCount() - last_update_;
+    TickType_t interval = pdMS_TO_TICKS(GOVERNOR_UPDATE_INTERVAL_MS);
+    return elapsed >= interval ? 0 : interval - elapsed;
+}
+
+VisualizerGovernor::Level VisualizerGovernor::Update(Music* music) {
+    if (TicksUntilUpdate() > 0) {
+        return level_;
+    }
+    last_update_ = xTaskGetTickCount();
+
+    uint32_t misses = music ? music->GetDeadlineMisses() : 0;
+    uint32_t new_misses = misses - last_deadline_misses_;
+    last_deadline_misses_ = misses;
+    bool low_buffer = music && music->IsDownloading() && music->GetBufferSize() < GOVERNOR_LOW_BUFFER_BYTES;
+    int idle = SampleIdlePercent();
+
+    Level level = level_;
+    if (new_misses >= 2 || (idle >= 0 && idle < GOVERNOR_IDLE_CRITICAL_PERCENT)) {
+        level = kLevelPaused;
+    } else if (new_misses > 0 || low_buffer || (idle >= 0 && idle < GOVERNOR_IDLE_LOW_PERCENT)) {
+        level = (Level)std::max((int)kLevelPaused, level_ - 1);
+    }
+
+    if (level != level_) {
+        stable_updates_ = 0;
+    } else if (idle < 0 || idle >= GOVERNOR_IDLE_HEADROOM_PERCENT) {
+        if (++stable_updates_ >= GOVERNOR_STABLE_UPDATES_TO_RAISE && level_ < kLevelFull) {
+            level = (Level)(level_ + 1);
+            stable_updates_ = 0;
+        }
+    } else {
+        stable_updates_ = 0;
+    }
+
+    if (level != level_) {
+        ESP_LOGI(TAG, "Level %d -> %d (misses=%lu, buffer=%u, idle=%d%%)", level_, level,
+                 (unsigned long)new_misses, music ? (unsigned)music->GetBufferSize() : 0, idle);
+        level_ = level;
+    }
+    return level_;
+}
+
+int VisualizerGovernor::SampleIdlePercent() {
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint32_t now = portGET_RUN_TIME_COUNTER_VALUE();
+    uint32_t elapsed = now - last_run_time_;
+    last_run_time_ = now;
+    int min_idle = 100;
+    for (int core = 0; core < CONFIG_FREERTOS_NUMBER_OF_CORES; core++) {
+        uint32_t counter = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+        uint32_t idle = counter - last_idle_counters_[core];
+        last_idle_counters_[core] = counter;
+        if (elapsed > 0) {
+            min_idle = std::min(min_idle, (int)((uint64_t)idle * 100 / elapsed));
+        }
+    }
+    return elapsed > 0 ? min_idle : -1;
+#else
+    return -1;
+#endif
+}
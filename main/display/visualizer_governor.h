@@ -0,0 +1,46 @@
+#ifndef VISUALIZER_GOVERNOR_H
+#define VISUALIZER_GOVERNOR_H
+
+#include <freertos/FreeRTOS.h>
+
+#include <cstdint>
+
+class Music;
+
+// 频谱可视化的帧率调节器：根据音乐流缓冲水位、解码超时次数和 CPU 空闲率调整 FFT 与重绘频率。
+// 音频有风险时立即降级（严重时暂停可视化），持续有余量时才逐级恢复，保证音频连续性优先于画面流畅度。
+class VisualizerGovernor {
+public:
+    enum Level {
+        kLevelPaused,
+        kLevelLow,
+        kLevelMedium,
+        kLevelFull,
+    };
+
+    VisualizerGovernor();
+
+    // 到达评估时间时读取反馈并调整档位，返回当前档位
+    Level Update(Music* music);
+    Level level() const { return level_; }
+    bool paused() const { return level_ == kLevelPaused; }
+    TickType_t fft_interval() const;
+    TickType_t draw_interval() const;
+    // 距离下一次评估的时间
+    TickType_t TicksUntilUpdate() const;
+
+private:
+    // 所有核心中最低的空闲率（百分比），无法统计时返回 -1
+    int SampleIdlePercent();
+
+    Level level_ = kLevelFull;
+    TickType_t last_update_;
+    uint32_t last_deadline_misses_ = 0;
+    int stable_updates_ = 0;
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint32_t last_idle_counters_[CONFIG_FREERTOS_NUMBER_OF_CORES] = {};
+    uint32_t last_run_time_ = 0;
+#endif
+};
+
+#endif // VISUALIZER_GOVERNOR_H
@@ -58,6 +58,22 @@
              return true;
          });
      
+#if CONFIG_USE_AUDIO_LATENCY_TRACE
+     AddTool("self.audio.get_latency",
+         "Get the audio latency statistics for debugging: rolling p50/p90/p99/max in milliseconds for every stage "
+         "of the uplink (process, encode, send_queue, send) and the downlink (jitter_buffer, decode, playback), "
+         "the uplink / downlink totals, and the response latency from the end of speech to the first reply frame.",
+         PropertyList(),
+         [](const PropertyList& properties) -> ReturnValue {
+             auto json = Application::GetInstance().GetAudioService().latency_tracer().ToJson(true);
+             auto json_str = cJSON_PrintUnformatted(json);
+             std::string result(json_str);
+             cJSON_free(json_str);
+             cJSON_Delete(json);
+             return result;
+         });
+#endif
+
      auto backlight = board.GetBacklight();
      if (backlight) {
          AddTool("self.screen.set_brightness",
@@ -85,6 +101,19 @@
              });
      }
  
+     if (display) {
+         AddTool("self.screen.set_render_stats",
+             "Enable or disable display render statistics (FPS, render/flush time, display lock wait) for debugging. "
+             "The statistics are reported by `self.get_device_status` under `screen.render_stats`.",
+             PropertyList({
+                 Property("enabled", kPropertyTypeBoolean)
+             }),
+             [display](const PropertyList& properties) -> ReturnValue {
+                 display->SetRenderStatsEnabled(properties["enabled"].value<bool>());
+                 return true;
+             });
+     }
+ 
      auto camera = board.GetCamera();
      if (camera) {
          AddTool("self.camera.take_photo",
@@ -202,12 +202,9 @@ bool MqttProtocol::OpenAudioChannel() {
         }
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
+        // Reordering, late packets and gaps are handled by the audio service's jitter buffer
         if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
+            ESP_LOGD(TAG, "Received audio packet with sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
         }
 
         size_t decrypted_size = data.size() - aes_nonce_.size();
@@ -215,10 +212,11 @@ bool MqttProtocol::OpenAudioChannel() {
         uint8_t stream_block[16] = {0};
         auto nonce = (uint8_t*)data.data();
         auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto packet = AudioStreamPacket::Create();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
         packet->timestamp = timestamp;
+        packet->sequence = sequence;
         packet->payload.resize(decrypted_size);
         int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
         if (ret != 0) {
@@ -228,7 +226,9 @@ bool MqttProtocol::OpenAudioChannel() {
         if (on_incoming_audio_ != nullptr) {
             on_incoming_audio_(std::move(packet));
         }
-        remote_sequence_ = sequence;
+        if ((int32_t)(sequence - remote_sequence_) > 0) {
+            remote_sequence_ = sequence;
+        }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -251,12 +251,18 @@ std::string MqttProtocol::GetHelloMessage() {
     cJSON_AddBoolToObject(features, "aec", true);
 #endif
     cJSON_AddBoolToObject(features, "mcp", true);
+#if CONFIG_USE_UPLINK_DTX
+    cJSON_AddBoolToObject(features, "dtx", true);
+#endif
     cJSON_AddItemToObject(root, "features", features);
     cJSON* audio_params = cJSON_CreateObject();
     cJSON_AddStringToObject(audio_params, "format", "opus");
     cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    static const int frame_durations[] = OPUS_SUPPORTED_FRAME_DURATIONS;
+    cJSON_AddItemToObject(audio_params, "frame_durations",
+        cJSON_CreateIntArray(frame_durations, sizeof(frame_durations) / sizeof(frame_durations[0])));
     cJSON_AddItemToObject(root, "audio_params", audio_params);
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
@@ -278,6 +284,10 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
+    // Uplink silence suppression is only used if the server also lists "dtx" in its features
+    auto features = cJSON_GetObjectItem(root, "features");
+    server_dtx_ = cJSON_IsObject(features) && cJSON_IsTrue(cJSON_GetObjectItem(features, "dtx"));
+
     // Get sample rate from hello message
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
     if (cJSON_IsObject(audio_params)) {
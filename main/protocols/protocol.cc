@@ -1,9 +1,47 @@
 #include "protocol.h"
+#include "object_pool.h"
 
 #include <esp_log.h>
 
 #define TAG "Protocol"
 
+// Covers the packets normally in flight: the jitter buffer's playout delay, the decode queue and the
+// send queue. Full queues hold far more (about 40 packets each at 60 ms frames, 120 at 20 ms), e.g.
+// while the network stalls or a long reply arrives faster than real time. The extra packets are then
+// allocated from the heap, which is expected under load; sizing the pool for the worst case would
+// pin several hundred packets for the whole session.
+#define AUDIO_STREAM_PACKET_POOL_SIZE 64
+// Larger payloads are freed on release instead of being kept in the pool
+#define AUDIO_STREAM_PACKET_MAX_POOLED_PAYLOAD 1500
+
+static ObjectPool<AudioStreamPacket, AUDIO_STREAM_PACKET_POOL_SIZE> audio_stream_packet_pool;
+
+std::unique_ptr<AudioStreamPacket> AudioStreamPacket::Create() {
+    auto packet = audio_stream_packet_pool.Acquire();
+    if (packet == nullptr) {
+        return std::make_unique<AudioStreamPacket>();
+    }
+    packet->sample_rate = 0;
+    packet->frame_duration = 0;
+    packet->timestamp = 0;
+    packet->sequence = 0;
+    packet->lost_frames = 0;
+    packet->trace = LatencyTrace();
+    packet->payload.clear();
+    return std::unique_ptr<AudioStreamPacket>(packet);
+}
+
+void std::default_delete<AudioStreamPacket>::operator()(AudioStreamPacket* packet) const {
+    if (!audio_stream_packet_pool.Owns(packet)) {
+        delete packet;
+        return;
+    }
+    if (packet->payload.capacity() > AUDIO_STREAM_PACKET_MAX_POOLED_PAYLOAD) {
+        std::vector<uint8_t>().swap(packet->payload);
+    }
+    audio_stream_packet_pool.Release(packet);
+}
+
 void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
     on_incoming_json_ = callback;
 }
@@ -5,15 +5,37 @@
 #include <string>
 #include <functional>
 #include <chrono>
+#include <memory>
 #include <vector>
 
+#include "latency_tracer.h"
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
+    // Transport sequence number, 0 if the transport delivers in order without numbering
+    uint32_t sequence = 0;
+    // Frames found missing right before this packet, set by the jitter buffer
+    int lost_frames = 0;
+    // Latency trace stamps, only set on outgoing voice and incoming server audio
+    LatencyTrace trace;
     std::vector<uint8_t> payload;
+
+    // Takes a packet from a preallocated pool (falls back to the heap when the pool is empty).
+    // Pooled packets keep their payload capacity between uses.
+    static std::unique_ptr<AudioStreamPacket> Create();
 };
 
+// Packets created by AudioStreamPacket::Create() return to the pool instead of being freed,
+// so every std::unique_ptr<AudioStreamPacket> works with both pooled and heap packets.
+namespace std {
+template <>
+struct default_delete<AudioStreamPacket> {
+    void operator()(AudioStreamPacket* packet) const;
+};
+}
+
 struct BinaryProtocol2 {
     uint16_t version;
     uint16_t type;          // Message type (0: OPUS, 1: JSON)
@@ -51,6 +73,10 @@ public:
     inline int server_frame_duration() const {
         return server_frame_duration_;
     }
+    /* The server accepted uplink silence suppression in its hello */
+    inline bool server_dtx() const {
+        return server_dtx_;
+    }
     inline const std::string& session_id() const {
         return session_id_;
     }
@@ -81,6 +107,7 @@ protected:
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    bool server_dtx_ = false;
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
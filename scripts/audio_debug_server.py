@@ -1,54 +1,246 @@
 import socket
+import struct
 import wave
 import argparse
 
 
 '''
-  Create a UDP socket and bind it to the server's IP:8000.
-  Listen for incoming messages and print them to the console.
-  Save the audio to a WAV file.
+  Receive the audio debugger's capture records and save one WAV file per stage.
+
+  Every record is a 32-byte little-endian header followed by the audio payload
+  (see main/audio/processors/audio_debugger.h):
+    magic u16 ("AD"), version u8, stage u8, codec u8, channels u8, flags u8, reserved u8,
+    sample_rate u32, sequence u32, frames u32, payload_size u32, timestamp_us i64
+
+  Sources:
+    udp     listen on a UDP port, one record per datagram (default)
+    serial  read the console UART, skipping the log lines between records (needs pyserial)
+    file    parse a saved serial log or a flash partition dump (parttool.py read_partition)
+
+  Gaps in a stage's sequence numbers are filled with silence, and every stage starts at
+  its first timestamp relative to the first record, so the WAV files line up in time.
 '''
-def main(samplerate, channels):
-    # Create a UDP socket
-    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    server_socket.bind(('0.0.0.0', 8000))
 
-    # Create WAV file with parameters
-    filename = f"{samplerate}_{channels}.wav"
-    wav_file = wave.open(filename, "wb")
-    wav_file.setnchannels(channels)     # channels parameter
-    wav_file.setsampwidth(2)            # 2 bytes per sample (16-bit)
-    wav_file.setframerate(samplerate)   # samplerate parameter
+HEADER = struct.Struct('<HBBBBBBIIIIq')
+MAGIC = 0x4441
+VERSION = 1
+STAGES = ['input', 'processed', 'playback']
+CODEC_PCM16 = 0
+CODEC_IMA_ADPCM = 1
+FLAG_REFERENCE = 0x01
+
+ADPCM_STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+ADPCM_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def payload_size(codec, channels, frames):
+    if codec == CODEC_PCM16:
+        return frames * channels * 2
+    return channels * 4 + (frames * channels + 1) // 2
+
+
+def parse_header(data, offset=0):
+    '''Return the header fields as a dict, or None if the bytes are not a valid header'''
+    if len(data) - offset < HEADER.size:
+        return None
+    (magic, version, stage, codec, channels, flags, _, sample_rate, sequence, frames,
+     size, timestamp_us) = HEADER.unpack_from(data, offset)
+    if magic != MAGIC or version != VERSION or stage >= len(STAGES) or codec > CODEC_IMA_ADPCM:
+        return None
+    if not 1 <= channels <= 4 or not 0 < sample_rate <= 96000 or frames > sample_rate:
+        return None
+    if size != payload_size(codec, channels, frames):
+        return None
+    return dict(stage=stage, codec=codec, channels=channels, flags=flags, sample_rate=sample_rate,
+                sequence=sequence, frames=frames, size=size, timestamp_us=timestamp_us)
+
+
+def decode_adpcm(payload, channels, frames):
+    states = []
+    for c in range(channels):
+        predictor, index = struct.unpack_from('<hB', payload, c * 4)
+        states.append([predictor, index])
+    samples = []
+    codes = payload[channels * 4:]
+    for i in range(frames * channels):
+        code = (codes[i // 2] >> (4 * (i % 2))) & 0x0F
+        state = states[i % channels]
+        step = ADPCM_STEPS[state[1]]
+        delta = step >> 3
+        if code & 4:
+            delta += step
+        if code & 2:
+            delta += step >> 1
+        if code & 1:
+            delta += step >> 2
+        state[0] = max(-32768, min(32767, state[0] - delta if code & 8 else state[0] + delta))
+        state[1] = max(0, min(88, state[1] + ADPCM_INDEX[code]))
+        samples.append(state[0])
+    return struct.pack(f'<{len(samples)}h', *samples)
+
+
+class StageWriter:
+    def __init__(self, prefix, name, header, start_us):
+        self.channels = header['channels']
+        self.sample_rate = header['sample_rate']
+        self.next_sequence = header['sequence']
+        self.frames = 0
+        self.lost = 0
+        # Split the AEC reference (last channel) into a file of its own
+        self.reference = bool(header['flags'] & FLAG_REFERENCE) and self.channels > 1
+        filenames = [f'{prefix}{name}.wav']
+        if self.reference:
+            filenames.append(f'{prefix}{name}_reference.wav')
+        self.files = [self.open(filenames[0], self.channels - 1 if self.reference else self.channels)]
+        if self.reference:
+            self.files.append(self.open(filenames[1], 1))
+        silence = max(0, header['timestamp_us'] - start_us) * self.sample_rate // 1000000
+        self.write_silence(silence)
+        print(f'{name}: {self.sample_rate}Hz {self.channels}ch -> {", ".join(filenames)}')
+
+    def open(self, filename, channels):
+        f = wave.open(filename, 'wb')
+        f.setnchannels(channels)
+        f.setsampwidth(2)
+        f.setframerate(self.sample_rate)
+        return f
+
+    def write_silence(self, frames):
+        for f in self.files:
+            f.writeframes(b'\x00\x00' * frames * f.getnchannels())
+        self.frames += frames
+
+    def write(self, header, pcm):
+        missing = (header['sequence'] - self.next_sequence) & 0xFFFFFFFF
+        if 0 < missing < 0x80000000:
+            self.lost += missing
+            self.write_silence(missing * header['frames'])
+        self.next_sequence = (header['sequence'] + 1) & 0xFFFFFFFF
+        if self.reference:
+            n = self.channels
+            samples = struct.unpack(f'<{len(pcm) // 2}h', pcm)
+            mic = [s for i, s in enumerate(samples) if i % n != n - 1]
+            reference = samples[n - 1::n]
+            self.files[0].writeframes(struct.pack(f'<{len(mic)}h', *mic))
+            self.files[1].writeframes(struct.pack(f'<{len(reference)}h', *reference))
+        else:
+            self.files[0].writeframes(pcm)
+        self.frames += header['frames']
+
+    def close(self):
+        for f in self.files:
+            f.close()
+
 
-    print(f"Start saving audio from 0.0.0.0:8000 to {filename}...")
+class Capture:
+    def __init__(self, prefix):
+        self.prefix = prefix
+        self.writers = {}
+        self.start_us = None
 
+    def add(self, header, payload):
+        if header['codec'] == CODEC_IMA_ADPCM:
+            pcm = decode_adpcm(payload, header['channels'], header['frames'])
+        else:
+            pcm = bytes(payload)
+        if self.start_us is None:
+            self.start_us = header['timestamp_us']
+        stage = header['stage']
+        if stage not in self.writers:
+            self.writers[stage] = StageWriter(self.prefix, STAGES[stage], header, self.start_us)
+        self.writers[stage].write(header, pcm)
+
+    def close(self):
+        for stage, writer in self.writers.items():
+            seconds = writer.frames / writer.sample_rate
+            print(f'{STAGES[stage]}: {seconds:.1f}s, {writer.lost} records lost')
+            writer.close()
+
+
+def parse_stream(buffer, capture):
+    '''Parse every complete record in the buffer, skipping bytes that are not part of one.
+    Returns the number of bytes consumed.'''
+    offset = 0
+    magic = struct.pack('<H', MAGIC)
+    while True:
+        offset = buffer.find(magic, offset)
+        if offset < 0:
+            return max(0, len(buffer) - 1)
+        if len(buffer) - offset < HEADER.size:
+            return offset
+        header = parse_header(buffer, offset)
+        if header is None:
+            offset += 1
+            continue
+        end = offset + HEADER.size + header['size']
+        if end > len(buffer):
+            return offset
+        capture.add(header, buffer[offset + HEADER.size:end])
+        offset = end
+
+
+def receive_udp(port, capture):
+    server_socket = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    server_socket.bind(('0.0.0.0', port))
+    print(f'Start receiving audio capture on 0.0.0.0:{port}...')
     try:
         while True:
-            # Receive a message from the client
-            message, address = server_socket.recvfrom(8000)
-            
-            # Write PCM data to WAV file
-            wav_file.writeframes(message)
-
-            # Print length of the message
-            print(f"Received {len(message)} bytes from {address}")
-    
-    except KeyboardInterrupt:
-        print("\nStopping recording...")
-    
+            message, _ = server_socket.recvfrom(65536)
+            header = parse_header(message)
+            if header is None or len(message) != HEADER.size + header['size']:
+                print(f'Skipping invalid datagram of {len(message)} bytes')
+                continue
+            capture.add(header, message[HEADER.size:])
     finally:
-        # Close files and socket
-        wav_file.close()
         server_socket.close()
-        print(f"WAV file '{filename}' saved successfully")
 
 
-if __name__ == "__main__":
-    parser = argparse.ArgumentParser(description='UDP音频数据接收器，保存为WAV文件')
-    parser.add_argument('--samplerate', '-s', type=int, default=16000, 
-                        help='采样率 (默认: 16000)')
-    parser.add_argument('--channels', '-c', type=int, default=2, 
-                        help='声道数 (默认: 2)')
-    
+def receive_serial(port, baudrate, capture):
+    import serial
+    buffer = bytearray()
+    with serial.Serial(port, baudrate, timeout=0.1) as s:
+        print(f'Start receiving audio capture on {port} at {baudrate} baud...')
+        while True:
+            buffer += s.read(4096)
+            del buffer[:parse_stream(buffer, capture)]
+
+
+def read_file(filename, capture):
+    with open(filename, 'rb') as f:
+        parse_stream(f.read(), capture)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='音频调试数据接收器，按阶段保存为WAV文件')
+    parser.add_argument('--port', '-p', type=int, default=8000,
+                        help='UDP端口 (默认: 8000)')
+    parser.add_argument('--serial', help='从串口读取，例如 /dev/ttyUSB0')
+    parser.add_argument('--baudrate', '-b', type=int, default=2000000,
+                        help='串口波特率 (默认: 2000000)')
+    parser.add_argument('--file', '-f', help='解析保存的串口日志或 Flash 分区数据')
+    parser.add_argument('--output', '-o', default='capture_',
+                        help='WAV文件名前缀 (默认: capture_)')
     args = parser.parse_args()
-    main(args.samplerate, args.channels)
+
+    capture = Capture(args.output)
+    try:
+        if args.file:
+            read_file(args.file, capture)
+        elif args.serial:
+            receive_serial(args.serial, args.baudrate, capture)
+        else:
+            receive_udp(args.port, capture)
+    except KeyboardInterrupt:
+        print('\nStopping recording...')
+    finally:
+        capture.close()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,95 @@
+#include "energy_vad_processor.h"
+
+#include <esp_log.h>
+
+#include <cmath>
+
+#define TAG "EnergyVadProcessor"
+
+EnergyVadProcessor::EnergyVadProcessor(int threshold_dbfs, int hangover_ms) : hangover_ms_(hangover_ms) {
+    double amplitude = 32768.0 * std::pow(10.0, threshold_dbfs / 20.0);
+    threshold_ = (int64_t)(amplitude * amplitude);
+}
+
+void EnergyVadProcessor::Initialize(AudioCodec* codec, int frame_duration_ms) {
+    codec_ = codec;
+    SetFrameDuration(frame_duration_ms);
+}
+
+void EnergyVadProcessor::SetFrameDuration(int frame_duration_ms) {
+    frame_duration_ms_ = frame_duration_ms;
+    frame_samples_ = frame_duration_ms * 16000 / 1000 * codec_->input_channels();
+}
+
+void EnergyVadProcessor::Feed(std::vector<int16_t>&& data) {
+    if (!is_running_ || !output_callback_) {
+        return;
+    }
+    if (data.size() != frame_samples_) {
+        ESP_LOGE(TAG, "Feed data size is not equal to frame size, feed size: %zu, frame size: %zu", data.size(), frame_samples_);
+        return;
+    }
+
+    if (codec_->input_channels() == 2) {
+        size_t frames = data.size() / 2;
+        for (size_t i = 0; i < frames; i++) {
+            data[i] = data[i * 2];
+        }
+        data.resize(frames);
+    }
+
+    int64_t energy = 0;
+    for (auto sample : data) {
+        energy += (int32_t)sample * sample;
+    }
+    bool loud = !data.empty() && energy / (int64_t)data.size() >= threshold_;
+    silence_ms_ = loud ? 0 : silence_ms_ + frame_duration_ms_;
+    bool speaking = loud || (speaking_ && silence_ms_ < hangover_ms_);
+    if (speaking != speaking_) {
+        speaking_ = speaking;
+        if (vad_state_change_callback_) {
+            vad_state_change_callback_(speaking);
+        }
+    }
+    output_callback_(std::move(data));
+}
+
+void EnergyVadProcessor::Start() {
+    is_running_ = true;
+}
+
+void EnergyVadProcessor::Stop() {
+    is_running_ = false;
+    if (speaking_) {
+        speaking_ = false;
+        if (vad_state_change_callback_) {
+            vad_state_change_callback_(false);
+        }
+    }
+}
+
+bool EnergyVadProcessor::IsRunning() {
+    return is_running_;
+}
+
+void EnergyVadProcessor::OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) {
+    output_callback_ = callback;
+}
+
+void EnergyVadProcessor::OnVadStateChange(std::function<void(bool speaking)> callback) {
+    vad_state_change_callback_ = callback;
+}
+
+size_t EnergyVadProcessor::GetFeedSize() {
+    return codec_ != nullptr ? frame_samples_ : 0;
+}
+
+bool EnergyVadProcessor::IsVadEnabled() {
+    return true;
+}
+
+void EnergyVadProcessor::EnableDeviceAec(bool enable) {
+    if (enable) {
+        ESP_LOGW(TAG, "Device AEC is not simulated");
+    }
+}
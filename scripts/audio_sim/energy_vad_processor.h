@@ -0,0 +1,43 @@
+#ifndef ENERGY_VAD_PROCESSOR_H
+#define ENERGY_VAD_PROCESSOR_H
+
+#include <functional>
+#include <vector>
+
+#include "audio_processor.h"
+
+/*
+ * Passes the microphone channel through like NoAudioProcessor, and reports voice activity from
+ * the frame energy: speech starts with the first frame above the threshold and ends after
+ * `hangover_ms` of frames below it. Stands in for the AFE, whose VAD needs the ESP-SR models.
+ */
+class EnergyVadProcessor : public AudioProcessor {
+public:
+    EnergyVadProcessor(int threshold_dbfs, int hangover_ms);
+
+    void Initialize(AudioCodec* codec, int frame_duration_ms) override;
+    void SetFrameDuration(int frame_duration_ms) override;
+    void Feed(std::vector<int16_t>&& data) override;
+    void Start() override;
+    void Stop() override;
+    bool IsRunning() override;
+    void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void OnVadStateChange(std::function<void(bool speaking)> callback) override;
+    bool IsVadEnabled() override;
+    size_t GetFeedSize() override;
+    void EnableDeviceAec(bool enable) override;
+
+private:
+    AudioCodec* codec_ = nullptr;
+    int frame_duration_ms_ = 0;
+    size_t frame_samples_ = 0;
+    int64_t threshold_;          // Mean square sample value at the threshold
+    int hangover_ms_;
+    int silence_ms_ = 0;
+    bool speaking_ = false;
+    bool is_running_ = false;
+    std::function<void(std::vector<int16_t>&& data)> output_callback_;
+    std::function<void(bool speaking)> vad_state_change_callback_;
+};
+
+#endif // ENERGY_VAD_PROCESSOR_H
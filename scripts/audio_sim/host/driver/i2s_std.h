@@ -0,0 +1,29 @@
+#ifndef DRIVER_I2S_STD_H
+#define DRIVER_I2S_STD_H
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+/* AudioCodec keeps I2S channel handles; host codecs leave them null, so these are never reached */
+typedef struct i2s_channel_obj_t* i2s_chan_handle_t;
+
+typedef enum {
+    I2S_CLK_SRC_DEFAULT,
+} i2s_clock_src_t;
+
+typedef enum {
+    I2S_MCLK_MULTIPLE_256 = 256,
+} i2s_mclk_multiple_t;
+
+typedef struct {
+    uint32_t sample_rate_hz;
+    i2s_clock_src_t clk_src;
+    i2s_mclk_multiple_t mclk_multiple;
+} i2s_std_clk_config_t;
+
+inline esp_err_t i2s_channel_enable(i2s_chan_handle_t handle) { return ESP_OK; }
+inline esp_err_t i2s_channel_disable(i2s_chan_handle_t handle) { return ESP_OK; }
+inline esp_err_t i2s_channel_reconfig_std_clock(i2s_chan_handle_t handle, const i2s_std_clk_config_t* config) { return ESP_OK; }
+
+#endif // DRIVER_I2S_STD_H
@@ -0,0 +1,25 @@
+#ifndef ESP_ERR_H
+#define ESP_ERR_H
+
+#include <cstdio>
+#include <cstdlib>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_STATE 0x103
+
+inline const char* esp_err_to_name(esp_err_t err) {
+    return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+#define ESP_ERROR_CHECK(x) do {                                         \
+        esp_err_t err_rc_ = (x);                                        \
+        if (err_rc_ != ESP_OK) {                                        \
+            fprintf(stderr, "%s failed at %s:%d\n", #x, __FILE__, __LINE__); \
+            abort();                                                    \
+        }                                                               \
+    } while (0)
+
+#endif // ESP_ERR_H
@@ -0,0 +1,22 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+#include <cstddef>
+#include <cstdlib>
+
+#define MALLOC_CAP_8BIT (1 << 2)
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_DEFAULT (1 << 12)
+
+/* One heap on the host */
+inline void* heap_caps_malloc(size_t size, unsigned int caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+#endif // ESP_HEAP_CAPS_H
@@ -0,0 +1,28 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+#include "esp_err.h"
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+/*
+ * Prints "<level> (<simulated ms>) <tag>: <message>" to stderr, like the device console. No
+ * format checking: the firmware formats uint32_t with %lu, which is right on the device only.
+ */
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...);
+void esp_log_level_set(const char* tag, esp_log_level_t level);
+
+#define ESP_LOGE(tag, format, ...) esp_log_write(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_write(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_write(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_write(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_write(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#endif // ESP_LOG_H
@@ -0,0 +1,7 @@
+#ifndef ESP_PARTITION_H
+#define ESP_PARTITION_H
+
+/* Only the type, for the audio debugger's header; the debugger itself is not built for the host */
+typedef struct esp_partition esp_partition_t;
+
+#endif // ESP_PARTITION_H
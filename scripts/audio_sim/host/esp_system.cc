@@ -0,0 +1,104 @@
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "host_clock.h"
+
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+static std::mutex log_mutex;
+static esp_log_level_t default_log_level = ESP_LOG_INFO;
+static std::map<std::string, esp_log_level_t> tag_log_levels;
+
+void esp_log_level_set(const char* tag, esp_log_level_t level) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (std::string(tag) == "*") {
+        default_log_level = level;
+        tag_log_levels.clear();
+    } else {
+        tag_log_levels[tag] = level;
+    }
+}
+
+void esp_log_write(esp_log_level_t level, const char* tag, const char* format, ...) {
+    static const char letters[] = "NEWIDV";
+    std::lock_guard<std::mutex> lock(log_mutex);
+    auto it = tag_log_levels.find(tag);
+    if (level > (it != tag_log_levels.end() ? it->second : default_log_level)) {
+        return;
+    }
+    fprintf(stderr, "%c (%lld) %s: ", letters[level], (long long)(host_clock::NowUs() / 1000), tag);
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+int64_t esp_timer_get_time() {
+    return host_clock::NowUs();
+}
+
+struct esp_timer {
+    esp_timer_create_args_t args;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint64_t period_us = 0;
+    uint32_t generation = 0;    // Bumped on every start and stop, ends the thread of the previous start
+};
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle) {
+    auto timer = new esp_timer();
+    timer->args = *args;
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->period_us != 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->period_us = period_us;
+    uint32_t generation = ++timer->generation;
+    std::thread([timer, generation, period_us]() {
+        int64_t next_us = host_clock::NowUs() + period_us;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(timer->mutex);
+                timer->cv.wait_for(lock, host_clock::ToReal(next_us - host_clock::NowUs()),
+                    [timer, generation]() { return timer->generation != generation; });
+                if (timer->generation != generation) {
+                    return;
+                }
+            }
+            if (host_clock::NowUs() < next_us) {
+                continue;
+            }
+            next_us += period_us;
+            timer->args.callback(timer->args.arg);
+        }
+    }).detach();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+    std::lock_guard<std::mutex> lock(timer->mutex);
+    if (timer->period_us == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->period_us = 0;
+    timer->generation++;
+    timer->cv.notify_all();
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+    esp_timer_stop(timer);
+    /* Leaked on purpose: a callback thread may still be about to look at it */
+    return ESP_OK;
+}
@@ -0,0 +1,32 @@
+#ifndef ESP_TIMER_H
+#define ESP_TIMER_H
+
+#include <cstdint>
+
+#include "esp_err.h"
+
+typedef struct esp_timer* esp_timer_handle_t;
+typedef void (*esp_timer_cb_t)(void* arg);
+
+typedef enum {
+    ESP_TIMER_TASK,
+} esp_timer_dispatch_t;
+
+typedef struct {
+    esp_timer_cb_t callback;
+    void* arg;
+    esp_timer_dispatch_t dispatch_method;
+    const char* name;
+    bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+/* Simulated time, see host_clock.h */
+int64_t esp_timer_get_time();
+
+/* Every timer runs its callback on a thread of its own */
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out_handle);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+
+#endif // ESP_TIMER_H
@@ -0,0 +1,205 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "host_clock.h"
+
+#include <pthread.h>
+#include <time.h>
+
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+struct HostTask {
+    std::string name;
+    std::mutex mutex;
+    std::condition_variable cv;
+    uint32_t notifications[configTASK_NOTIFICATION_ARRAY_ENTRIES] = {};
+    std::atomic<eTaskState> state{eReady};
+    pthread_t thread = 0;
+    int64_t final_cpu_us = 0;   // Set when the thread ends, its CPU clock is gone after that
+};
+
+struct HostEventGroup {
+    std::mutex mutex;
+    std::condition_variable cv;
+    EventBits_t bits = 0;
+};
+
+static std::mutex tasks_mutex;
+static std::vector<std::shared_ptr<HostTask>> tasks;
+static thread_local HostTask* current_task = nullptr;
+
+static int64_t ThreadCpuUs(clockid_t clock) {
+    struct timespec ts;
+    if (clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static HostTask* RegisterTask(const char* name) {
+    auto task = std::make_shared<HostTask>();
+    task->name = name;
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    tasks.push_back(task);
+    return task.get();
+}
+
+/* Waits on `cv` for up to `ticks` of simulated time, or forever with portMAX_DELAY */
+template <typename Predicate>
+static bool WaitTicks(std::condition_variable& cv, std::unique_lock<std::mutex>& lock, TickType_t ticks, Predicate predicate) {
+    if (ticks == portMAX_DELAY) {
+        cv.wait(lock, predicate);
+        return true;
+    }
+    return cv.wait_for(lock, host_clock::ToReal((int64_t)ticks * 1000), predicate);
+}
+
+static TaskHandle_t StartTask(TaskFunction_t function, const char* name, void* arg) {
+    HostTask* task = RegisterTask(name);
+    /* The handle is valid before the task runs, as with FreeRTOS */
+    std::thread thread([task, function, arg]() {
+        current_task = task;
+        task->state = eRunning;
+        function(arg);
+        /* Under the lock, so HostTaskCpuTimes() never reads the clock of a thread that is gone */
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        task->final_cpu_us = ThreadCpuUs(CLOCK_THREAD_CPUTIME_ID);
+        task->state = eDeleted;
+    });
+    task->thread = thread.native_handle();
+    thread.detach();
+    return task;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id) {
+    TaskHandle_t task = StartTask(function, name, arg);
+    if (created_task != nullptr) {
+        *created_task = task;
+    }
+    return pdPASS;
+}
+
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, StackType_t* stack, StaticTask_t* task_buffer, BaseType_t core_id) {
+    return StartTask(function, name, arg);
+}
+
+void vTaskDelete(TaskHandle_t task) {
+    if (task == nullptr || task == current_task) {
+        /* The thread marks itself deleted once the task function has returned */
+        return;
+    }
+    /* A thread cannot be stopped from outside; one that is blocked stays parked where it is */
+    if (task->state != eBlocked) {
+        fprintf(stderr, "vTaskDelete of a running task is not supported on the host, ignoring %s\n", task->name.c_str());
+        return;
+    }
+    task->state = eDeleted;
+}
+
+void vTaskDelay(TickType_t ticks) {
+    std::this_thread::sleep_for(host_clock::ToReal((int64_t)ticks * 1000));
+}
+
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority) {
+}
+
+TickType_t xTaskGetTickCount() {
+    return (TickType_t)(host_clock::NowUs() / 1000);
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    if (current_task == nullptr) {
+        current_task = RegisterTask("host_thread");
+        current_task->thread = pthread_self();
+        current_task->state = eRunning;
+    }
+    return current_task;
+}
+
+eTaskState eTaskGetState(TaskHandle_t task) {
+    return task != nullptr ? task->state.load() : eInvalid;
+}
+
+void xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index) {
+    if (task == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(task->mutex);
+    task->notifications[index]++;
+    task->cv.notify_all();
+}
+
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+    HostTask* task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> lock(task->mutex);
+    uint32_t& notification = task->notifications[index];
+    task->state = eBlocked;
+    WaitTicks(task->cv, lock, ticks_to_wait, [&notification]() { return notification > 0; });
+    task->state = eRunning;
+    uint32_t value = notification;
+    if (value > 0) {
+        notification = clear_count_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+std::vector<HostTaskCpuTime> HostTaskCpuTimes() {
+    std::vector<HostTaskCpuTime> times;
+    std::lock_guard<std::mutex> lock(tasks_mutex);
+    for (auto& task : tasks) {
+        bool running = task->state != eDeleted;
+        int64_t cpu_us = task->final_cpu_us;
+        clockid_t clock;
+        if (running && task->thread != 0 && pthread_getcpuclockid(task->thread, &clock) == 0) {
+            cpu_us = ThreadCpuUs(clock);
+        }
+        times.push_back({task->name, cpu_us, running});
+    }
+    return times;
+}
+
+EventGroupHandle_t xEventGroupCreate() {
+    return new HostEventGroup();
+}
+
+void vEventGroupDelete(EventGroupHandle_t group) {
+    delete group;
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    group->bits |= bits;
+    group->cv.notify_all();
+    return group->bits;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    EventBits_t previous = group->bits;
+    group->bits &= ~bits;
+    return previous;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group) {
+    std::lock_guard<std::mutex> lock(group->mutex);
+    return group->bits;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all_bits, TickType_t ticks_to_wait) {
+    std::unique_lock<std::mutex> lock(group->mutex);
+    auto satisfied = [group, bits, wait_for_all_bits]() {
+        return wait_for_all_bits ? (group->bits & bits) == bits : (group->bits & bits) != 0;
+    };
+    bool ok = WaitTicks(group->cv, lock, ticks_to_wait, satisfied);
+    EventBits_t value = group->bits;
+    if (ok && clear_on_exit) {
+        group->bits &= ~bits;
+    }
+    return value;
+}
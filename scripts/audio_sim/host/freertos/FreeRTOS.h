@@ -0,0 +1,43 @@
+#ifndef FREERTOS_H
+#define FREERTOS_H
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <thread>
+
+#include "sdkconfig.h"
+
+/* A 1 kHz tick on the simulated clock */
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+#define pdFALSE ((BaseType_t)0)
+#define pdTRUE ((BaseType_t)1)
+#define pdPASS pdTRUE
+#define pdFAIL pdFALSE
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+#define portTICK_PERIOD_MS 1
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define tskNO_AFFINITY ((BaseType_t)0x7FFFFFFF)
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES
+
+/* Critical sections become a spinlock, which is what they are on the dual-core targets */
+struct portMUX_TYPE {
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+#define portMUX_INITIALIZER_UNLOCKED {}
+
+inline void portENTER_CRITICAL(portMUX_TYPE* mux) {
+    while (mux->flag.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+    }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE* mux) {
+    mux->flag.clear(std::memory_order_release);
+}
+
+#endif // FREERTOS_H
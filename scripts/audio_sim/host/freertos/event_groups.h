@@ -0,0 +1,19 @@
+#ifndef FREERTOS_EVENT_GROUPS_H
+#define FREERTOS_EVENT_GROUPS_H
+
+#include <cstdint>
+
+#include "FreeRTOS.h"
+
+typedef struct HostEventGroup* EventGroupHandle_t;
+typedef uint32_t EventBits_t;
+
+EventGroupHandle_t xEventGroupCreate();
+void vEventGroupDelete(EventGroupHandle_t group);
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits);
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group);
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+    BaseType_t wait_for_all_bits, TickType_t ticks_to_wait);
+
+#endif // FREERTOS_EVENT_GROUPS_H
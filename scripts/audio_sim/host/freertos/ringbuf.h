@@ -0,0 +1,7 @@
+#ifndef FREERTOS_RINGBUF_H
+#define FREERTOS_RINGBUF_H
+
+/* Only the type, for the audio debugger's header; the debugger itself is not built for the host */
+typedef struct HostRingbuffer* RingbufHandle_t;
+
+#endif // FREERTOS_RINGBUF_H
@@ -0,0 +1,77 @@
+#ifndef FREERTOS_TASK_H
+#define FREERTOS_TASK_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FreeRTOS.h"
+
+/*
+ * Tasks are detached threads. Priorities and core affinity are ignored, so the host scheduler
+ * decides what runs, and the stack buffers of static tasks are left unused. Threads that were
+ * not created here (the harness's main thread, for instance) get a task the first time they ask
+ * for their handle, so they can block on notifications like any task.
+ */
+typedef struct HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void* arg);
+
+struct StaticTask_t {
+    uint8_t reserved[16];
+};
+
+typedef enum {
+    eRunning,
+    eReady,
+    eBlocked,
+    eSuspended,
+    eDeleted,
+    eInvalid,
+} eTaskState;
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, TaskHandle_t* created_task, BaseType_t core_id);
+TaskHandle_t xTaskCreateStaticPinnedToCore(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, StackType_t* stack, StaticTask_t* task_buffer, BaseType_t core_id);
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, TaskHandle_t* created_task) {
+    return xTaskCreatePinnedToCore(function, name, stack_depth, arg, priority, created_task, tskNO_AFFINITY);
+}
+
+inline TaskHandle_t xTaskCreateStatic(TaskFunction_t function, const char* name, uint32_t stack_depth, void* arg,
+    UBaseType_t priority, StackType_t* stack, StaticTask_t* task_buffer) {
+    return xTaskCreateStaticPinnedToCore(function, name, stack_depth, arg, priority, stack, task_buffer, tskNO_AFFINITY);
+}
+
+/*
+ * A task deleting itself is marked deleted and its thread ends when the function returns. Another
+ * task can only be deleted while it waits for a notification; its thread is left parked.
+ */
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(TickType_t ticks);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+TickType_t xTaskGetTickCount();
+TaskHandle_t xTaskGetCurrentTaskHandle();
+eTaskState eTaskGetState(TaskHandle_t task);
+
+void xTaskNotifyGiveIndexed(TaskHandle_t task, UBaseType_t index);
+uint32_t ulTaskNotifyTakeIndexed(UBaseType_t index, BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+    xTaskNotifyGiveIndexed(task, 0);
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait) {
+    return ulTaskNotifyTakeIndexed(0, clear_count_on_exit, ticks_to_wait);
+}
+
+/* Host only: CPU time used by every task created so far, for the harness report */
+struct HostTaskCpuTime {
+    std::string name;
+    int64_t cpu_us;
+    bool running;
+};
+std::vector<HostTaskCpuTime> HostTaskCpuTimes();
+
+#endif // FREERTOS_TASK_H
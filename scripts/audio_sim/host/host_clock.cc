@@ -0,0 +1,35 @@
+#include "host_clock.h"
+
+#include <atomic>
+#include <thread>
+
+namespace host_clock {
+
+static const auto start_time = std::chrono::steady_clock::now();
+static std::atomic<double> clock_speed{1.0};
+
+void SetSpeed(double speed) {
+    clock_speed = speed > 0 ? speed : 1.0;
+}
+
+double speed() {
+    return clock_speed;
+}
+
+int64_t NowUs() {
+    auto elapsed = std::chrono::steady_clock::now() - start_time;
+    return (int64_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() * clock_speed / 1000);
+}
+
+std::chrono::nanoseconds ToReal(int64_t us) {
+    return std::chrono::nanoseconds((int64_t)(us * 1000 / clock_speed));
+}
+
+void SleepUntilUs(int64_t us) {
+    int64_t now = NowUs();
+    if (us > now) {
+        std::this_thread::sleep_for(ToReal(us - now));
+    }
+}
+
+}
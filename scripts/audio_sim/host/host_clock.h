@@ -0,0 +1,27 @@
+#ifndef HOST_CLOCK_H
+#define HOST_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+/*
+ * Simulated time for the host build.
+ *
+ * esp_timer_get_time(), the FreeRTOS tick count and every timeout run on this clock, which
+ * advances `speed` times faster than the wall clock. The WAV codec paces the microphone and the
+ * speaker on it too, so the whole pipeline runs at the same accelerated rate and the frame
+ * budgets shrink with it.
+ */
+namespace host_clock {
+
+void SetSpeed(double speed);
+double speed();
+/* Microseconds of simulated time since start */
+int64_t NowUs();
+/* Wall-clock duration of `us` simulated microseconds */
+std::chrono::nanoseconds ToReal(int64_t us);
+void SleepUntilUs(int64_t us);
+
+}
+
+#endif // HOST_CLOCK_H
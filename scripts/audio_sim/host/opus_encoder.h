@@ -0,0 +1,11 @@
+#ifndef OPUS_ENCODER_H
+#define OPUS_ENCODER_H
+
+/*
+ * Stands in for the esp-opus-encoder component's header, which audio_service.h includes for the
+ * wake word encoders. The conversation stream uses OpusStreamEncoder / OpusStreamDecoder on
+ * plain libopus, and the wake words are not part of the host build.
+ */
+#include <opus.h>
+
+#endif // OPUS_ENCODER_H
@@ -0,0 +1,33 @@
+#include "opus_resampler.h"
+
+void OpusResampler::Configure(int input_sample_rate, int output_sample_rate) {
+    input_sample_rate_ = input_sample_rate;
+    output_sample_rate_ = output_sample_rate;
+    position_ = 0;
+    consumed_ = 0;
+    last_ = 0;
+}
+
+int OpusResampler::GetOutputSamples(int input_samples) const {
+    return (int64_t)input_samples * output_sample_rate_ / input_sample_rate_;
+}
+
+void OpusResampler::Process(const int16_t* input, int input_samples, int16_t* output) {
+    int output_samples = GetOutputSamples(input_samples);
+    for (int i = 0; i < output_samples; i++, position_++) {
+        /* Source position in 1/65536 input samples, relative to the first sample of this call */
+        int64_t source = (position_ * input_sample_rate_ << 16) / output_sample_rate_ - (consumed_ << 16);
+        int64_t index = source >> 16;
+        int fraction = source & 0xFFFF;
+        int a = index < 0 ? last_ : input[index < input_samples ? index : input_samples - 1];
+        int b = index + 1 < input_samples ? input[index + 1] : input[input_samples - 1];
+        if (index < 0) {
+            b = input[0];
+        }
+        output[i] = (int16_t)(a + (((b - a) * fraction) >> 16));
+    }
+    consumed_ += input_samples;
+    if (input_samples > 0) {
+        last_ = input[input_samples - 1];
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef OPUS_RESAMPLER_H
+#define OPUS_RESAMPLER_H
+
+#include <cstdint>
+
+/*
+ * Same interface as the esp-opus-encoder component's resampler, which wraps the SILK resampler
+ * that libopus does not export. This one interpolates linearly, keeping its phase across calls,
+ * which is close enough for timing and levels but not for judging audio quality.
+ */
+class OpusResampler {
+public:
+    OpusResampler() = default;
+    ~OpusResampler() = default;
+
+    void Configure(int input_sample_rate, int output_sample_rate);
+    void Process(const int16_t* input, int input_samples, int16_t* output);
+    int GetOutputSamples(int input_samples) const;
+
+    int input_sample_rate() const { return input_sample_rate_; }
+    int output_sample_rate() const { return output_sample_rate_; }
+
+private:
+    int input_sample_rate_ = 0;
+    int output_sample_rate_ = 0;
+    int64_t position_ = 0;   // Output samples produced, to place the next one between input samples
+    int64_t consumed_ = 0;   // Input samples seen before the current call
+    int16_t last_ = 0;
+};
+
+#endif // OPUS_RESAMPLER_H
@@ -0,0 +1,18 @@
+#ifndef SDKCONFIG_H
+#define SDKCONFIG_H
+
+/* The configuration the simulated AudioService is built with */
+#define CONFIG_FREERTOS_NUMBER_OF_CORES 2
+#define CONFIG_FREERTOS_TASK_NOTIFICATION_ARRAY_ENTRIES 2
+#define CONFIG_OPUS_FRAME_DURATION_MS 60
+#define CONFIG_OPUS_DECODE_TASK_PRIORITY 2
+#define CONFIG_OPUS_DECODE_TASK_CORE -1
+#define CONFIG_OPUS_ENCODE_TASK_PRIORITY 2
+#define CONFIG_OPUS_ENCODE_TASK_CORE -1
+#define CONFIG_OPUS_MAX_COMPLEXITY 5
+#define CONFIG_OPUS_TASK_STACK_IN_PSRAM 1
+#define CONFIG_USE_AUDIO_LATENCY_TRACE 1
+#define CONFIG_USE_SOUND_CACHE 1
+#define CONFIG_SOUND_CACHE_SIZE_KB 512
+
+#endif // SDKCONFIG_H
@@ -0,0 +1,58 @@
+#include "settings.h"
+
+#include <map>
+#include <mutex>
+
+static std::mutex settings_mutex;
+static std::map<std::string, std::string> strings;
+static std::map<std::string, int32_t> ints;
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
+}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    std::lock_guard<std::mutex> lock(settings_mutex);
+    auto it = strings.find(ns_ + "." + key);
+    return it != strings.end() ? it->second : default_value;
+}
+
+void Settings::SetString(const std::string& key, const std::string& value) {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(settings_mutex);
+        strings[ns_ + "." + key] = value;
+    }
+}
+
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
+    std::lock_guard<std::mutex> lock(settings_mutex);
+    auto it = ints.find(ns_ + "." + key);
+    return it != ints.end() ? it->second : default_value;
+}
+
+void Settings::SetInt(const std::string& key, int32_t value) {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(settings_mutex);
+        ints[ns_ + "." + key] = value;
+    }
+}
+
+void Settings::EraseKey(const std::string& key) {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(settings_mutex);
+        strings.erase(ns_ + "." + key);
+        ints.erase(ns_ + "." + key);
+    }
+}
+
+void Settings::EraseAll() {
+    if (read_write_) {
+        std::lock_guard<std::mutex> lock(settings_mutex);
+        std::string prefix = ns_ + ".";
+        for (auto it = strings.begin(); it != strings.end(); ) {
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? strings.erase(it) : std::next(it);
+        }
+        for (auto it = ints.begin(); it != ints.end(); ) {
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? ints.erase(it) : std::next(it);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <cstdint>
+#include <string>
+
+/* In-memory settings, shared by all namespaces for the life of the process */
+class Settings {
+public:
+    Settings(const std::string& ns, bool read_write = false);
+    ~Settings() = default;
+
+    std::string GetString(const std::string& key, const std::string& default_value = "");
+    void SetString(const std::string& key, const std::string& value);
+    int32_t GetInt(const std::string& key, int32_t default_value = 0);
+    void SetInt(const std::string& key, int32_t value);
+    void EraseKey(const std::string& key);
+    void EraseAll();
+
+private:
+    std::string ns_;
+    bool read_write_ = false;
+};
+
+#endif // SETTINGS_H
@@ -0,0 +1,129 @@
+#include "loopback_protocol.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#define TAG "LoopbackProtocol"
+
+LoopbackProtocol::LoopbackProtocol(const NetworkConditions& conditions, int frame_duration, bool server_dtx)
+    : conditions_(conditions), server_dtx_requested_(server_dtx), random_(conditions.seed) {
+    server_frame_duration_ = frame_duration;
+    server_sample_rate_ = 16000;
+}
+
+LoopbackProtocol::~LoopbackProtocol() {
+    CloseAudioChannel();
+}
+
+bool LoopbackProtocol::Start() {
+    return true;
+}
+
+bool LoopbackProtocol::OpenAudioChannel() {
+    if (opened_) {
+        return true;
+    }
+    server_dtx_ = server_dtx_requested_;
+    session_id_ = "loopback";
+    last_incoming_time_ = std::chrono::steady_clock::now();
+    opened_ = true;
+    xTaskCreate([](void* arg) {
+        auto protocol = (LoopbackProtocol*)arg;
+        protocol->NetworkTask();
+        vTaskDelete(NULL);
+    }, "loopback_network", 4096, this, 5, &network_task_);
+
+    if (on_audio_channel_opened_) {
+        on_audio_channel_opened_();
+    }
+    return true;
+}
+
+void LoopbackProtocol::CloseAudioChannel() {
+    if (!opened_.exchange(false)) {
+        return;
+    }
+    xTaskNotifyGive(network_task_);
+    while (eTaskGetState(network_task_) != eDeleted) {
+        vTaskDelay(1);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (!in_flight_.empty()) {
+        in_flight_.pop();
+    }
+    if (on_audio_channel_closed_) {
+        on_audio_channel_closed_();
+    }
+}
+
+bool LoopbackProtocol::IsAudioChannelOpened() const {
+    return opened_;
+}
+
+bool LoopbackProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+    if (!opened_) {
+        return false;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        statistics_.sent_packets++;
+        statistics_.sent_bytes += packet->payload.size();
+        if (packet->payload.size() <= 1) {
+            statistics_.dtx_packets++;
+        }
+        packet->sequence = ++sequence_;
+        if (conditions_.loss_percent > 0 && (int)(random_() % 100) < conditions_.loss_percent) {
+            statistics_.dropped_packets++;
+            return true;
+        }
+        int delay_ms = conditions_.delay_ms;
+        if (conditions_.jitter_ms > 0) {
+            delay_ms += random_() % (conditions_.jitter_ms + 1);
+        }
+        int64_t deliver_us = esp_timer_get_time() + delay_ms * 1000LL;
+        in_flight_.push({deliver_us, sequence_, std::move(packet)});
+    }
+    xTaskNotifyGive(network_task_);
+    return true;
+}
+
+LoopbackStatistics LoopbackProtocol::statistics() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return statistics_;
+}
+
+void LoopbackProtocol::NetworkTask() {
+    while (opened_) {
+        std::unique_ptr<AudioStreamPacket> packet;
+        TickType_t wait = portMAX_DELAY;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!in_flight_.empty()) {
+                int64_t due_us = in_flight_.top().deliver_us - esp_timer_get_time();
+                if (due_us <= 0) {
+                    /* The queue only hands out const references, the packet is moved out before the pop */
+                    packet = std::move(const_cast<InFlight&>(in_flight_.top()).packet);
+                    in_flight_.pop();
+                    statistics_.delivered_packets++;
+                } else {
+                    wait = std::max<TickType_t>(pdMS_TO_TICKS((due_us + 999) / 1000), 1);
+                }
+            }
+        }
+        if (!packet) {
+            ulTaskNotifyTake(pdTRUE, wait);
+            continue;
+        }
+        last_incoming_time_ = std::chrono::steady_clock::now();
+        if (on_incoming_audio_) {
+            on_incoming_audio_(std::move(packet));
+        }
+    }
+}
+
+bool LoopbackProtocol::SendText(const std::string& text) {
+    ESP_LOGD(TAG, "Text: %s", text.c_str());
+    return true;
+}
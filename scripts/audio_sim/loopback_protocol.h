@@ -0,0 +1,77 @@
+#ifndef LOOPBACK_PROTOCOL_H
+#define LOOPBACK_PROTOCOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "protocol.h"
+
+/* One-way network conditions, applied to every uplink packet on its way back */
+struct NetworkConditions {
+    int delay_ms = 40;
+    int jitter_ms = 0;       // Extra delay drawn uniformly from [0, jitter_ms], so packets may be reordered
+    int loss_percent = 0;
+    uint32_t seed = 1;       // The same seed drops and delays the same packets on every run
+};
+
+struct LoopbackStatistics {
+    uint32_t sent_packets = 0;
+    uint64_t sent_bytes = 0;
+    uint32_t dtx_packets = 0;       // One-byte packets sent during uplink silence
+    uint32_t dropped_packets = 0;
+    uint32_t delivered_packets = 0;
+};
+
+/*
+ * A server that echoes the uplink audio back as downlink audio.
+ *
+ * Every packet sent is numbered, then dropped or delayed by the network conditions and handed
+ * to the incoming audio callback by a task of its own, as a transport with sequence numbers
+ * would (so the jitter buffer sees losses and reordering). The server hello is simulated by
+ * OpenAudioChannel(): it echoes the frame duration and, if asked to, accepts uplink DTX.
+ */
+class LoopbackProtocol : public Protocol {
+public:
+    LoopbackProtocol(const NetworkConditions& conditions, int frame_duration, bool server_dtx);
+    ~LoopbackProtocol();
+
+    bool Start() override;
+    bool OpenAudioChannel() override;
+    void CloseAudioChannel() override;
+    bool IsAudioChannelOpened() const override;
+    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    LoopbackStatistics statistics() const;
+
+private:
+    struct InFlight {
+        int64_t deliver_us;
+        uint32_t order;      // Send order, so packets due at the same time keep it
+        std::unique_ptr<AudioStreamPacket> packet;
+
+        bool operator>(const InFlight& other) const {
+            return deliver_us != other.deliver_us ? deliver_us > other.deliver_us : order > other.order;
+        }
+    };
+
+    NetworkConditions conditions_;
+    bool server_dtx_requested_;
+    std::atomic<bool> opened_{false};
+    TaskHandle_t network_task_ = nullptr;
+    mutable std::mutex mutex_;
+    std::priority_queue<InFlight, std::vector<InFlight>, std::greater<InFlight>> in_flight_;
+    std::mt19937 random_;
+    uint32_t sequence_ = 0;
+    LoopbackStatistics statistics_;
+
+    void NetworkTask();
+    bool SendText(const std::string& text) override;
+};
+
+#endif // LOOPBACK_PROTOCOL_H
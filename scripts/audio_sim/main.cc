@@ -0,0 +1,398 @@
+/*
+ * Runs AudioService on the host: a WAV file is the microphone, the uplink packets are echoed
+ * back through a simulated network as the downlink, and the speaker output is recorded. At the
+ * end a JSON report of the frame counters, queue depths, latencies and per-task CPU time is
+ * printed, so changes to the audio pipeline can be compared run against run without a device.
+ */
+#include "audio_service.h"
+#include "energy_vad_processor.h"
+#include "host_clock.h"
+#include "loopback_protocol.h"
+#include "wav_audio_codec.h"
+#include "wav_file.h"
+
+#include <cJSON.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+#define TAG "AudioSim"
+
+#define MUSIC_CHUNK_MS 60
+#define QUEUE_SAMPLE_INTERVAL_MS 20
+
+struct Options {
+    std::string mic;
+    std::string speaker;
+    std::string music;
+    std::string report;
+    double speed = 1.0;
+    int frame_duration = OPUS_FRAME_DURATION_MS;
+    int output_rate = 24000;
+    NetworkConditions network;
+    bool dtx = false;
+    int vad_threshold = -45;
+    int vad_hangover = 600;
+    int tail_ms = 2000;
+    esp_log_level_t log_level = ESP_LOG_WARN;
+};
+
+static void PrintUsage(const char* program) {
+    fprintf(stderr,
+        "Usage: %s --mic <in.wav> [options]\n"
+        "  --speaker <out.wav>      Record the speaker output\n"
+        "  --music <music.wav>      Play a WAV file on the music channel at the same time\n"
+        "  --report <report.json>   Write the report to a file instead of stdout\n"
+        "  --speed <x>              Run the simulated clock x times faster than real time (default 1)\n"
+        "  --frame-duration <ms>    Frame duration the server asks for: 20, 40 or 60 (default %d)\n"
+        "  --output-rate <hz>       Codec output sample rate (default 24000)\n"
+        "  --delay <ms>             One-way network delay (default 40)\n"
+        "  --jitter <ms>            Extra random delay of up to this much per packet (default 0)\n"
+        "  --loss <percent>         Packets dropped by the network (default 0)\n"
+        "  --seed <n>               Seed of the network randomness (default 1)\n"
+        "  --dtx                    The server accepts uplink DTX\n"
+        "  --vad-threshold <dbfs>   Level at which the VAD detects speech (default -45)\n"
+        "  --vad-hangover <ms>      Silence before the VAD reports the end of speech (default 600)\n"
+        "  --tail <ms>              Keep running after the end of the microphone file (default 2000)\n"
+        "  --log <level>            none, error, warn, info or debug (default warn)\n",
+        program, OPUS_FRAME_DURATION_MS);
+}
+
+static bool ParseOptions(int argc, char** argv, Options& options) {
+    static const std::map<std::string, esp_log_level_t> log_levels = {
+        {"none", ESP_LOG_NONE}, {"error", ESP_LOG_ERROR}, {"warn", ESP_LOG_WARN},
+        {"info", ESP_LOG_INFO}, {"debug", ESP_LOG_DEBUG},
+    };
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (option == "--dtx") {
+            options.dtx = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", option.c_str());
+            return false;
+        }
+        std::string value = argv[++i];
+        if (option == "--mic") {
+            options.mic = value;
+        } else if (option == "--speaker") {
+            options.speaker = value;
+        } else if (option == "--music") {
+            options.music = value;
+        } else if (option == "--report") {
+            options.report = value;
+        } else if (option == "--speed") {
+            options.speed = atof(value.c_str());
+        } else if (option == "--frame-duration") {
+            options.frame_duration = atoi(value.c_str());
+        } else if (option == "--output-rate") {
+            options.output_rate = atoi(value.c_str());
+        } else if (option == "--delay") {
+            options.network.delay_ms = atoi(value.c_str());
+        } else if (option == "--jitter") {
+            options.network.jitter_ms = atoi(value.c_str());
+        } else if (option == "--loss") {
+            options.network.loss_percent = atoi(value.c_str());
+        } else if (option == "--seed") {
+            options.network.seed = strtoul(value.c_str(), nullptr, 10);
+        } else if (option == "--vad-threshold") {
+            options.vad_threshold = atoi(value.c_str());
+        } else if (option == "--vad-hangover") {
+            options.vad_hangover = atoi(value.c_str());
+        } else if (option == "--tail") {
+            options.tail_ms = atoi(value.c_str());
+        } else if (option == "--log" && log_levels.count(value)) {
+            options.log_level = log_levels.at(value);
+        } else {
+            fprintf(stderr, "Unknown option %s %s\n", option.c_str(), value.c_str());
+            return false;
+        }
+    }
+    if (options.mic.empty() || options.speed <= 0 || options.output_rate <= 0) {
+        return false;
+    }
+    return true;
+}
+
+/* Streams a WAV file into the music channel at the pace the mixer takes it */
+struct MusicPlayer {
+    AudioService* audio_service = nullptr;
+    std::vector<int16_t> pcm;
+    int sample_rate = 0;
+    std::atomic<bool> stop{false};
+    TaskHandle_t task = nullptr;
+
+    bool Load(const std::string& path) {
+        WavFormat format;
+        FILE* file = OpenWav(path, format);
+        if (file == nullptr) {
+            return false;
+        }
+        std::vector<int16_t> samples(format.frames * format.channels);
+        size_t read = fread(samples.data(), sizeof(int16_t), samples.size(), file);
+        fclose(file);
+        /* Downmix to mono, the music channel is mono */
+        pcm.resize(read / format.channels);
+        for (size_t i = 0; i < pcm.size(); i++) {
+            int sum = 0;
+            for (int j = 0; j < format.channels; j++) {
+                sum += samples[i * format.channels + j];
+            }
+            pcm[i] = sum / format.channels;
+        }
+        sample_rate = format.sample_rate;
+        return !pcm.empty();
+    }
+
+    void Run() {
+        size_t chunk = sample_rate * MUSIC_CHUNK_MS / 1000;
+        for (size_t offset = 0; offset < pcm.size() && !stop; offset += chunk) {
+            /* Blocks while the mixer's music queue is full, as the music decoder does */
+            audio_service->PushMusicPcm(pcm.data() + offset, std::min(chunk, pcm.size() - offset), sample_rate);
+        }
+    }
+};
+
+/* Maximum and mean of a queue depth sampled at a fixed interval */
+struct DepthStatistics {
+    size_t max = 0;
+    uint64_t sum = 0;
+    uint32_t samples = 0;
+
+    void Add(size_t depth) {
+        max = std::max(max, depth);
+        sum += depth;
+        samples++;
+    }
+
+    cJSON* ToJson() const {
+        cJSON* json = cJSON_CreateObject();
+        cJSON_AddNumberToObject(json, "max", max);
+        cJSON_AddNumberToObject(json, "mean", samples > 0 ? (double)sum / samples : 0);
+        return json;
+    }
+};
+
+static cJSON* CpuToJson(const AudioService& audio_service, int64_t duration_us) {
+    const auto& stats = audio_service.debug_statistics();
+    /* Frames each task handles, to report its cost per frame */
+    const std::map<std::string, uint32_t> task_frames = {
+        {"audio_input", stats.input_count},
+        {"opus_encode", stats.encode_count},
+        {"opus_decode", stats.decode_count},
+        {"audio_output", stats.playback_count},
+    };
+    std::map<std::string, int64_t> task_cpu_us;
+    for (auto& task : HostTaskCpuTimes()) {
+        task_cpu_us[task.name] += task.cpu_us;
+    }
+
+    cJSON* json = cJSON_CreateObject();
+    for (auto& [name, cpu_us] : task_cpu_us) {
+        cJSON* task = cJSON_CreateObject();
+        cJSON_AddNumberToObject(task, "cpu_ms", cpu_us / 1000.0);
+        /* Share of one core over the simulated run, as it would be at real-time speed */
+        cJSON_AddNumberToObject(task, "load_percent", duration_us > 0 ? cpu_us * 100.0 * host_clock::speed() / duration_us : 0);
+        auto frames = task_frames.find(name);
+        if (frames != task_frames.end() && frames->second > 0) {
+            cJSON_AddNumberToObject(task, "us_per_frame", (double)cpu_us / frames->second);
+        }
+        cJSON_AddItemToObject(json, name.c_str(), task);
+    }
+    return json;
+}
+
+static cJSON* BuildReport(const Options& options, AudioService& audio_service, LoopbackProtocol& protocol,
+    const std::map<std::string, DepthStatistics>& depths, int64_t duration_us, double wall_s, int vad_changes) {
+    cJSON* report = cJSON_CreateObject();
+
+    cJSON* run = cJSON_CreateObject();
+    cJSON_AddStringToObject(run, "mic", options.mic.c_str());
+    cJSON_AddNumberToObject(run, "duration_ms", duration_us / 1000);
+    cJSON_AddNumberToObject(run, "wall_s", wall_s);
+    cJSON_AddNumberToObject(run, "speed", options.speed);
+    cJSON_AddNumberToObject(run, "frame_duration_ms", audio_service.frame_duration_ms());
+    cJSON_AddNumberToObject(run, "output_sample_rate", options.output_rate);
+    cJSON_AddBoolToObject(run, "uplink_dtx", protocol.server_dtx());
+    cJSON_AddNumberToObject(run, "vad_changes", vad_changes);
+    cJSON_AddItemToObject(report, "run", run);
+
+    const auto& stats = audio_service.debug_statistics();
+    cJSON* frames = cJSON_CreateObject();
+    cJSON_AddNumberToObject(frames, "input", stats.input_count);
+    cJSON_AddNumberToObject(frames, "encoded", stats.encode_count);
+    cJSON_AddNumberToObject(frames, "decoded", stats.decode_count);
+    cJSON_AddNumberToObject(frames, "played", stats.playback_count);
+    cJSON_AddNumberToObject(frames, "encode_deadline_misses", stats.encode_deadline_misses);
+    cJSON_AddNumberToObject(frames, "decode_deadline_misses", stats.decode_deadline_misses);
+    cJSON_AddNumberToObject(frames, "lost", stats.lost_frames);
+    cJSON_AddNumberToObject(frames, "concealed", stats.concealed_frames);
+    cJSON_AddNumberToObject(frames, "suppressed", stats.suppressed_frames);
+    cJSON_AddNumberToObject(frames, "dtx_packets", stats.dtx_packets);
+    cJSON_AddNumberToObject(frames, "send_queue_drops", stats.send_queue_drops);
+    cJSON_AddItemToObject(report, "frames", frames);
+
+    cJSON* queues = cJSON_CreateObject();
+    for (auto& [name, depth] : depths) {
+        cJSON_AddItemToObject(queues, name.c_str(), depth.ToJson());
+    }
+    cJSON_AddItemToObject(report, "queues", queues);
+
+    auto jitter = audio_service.jitter_buffer_statistics();
+    cJSON* jitter_buffer = cJSON_CreateObject();
+    cJSON_AddNumberToObject(jitter_buffer, "jitter_ms", jitter.jitter_ms);
+    cJSON_AddNumberToObject(jitter_buffer, "target_delay_ms", jitter.target_delay_ms);
+    cJSON_AddNumberToObject(jitter_buffer, "late_discards", jitter.late_discards);
+    cJSON_AddNumberToObject(jitter_buffer, "duplicate_discards", jitter.duplicate_discards);
+    cJSON_AddNumberToObject(jitter_buffer, "overflow_discards", jitter.overflow_discards);
+    cJSON_AddNumberToObject(jitter_buffer, "lost_frames", jitter.lost_frames);
+    cJSON_AddNumberToObject(jitter_buffer, "underruns", jitter.underruns);
+    cJSON_AddItemToObject(report, "jitter_buffer", jitter_buffer);
+
+    auto net = protocol.statistics();
+    cJSON* network = cJSON_CreateObject();
+    cJSON_AddNumberToObject(network, "delay_ms", options.network.delay_ms);
+    cJSON_AddNumberToObject(network, "jitter_ms", options.network.jitter_ms);
+    cJSON_AddNumberToObject(network, "loss_percent", options.network.loss_percent);
+    cJSON_AddNumberToObject(network, "sent_packets", net.sent_packets);
+    cJSON_AddNumberToObject(network, "sent_bytes", net.sent_bytes);
+    cJSON_AddNumberToObject(network, "dtx_packets", net.dtx_packets);
+    cJSON_AddNumberToObject(network, "dropped_packets", net.dropped_packets);
+    cJSON_AddNumberToObject(network, "delivered_packets", net.delivered_packets);
+    /* Uplink bitrate over the whole run, DTX included */
+    cJSON_AddNumberToObject(network, "uplink_kbps", duration_us > 0 ? net.sent_bytes * 8000.0 / duration_us : 0);
+    cJSON_AddItemToObject(report, "network", network);
+
+    cJSON_AddItemToObject(report, "latency", audio_service.latency_tracer().ToJson(true));
+    cJSON_AddItemToObject(report, "cpu", CpuToJson(audio_service, duration_us));
+    return report;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        PrintUsage(argv[0]);
+        return 2;
+    }
+    host_clock::SetSpeed(options.speed);
+    esp_log_level_set("*", options.log_level);
+    auto wall_start = std::chrono::steady_clock::now();
+
+    WavAudioCodec codec(options.mic, options.speaker, options.output_rate);
+    if (!codec.ok()) {
+        return 1;
+    }
+    LoopbackProtocol protocol(options.network, options.frame_duration, options.dtx);
+    AudioService audio_service;
+    audio_service.Initialize(&codec, std::make_unique<EnergyVadProcessor>(options.vad_threshold, options.vad_hangover));
+
+    /* Wired up as the application does: the main task drains the send queue when notified */
+    TaskHandle_t main_task = xTaskGetCurrentTaskHandle();
+    std::atomic<int> vad_changes{0};
+    AudioServiceCallbacks callbacks;
+    callbacks.on_send_queue_available = [main_task]() {
+        xTaskNotifyGive(main_task);
+    };
+    callbacks.on_vad_change = [&vad_changes](bool speaking) {
+        vad_changes++;
+    };
+    audio_service.SetCallbacks(callbacks);
+    protocol.OnIncomingAudio([&audio_service](std::unique_ptr<AudioStreamPacket> packet) {
+        audio_service.PushPacketToJitterBuffer(std::move(packet));
+    });
+    protocol.OnAudioChannelOpened([&audio_service, &protocol]() {
+        audio_service.SetFrameDuration(protocol.server_frame_duration());
+        audio_service.EnableUplinkDtx(protocol.server_dtx());
+    });
+
+    audio_service.Start();
+    protocol.Start();
+    if (!protocol.OpenAudioChannel()) {
+        ESP_LOGE(TAG, "Failed to open the audio channel");
+        return 1;
+    }
+    audio_service.EnableVoiceProcessing(true);
+
+    MusicPlayer music;
+    if (!options.music.empty()) {
+        music.audio_service = &audio_service;
+        if (!music.Load(options.music)) {
+            return 1;
+        }
+        xTaskCreate([](void* arg) {
+            ((MusicPlayer*)arg)->Run();
+            vTaskDelete(NULL);
+        }, "music_player", 4096, &music, 2, &music.task);
+    }
+
+    std::map<std::string, DepthStatistics> depths;
+    int64_t start_us = esp_timer_get_time();
+    int64_t end_us = start_us + codec.mic_duration_us() + options.tail_ms * 1000LL;
+    int64_t next_sample_us = start_us;
+    while (true) {
+        int64_t now = esp_timer_get_time();
+        if (now >= end_us) {
+            break;
+        }
+        if (now >= next_sample_us) {
+            auto queue_depths = audio_service.queue_depths();
+            depths["encode"].Add(queue_depths.encode);
+            depths["send"].Add(queue_depths.send);
+            depths["decode"].Add(queue_depths.decode);
+            depths["playback"].Add(queue_depths.playback);
+            depths["jitter_buffer_ms"].Add(audio_service.jitter_buffer_statistics().buffered_ms);
+            next_sample_us += QUEUE_SAMPLE_INTERVAL_MS * 1000;
+        }
+
+        int64_t wait_ms = std::min(next_sample_us, end_us) - now;
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(std::max<int64_t>(wait_ms / 1000, 1)));
+        while (auto packet = audio_service.PopPacketFromSendQueue()) {
+            auto trace = packet->trace;
+            if (!protocol.SendAudio(std::move(packet))) {
+                break;
+            }
+            audio_service.latency_tracer().Finish(trace, kLatencyStageSend, kLatencyStageUplink);
+        }
+    }
+    int64_t duration_us = esp_timer_get_time() - start_us;
+
+    music.stop = true;
+    if (music.task != nullptr) {
+        audio_service.ClearMusic();
+        while (eTaskGetState(music.task) != eDeleted) {
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    audio_service.EnableVoiceProcessing(false);
+    protocol.CloseAudioChannel();
+    audio_service.Stop();
+    codec.Close();
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+    cJSON* report = BuildReport(options, audio_service, protocol, depths, duration_us, wall_s, vad_changes);
+    char* text = cJSON_Print(report);
+    if (options.report.empty()) {
+        printf("%s\n", text);
+    } else {
+        FILE* file = fopen(options.report.c_str(), "w");
+        if (file == nullptr) {
+            ESP_LOGE(TAG, "Failed to create %s", options.report.c_str());
+        } else {
+            fprintf(file, "%s\n", text);
+            fclose(file);
+        }
+    }
+    cJSON_free(text);
+    cJSON_Delete(report);
+    fflush(stdout);
+    fflush(stderr);
+    /* The audio tasks never return on the device; leave them running instead of destroying the service under them */
+    _Exit(0);
+}
@@ -0,0 +1,122 @@
+#include "wav_audio_codec.h"
+#include "host_clock.h"
+#include "wav_file.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "WavAudioCodec"
+
+/* Same amount of audio as the I2S DMA buffers of the device codecs */
+#define SPEAKER_BUFFER_FRAMES (AUDIO_CODEC_DMA_DESC_NUM * AUDIO_CODEC_DMA_FRAME_NUM)
+
+WavAudioCodec::WavAudioCodec(const std::string& mic_path, const std::string& speaker_path, int output_sample_rate) {
+    duplex_ = true;
+    output_sample_rate_ = output_sample_rate;
+    if (!OpenMic(mic_path)) {
+        return;
+    }
+    if (!speaker_path.empty()) {
+        speaker_ = fopen(speaker_path.c_str(), "wb");
+        if (speaker_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create %s", speaker_path.c_str());
+        } else {
+            WriteWavHeader(speaker_, output_sample_rate_, 1, 0);
+        }
+    }
+}
+
+WavAudioCodec::~WavAudioCodec() {
+    Close();
+    if (mic_ != nullptr) {
+        fclose(mic_);
+    }
+}
+
+bool WavAudioCodec::OpenMic(const std::string& path) {
+    WavFormat format;
+    mic_ = OpenWav(path, format);
+    if (mic_ == nullptr) {
+        return false;
+    }
+    if (format.channels > 2) {
+        ESP_LOGE(TAG, "%s must be mono or stereo", path.c_str());
+        fclose(mic_);
+        mic_ = nullptr;
+        return false;
+    }
+    mic_data_end_ = ftell(mic_) + format.frames * format.channels * 2;
+    mic_frames_ = format.frames;
+    input_sample_rate_ = format.sample_rate;
+    input_channels_ = format.channels;
+    input_reference_ = format.channels == 2;
+    ESP_LOGI(TAG, "Microphone: %s, %d Hz, %d channels, %.1f s", path.c_str(), format.sample_rate, format.channels,
+        format.frames / (double)format.sample_rate);
+    return true;
+}
+
+int64_t WavAudioCodec::mic_duration_us() const {
+    return input_sample_rate_ > 0 ? mic_frames_ * 1000000 / input_sample_rate_ : 0;
+}
+
+int WavAudioCodec::Read(int16_t* dest, int samples) {
+    int64_t now = host_clock::NowUs();
+    if (read_start_us_ < 0) {
+        read_start_us_ = now;
+    }
+    int frames = samples / input_channels_;
+    int64_t available = 0;
+    if (mic_ != nullptr) {
+        available = std::max<int64_t>(0, (mic_data_end_ - ftell(mic_)) / (2 * input_channels_));
+    }
+    int64_t count = std::min<int64_t>(frames, available);
+    size_t read = count > 0 ? fread(dest, 2 * input_channels_, count, mic_) : 0;
+    std::fill(dest + read * input_channels_, dest + samples, 0);
+
+    /* The samples are there once the last of them has been captured */
+    read_frames_ += frames;
+    host_clock::SleepUntilUs(read_start_us_ + read_frames_ * 1000000 / input_sample_rate_);
+    return samples;
+}
+
+int WavAudioCodec::Write(const int16_t* data, int samples) {
+    std::unique_lock<std::mutex> lock(speaker_mutex_);
+    int64_t now = host_clock::NowUs();
+    /* Playback position on the simulated clock; anything before it that was not written is silence */
+    int64_t played_frames = now * output_sample_rate_ / 1000000;
+    if (written_frames_ < played_frames) {
+        int64_t gap = played_frames - written_frames_;
+        silence_.assign(std::min<int64_t>(gap, output_sample_rate_), 0);
+        while (gap > 0) {
+            int64_t count = std::min<int64_t>(gap, silence_.size());
+            if (speaker_ != nullptr) {
+                fwrite(silence_.data(), 2, count, speaker_);
+            }
+            gap -= count;
+        }
+        written_frames_ = played_frames;
+    }
+    if (speaker_ != nullptr) {
+        fwrite(data, 2, samples, speaker_);
+    }
+    written_frames_ += samples;
+    int64_t written_frames = written_frames_;
+    lock.unlock();
+
+    /* Block while more than the DMA buffers are waiting to be played */
+    int64_t queued_until_us = (written_frames - SPEAKER_BUFFER_FRAMES) * 1000000 / output_sample_rate_;
+    host_clock::SleepUntilUs(queued_until_us);
+    return samples;
+}
+
+void WavAudioCodec::Close() {
+    std::lock_guard<std::mutex> lock(speaker_mutex_);
+    if (speaker_ != nullptr) {
+        WriteWavHeader(speaker_, output_sample_rate_, 1, written_frames_);
+        fclose(speaker_);
+        speaker_ = nullptr;
+        ESP_LOGI(TAG, "Speaker: %.1f s recorded", written_frames_ / (double)output_sample_rate_);
+    }
+}
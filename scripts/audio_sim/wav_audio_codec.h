@@ -0,0 +1,46 @@
+#ifndef WAV_AUDIO_CODEC_H
+#define WAV_AUDIO_CODEC_H
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "audio_codec.h"
+
+/*
+ * Codec backed by WAV files, paced on the simulated clock like the I2S DMA.
+ *
+ * The microphone reads a 16-bit PCM WAV file, mono or stereo (the second channel is then the
+ * AEC reference), and returns silence after its end. A read returns once its samples would
+ * have been captured. The speaker is recorded to a mono WAV file at the output rate, with
+ * silence wherever nothing was played, so it lines up with the microphone in time. A write
+ * blocks while more than the DMA buffers are queued ahead of playback.
+ */
+class WavAudioCodec : public AudioCodec {
+public:
+    WavAudioCodec(const std::string& mic_path, const std::string& speaker_path, int output_sample_rate);
+    virtual ~WavAudioCodec();
+
+    bool ok() const { return mic_ != nullptr; }
+    int64_t mic_duration_us() const;
+    /* Writes the speaker file's final header */
+    void Close();
+
+private:
+    FILE* mic_ = nullptr;
+    std::mutex speaker_mutex_;    // Close() runs on the harness thread while the output task may still write
+    FILE* speaker_ = nullptr;
+    long mic_data_end_ = 0;
+    int64_t mic_frames_ = 0;
+    int64_t read_frames_ = 0;
+    int64_t read_start_us_ = -1;
+    int64_t written_frames_ = 0;
+    std::vector<int16_t> silence_;
+
+    bool OpenMic(const std::string& path);
+    int Read(int16_t* dest, int samples) override;
+    int Write(const int16_t* data, int samples) override;
+};
+
+#endif // WAV_AUDIO_CODEC_H
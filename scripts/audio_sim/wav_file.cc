@@ -0,0 +1,94 @@
+#include "wav_file.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+
+#define TAG "WavFile"
+
+struct WavHeader {
+    char riff[4];
+    uint32_t riff_size;
+    char wave[4];
+    char fmt[4];
+    uint32_t fmt_size;
+    uint16_t format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+    char data[4];
+    uint32_t data_size;
+} __attribute__((packed));
+
+FILE* OpenWav(const std::string& path, WavFormat& format) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        ESP_LOGE(TAG, "Failed to open %s", path.c_str());
+        return nullptr;
+    }
+
+    /* Walk the chunks: "fmt " must be 16-bit PCM, the samples start at "data" */
+    char riff[12];
+    if (fread(riff, 1, sizeof(riff), file) != sizeof(riff) || memcmp(riff, "RIFF", 4) != 0 || memcmp(riff + 8, "WAVE", 4) != 0) {
+        ESP_LOGE(TAG, "%s is not a WAV file", path.c_str());
+        fclose(file);
+        return nullptr;
+    }
+    uint16_t pcm_format = 0, channels = 0, bits = 0;
+    uint32_t sample_rate = 0;
+    while (true) {
+        char id[4];
+        uint32_t size;
+        if (fread(id, 1, 4, file) != 4 || fread(&size, 4, 1, file) != 1) {
+            ESP_LOGE(TAG, "%s has no data chunk", path.c_str());
+            fclose(file);
+            return nullptr;
+        }
+        if (memcmp(id, "fmt ", 4) == 0 && size >= 16) {
+            uint8_t fmt[16];
+            if (fread(fmt, 1, sizeof(fmt), file) != sizeof(fmt)) {
+                continue;
+            }
+            memcpy(&pcm_format, fmt, 2);
+            memcpy(&channels, fmt + 2, 2);
+            memcpy(&sample_rate, fmt + 4, 4);
+            memcpy(&bits, fmt + 14, 2);
+            fseek(file, size - 16 + (size & 1), SEEK_CUR);
+        } else if (memcmp(id, "data", 4) == 0) {
+            if (pcm_format != 1 || bits != 16 || channels == 0 || sample_rate == 0) {
+                ESP_LOGE(TAG, "%s is not 16-bit PCM", path.c_str());
+                fclose(file);
+                return nullptr;
+            }
+            format.sample_rate = sample_rate;
+            format.channels = channels;
+            format.frames = size / (2 * channels);
+            return file;
+        } else {
+            fseek(file, size + (size & 1), SEEK_CUR);
+        }
+    }
+}
+
+void WriteWavHeader(FILE* file, int sample_rate, int channels, int64_t frames) {
+    uint32_t data_size = frames * channels * 2;
+    WavHeader header;
+    memcpy(header.riff, "RIFF", 4);
+    header.riff_size = sizeof(WavHeader) - 8 + data_size;
+    memcpy(header.wave, "WAVE", 4);
+    memcpy(header.fmt, "fmt ", 4);
+    header.fmt_size = 16;
+    header.format = 1;
+    header.channels = channels;
+    header.sample_rate = sample_rate;
+    header.byte_rate = sample_rate * channels * 2;
+    header.block_align = channels * 2;
+    header.bits_per_sample = 16;
+    memcpy(header.data, "data", 4);
+    header.data_size = data_size;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fseek(file, 0, SEEK_END);
+}
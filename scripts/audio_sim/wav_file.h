@@ -0,0 +1,19 @@
+#ifndef WAV_FILE_H
+#define WAV_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+struct WavFormat {
+    int sample_rate = 0;
+    int channels = 0;
+    int64_t frames = 0;
+};
+
+/* Opens a 16-bit PCM WAV file positioned at its first sample; nullptr if it cannot be read */
+FILE* OpenWav(const std::string& path, WavFormat& format);
+/* Writes the header of a 16-bit PCM file holding `frames` frames, then seeks back to the end */
+void WriteWavHeader(FILE* file, int sample_rate, int channels, int64_t frames);
+
+#endif // WAV_FILE_H